@@ -0,0 +1,68 @@
+// Building and differentiating expressions on the heap vs in an ExpressionArena:
+// allocations and latency of build_function + first partial derivatives, then release.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/AllocationCounter.hpp"
+#include "../src/ExpressionArena.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+// build + d/dx_i for i < 3, returns the number of nodes of the last derivative
+std::size_t build_and_diff(ASTNode& tree) {
+  std::unique_ptr<IScalarFunction> f = build_function(tree);
+  std::size_t nodes = 0;
+  for (Index i = 0; i < 3; ++i) {
+    nodes += dag_size(*f->diff(i));
+  }
+  return nodes;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"2/exp(x_0)",
+                                          "exp(-0.5*dot(x,x))",
+                                          "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "exp(-norm2(x-2*x/dot(x,x)))/(1+x_0*x_1)"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+  constexpr int repeat = 2000;
+
+  std::cout << std::left << std::setw(42) << "expression" << std::right << std::setw(14) << "heap allocs" << std::setw(14)
+            << "arena allocs" << std::setw(14) << "heap (us)" << std::setw(14) << "arena (us)" << '\n';
+
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    const auto tree = parse(in);
+    std::size_t checksum = 0;
+
+    const AllocationCounter heap;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; ++r) {
+      checksum += build_and_diff(*tree);
+    }
+    const double heap_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    const std::size_t heap_allocations = heap.count().allocations / repeat;
+
+    const AllocationCounter in_arena;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; ++r) {
+      ExpressionArena arena(1 << 14);
+      ExpressionArena::Scope scope(arena);
+      checksum -= build_and_diff(*tree);
+    }
+    const double arena_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    const std::size_t arena_allocations = in_arena.count().allocations / repeat;
+
+    if (checksum != 0)
+      std::cerr << "mismatch between heap and arena functions\n";
+    std::cout << std::left << std::setw(42) << expression << std::right << std::setw(14) << heap_allocations
+              << std::setw(14) << arena_allocations << std::setw(14) << std::fixed << std::setprecision(2)
+              << heap_us / repeat << std::setw(14) << arena_us / repeat << '\n';
+  }
+  return 0;
+}
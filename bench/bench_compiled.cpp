@@ -0,0 +1,53 @@
+// Cold start of a set of functions with their partial derivatives:
+// parse + build_function + diff (simplified) + compile, vs loading the compiled file.
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/CompiledFile.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"exp(-0.5*dot(x,x))", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "exp(-norm2(x-2*x/dot(x,x)))/(1+x_0*x_1)", "norm2(x/x_0-x_2*x)/(1+x_1)"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+  const Index dimension = 8;
+  const int copies = 100;  // functions loaded at startup: copies of each expression
+  const std::string filename = "bench_compiled.lkp";
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<CompiledFunction> built;
+  for (int c = 0; c < copies; ++c) {
+    for (const std::string& expression : expressions) {
+      // a different constant for each copy: nothing is shared through the intern table
+      const std::string text = std::to_string(c + 1) + "*(" + expression + ")";
+      string_input in(text, "benchmark expression");
+      built.push_back(compile_function(text, *build_function(*parse(in)), dimension));
+    }
+  }
+  const double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  save_compiled(filename, built);
+  const auto load_start = std::chrono::steady_clock::now();
+  const std::vector<CompiledFunction> loaded = load_compiled(filename);
+  const double load_ms =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+  std::remove(filename.c_str());
+
+  const Vector x(dimension, 0.5);
+  for (std::size_t k = 0; k < built.size(); ++k) {
+    if (loaded[k].function.apply(x) != built[k].function.apply(x)) {
+      std::cerr << "mismatch on " << built[k].expression << '\n';
+      return 1;
+    }
+  }
+  std::cout << built.size() << " functions with " << dimension << " derivatives each\n"
+            << std::fixed << std::setprecision(2) << "build: " << std::setw(10) << build_ms << " ms\n"
+            << "load:  " << std::setw(10) << load_ms << " ms (" << build_ms / load_ms << "x faster)\n";
+  return 0;
+}
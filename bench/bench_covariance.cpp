@@ -0,0 +1,58 @@
+// Assembly of n x n covariance matrices k(x_p, x_q) of points in dimension 3, for growing n.
+// Sizes may be given as arguments (default 1000 2000 5000; a matrix of 5e4 points takes 20 GB);
+// the pool uses the hardware concurrency.
+// Each kernel is timed as parsed, then fused (IScalarFunction::fuse: one pass over the coordinates per entry).
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/KernelMatrix.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+int main(int argc, char** argv) {
+  std::vector<Index> sizes = {1000, 2000, 5000};
+  if (argc > 1) {
+    sizes.clear();
+    for (int k = 1; k < argc; ++k)
+      sizes.push_back(std::stoul(argv[k]));
+  }
+  const std::vector<std::string> kernels = {"exp(-0.5*dot(x-y,x-y))", "exp(-norm2(x-y)/2)*(1+dot(x,y)/10)"};
+  ThreadPool pool;
+
+  std::cout << std::left << std::setw(40) << "kernel" << std::setw(8) << "form" << std::right << std::setw(10)
+            << "points" << std::setw(14) << "symmetric (ms)" << std::setw(14) << "ns/entry" << std::setw(14)
+            << "full (ms)" << std::setw(14) << "ns/entry" << '\n';
+  for (const std::string& kernel : kernels) {
+    string_input in(kernel, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> parsed = build_function(*parse(in));
+    const std::unique_ptr<IScalarFunction> fused = parsed->fuse();
+    for (const Index n : sizes) {
+      VectorBlock points(3, n);
+      for (std::size_t i = 0; i < points.data.size(); ++i) {
+        points.data[i] = std::sin(0.37 * i) * 2;
+      }
+      for (const bool fusing : {false, true}) {
+        const KernelMatrix builder((fusing) ? *fused : *parsed, pool);
+        auto start = std::chrono::steady_clock::now();
+        (void)builder.build(points);
+        const double symmetric
+            = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        (void)builder.build(points, points);
+        const double full
+            = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const double entries = static_cast<double>(n) * n;
+        std::cout << std::left << std::setw(40) << kernel << std::setw(8) << ((fusing) ? "fused" : "parsed")
+                  << std::right << std::setw(10) << n << std::fixed << std::setprecision(1) << std::setw(14)
+                  << symmetric << std::setw(14) << 1e6 * symmetric / (entries / 2) << std::setw(14) << full
+                  << std::setw(14) << 1e6 * full / entries << '\n';
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+// Size of successive derivatives: hash-consed DAG vs the equivalent tree
+// (the tree is what the former clone-based diff() built).
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/AllocationCounter.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"2/exp(x_0)",
+                                          "exp(-0.5*dot(x,x))",
+                                          "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "exp(-norm2(x-2*x/dot(x,x)))/(1+x_0*x_1)"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+
+  std::cout << std::left << std::setw(42) << "expression" << std::right << std::setw(6) << "order" << std::setw(14)
+            << "tree nodes" << std::setw(12) << "dag nodes" << std::setw(14) << "tree bytes*" << std::setw(12)
+            << "dag bytes" << std::setw(12) << "time (us)" << '\n';
+
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    ScalarFunctionPtr f = build_function(*parse(in));
+    for (std::size_t order = 1; order <= 3; ++order) {
+      const AllocationCounter counter;
+      const auto start = std::chrono::steady_clock::now();
+      f = f->diff(order - 1);
+      const auto stop = std::chrono::steady_clock::now();
+      const std::size_t bytes = counter.count().bytes;
+
+      const std::size_t tree = tree_size(*f);
+      const std::size_t dag = dag_size(*f);
+      // the tree would have held the same kind of nodes, without any sharing
+      const std::size_t tree_bytes = bytes * tree / std::max<std::size_t>(dag, 1);
+      std::cout << std::left << std::setw(42) << expression << std::right << std::setw(6) << order << std::setw(14)
+                << tree << std::setw(12) << dag << std::setw(14) << tree_bytes << std::setw(12) << bytes
+                << std::setw(12) << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()
+                << '\n';
+    }
+  }
+  std::cout << "dag bytes: all bytes allocated by diff(), temporaries included\n"
+            << "* estimated: dag bytes scaled by tree nodes / dag nodes\n";
+  return 0;
+}
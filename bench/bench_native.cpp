@@ -0,0 +1,64 @@
+// Gradient evaluation: tree, tape interpreter and native code (first call includes compilation or cache lookup).
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/NativeFunction.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+template <typename F>
+double time_ns(F&& f, const int repeat) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; ++r) {
+    f();
+  }
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() / repeat;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"exp(-0.5*dot(x,x))", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "exp(-norm2(x-2*x/dot(x,x)))/(1+x_0*x_1)"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+  const Vector x{0.5, -1, 2, 0.25, 1.5, -0.75, 3, 1};
+  const int repeat = 100000;
+
+  std::cout << std::left << std::setw(42) << "expression" << std::right << std::setw(12) << "build (ms)"
+            << std::setw(12) << "tree (ns)" << std::setw(12) << "tape (ns)" << std::setw(12) << "native (ns)" << '\n';
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> f = build_function(*parse(in));
+    std::vector<ScalarFunctionPtr> derivatives;
+    for (Index i = 0; i < x.size(); ++i) {
+      derivatives.push_back(f->diff(i, DiffOptions{true}));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const NativeFunction native(*f);
+    const double build_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!native.is_native())
+      std::cerr << "interpreter fallback: " << native.diagnostic() << '\n';
+
+    Tape::Workspace workspace;
+    volatile Number sink = 0;
+    const double tree = time_ns(
+        [&] {
+          for (const auto& d : derivatives)
+            sink = sink + d->apply(x);
+        },
+        repeat / 10);
+    const double tape = time_ns([&] { sink = sink + native.tape().gradient(x, workspace)[0]; }, repeat);
+    const double code = time_ns([&] { sink = sink + native.gradient(x, workspace)[0]; }, repeat);
+    std::cout << std::left << std::setw(42) << expression << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << build_ms << std::setw(12) << tree << std::setw(12) << tape << std::setw(12) << code
+              << '\n';
+  }
+  return 0;
+}
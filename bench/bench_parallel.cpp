@@ -0,0 +1,64 @@
+// Scaling of the batch evaluator from 1 to N threads on 1e6 points (values, then gradients).
+// Maximum concurrency defaults to the hardware concurrency; it may be given as first argument.
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/BatchEvaluator.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+template <typename F>
+double time_ms(F&& f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t max_concurrency = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  if (argc > 1)
+    max_concurrency = std::stoul(argv[1]);
+  const std::vector<std::string> expressions = {"2-(2./6+2)*4", "dot(x,x)", "norm2(x)", "dot(x-x,x+x*2)",
+                                                "exp(-dot(x-2*x,-x)/x_2/e)"};
+  std::vector<std::size_t> concurrencies;
+  for (std::size_t c = 1; c < max_concurrency; c *= 2) {
+    concurrencies.push_back(c);
+  }
+  concurrencies.push_back(max_concurrency);
+
+  VectorBlock points(3, 1000000);
+  for (std::size_t k = 0; k < points.data.size(); ++k) {
+    points.data[k] = std::sin(0.37 * k) * 2;
+  }
+
+  std::cout << std::left << std::setw(30) << "expression" << std::right << std::setw(10) << "threads"
+            << std::setw(14) << "apply (ms)" << std::setw(10) << "speedup" << std::setw(16) << "gradient (ms)"
+            << std::setw(10) << "speedup" << '\n';
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> f = build_function(*parse(in));
+    double apply_reference = 0, gradient_reference = 0;
+    for (const std::size_t concurrency : concurrencies) {
+      ThreadPool pool(concurrency);
+      const BatchEvaluator evaluator(*f, pool);
+      const double apply = time_ms([&] { (void)evaluator.apply(points); });
+      const double gradient = time_ms([&] { (void)evaluator.gradient(points); });
+      if (concurrency == 1) {
+        apply_reference = apply;
+        gradient_reference = gradient;
+      }
+      std::cout << std::left << std::setw(30) << expression << std::right << std::setw(10) << concurrency
+                << std::fixed << std::setprecision(1) << std::setw(14) << apply << std::setw(10)
+                << apply_reference / apply << std::setw(16) << gradient << std::setw(10)
+                << gradient_reference / gradient << '\n';
+    }
+  }
+  return 0;
+}
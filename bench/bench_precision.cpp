@@ -0,0 +1,111 @@
+// Accuracy versus speed of the evaluation types on the eval test corpus, in dimension 3 and 1000:
+// each tape is evaluated on a set of points in float, double, long double (the reference), and in mixed precision
+// (float, with the largest tenth of the values refined in double, as a screening pass would).
+// Errors are the largest relative errors to the long double values.
+// The mixed time includes the conversion of the points from the double block. Reductions run in the default
+// (exact, sequential) mode; in the reassociated mode, float reductions also use the SIMD width.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/MixedPrecision.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+struct Measure {
+  double ns = 0;     // per point
+  double error = 0;  // largest relative error to the reference
+};
+
+template <typename T>
+Measure measure(const Tape& tape, const std::vector<Vector>& points, const std::vector<long double>& reference) {
+  std::vector<std::vector<T>> xs;
+  for (const Vector& x : points)
+    xs.emplace_back(x.begin(), x.end());
+  Tape::BasicWorkspace<T> workspace;
+  std::vector<T> values(points.size());
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t p = 0; p < points.size(); ++p) {
+    values[p] = tape.apply_as(xs[p], workspace);
+  }
+  Measure m;
+  m.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / points.size();
+  for (std::size_t p = 0; p < points.size(); ++p) {
+    m.error = std::max(m.error, static_cast<double>(std::abs((values[p] - reference[p]) / reference[p])));
+  }
+  return m;
+}
+
+Measure measure_mixed(const IScalarFunction& f,
+                      const std::vector<Vector>& points,
+                      const std::vector<long double>& reference) {
+  const MixedPrecisionEvaluator evaluator(f);
+  const VectorBlock block = VectorBlock::from_points(points);
+  std::vector<long double> sorted = reference;
+  const auto decile = sorted.begin() + sorted.size() * 9 / 10;
+  std::nth_element(sorted.begin(), decile, sorted.end());
+  const auto threshold = static_cast<Number>(*decile);
+  const auto start = std::chrono::steady_clock::now();
+  const auto result = evaluator.apply(block, [threshold](const Number v) { return v > threshold; });
+  Measure m;
+  m.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / points.size();
+  for (std::size_t p = 0; p < points.size(); ++p) {
+    m.error = std::max(m.error, static_cast<double>(std::abs((result.values[p] - reference[p]) / reference[p])));
+  }
+  return m;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"2-(2./6+2)*4",
+                                          "exp(2)",
+                                          "dot(x,x)",
+                                          "norm2(x)",
+                                          "dot(-x,+x)",
+                                          "exp(-dot(x-2*x,-x)/x_2/e)",
+                                          "norm2(x+x)",
+                                          "pi*x_0/x_1-exp(-0.5*dot(x,x))",
+                                          "dot(pi*x,x/e)"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+  constexpr std::size_t count = 2000;
+
+  std::cout << std::left << std::setw(34) << "expression" << std::right << std::setw(10) << "dimension";
+  for (const char* type : {"float", "double", "long double", "mixed"}) {
+    std::cout << std::setw(12) << type << " (ns)" << std::setw(10) << "error";
+  }
+  std::cout << '\n';
+
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> f = parse_function(in);
+    const Tape tape = compile(*f);
+    for (const Index dimension : {Index{3}, Index{1000}}) {
+      std::vector<Vector> points(count, Vector(dimension));
+      for (std::size_t p = 0; p < count; ++p) {
+        for (Index i = 0; i < dimension; ++i) {
+          // x_1 and x_2 stay away from 0, dot(x,x) stays of order 1 (its exp does not underflow)
+          points[p][i] = (1 + std::sin(0.37 * (p * dimension + i)) / 2) / std::sqrt(dimension / 3.);
+        }
+      }
+      std::vector<long double> reference(count);
+      for (std::size_t p = 0; p < count; ++p) {
+        reference[p] = tape.apply_as(std::vector<long double>(points[p].begin(), points[p].end()));
+      }
+
+      std::cout << std::left << std::setw(34) << expression << std::right << std::setw(10) << dimension;
+      for (const Measure& m : {measure<float>(tape, points, reference), measure<double>(tape, points, reference),
+                               measure<long double>(tape, points, reference), measure_mixed(*f, points, reference)}) {
+        std::cout << std::fixed << std::setprecision(1) << std::setw(17) << m.ns << std::scientific
+                  << std::setprecision(2) << std::setw(10) << m.error;
+      }
+      std::cout << '\n';
+    }
+  }
+  return 0;
+}
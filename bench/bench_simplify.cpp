@@ -0,0 +1,73 @@
+// Effect of simplify() on the derivatives of the diff test corpus: node count and evaluation time.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+double evaluation_time_ns(const IScalarFunction& f, const Vector& x, const int repeat) {
+  volatile Number sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; ++r) {
+    sink = sink + f.apply(x);
+  }
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() / repeat;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"2*x_0",
+                                          "x_0*x_1",
+                                          "(-x_0)*(+x_0)",
+                                          "(x_0+x_1)*(x_0-x_1)",
+                                          "x_0*x_0+x_1*x_1",
+                                          "dot(x,x)",
+                                          "norm2(x)",
+                                          "norm2(x)*norm2(-x)",
+                                          "dot(-x,+x)",
+                                          "dot(x-x,x+x)",
+                                          "2/exp(x_0)",
+                                          "dot(pi*x,x/e)",
+                                          "exp(x_0)",
+                                          "exp(-0.5 * dot(x,x))"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+  const Vector x{1, 2, 3};
+  const int repeat = 100000;
+
+  std::cout << std::left << std::setw(26) << "expression" << std::right << std::setw(6) << "order" << std::setw(8)
+            << "nodes" << std::setw(12) << "simplified" << std::setw(12) << "eval (ns)" << std::setw(12)
+            << "simplified" << '\n';
+
+  std::size_t total_nodes = 0, total_simplified_nodes = 0;
+  double total_time = 0, total_simplified_time = 0;
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> f = build_function(*parse(in));
+    ScalarFunctionPtr df = f->diff(0);
+    ScalarFunctionPtr sdf = f->diff(0, DiffOptions{true});
+    for (std::size_t order = 1; order <= 2; ++order) {
+      const std::size_t nodes = tree_size(*df);
+      const std::size_t simplified_nodes = tree_size(*sdf);
+      const double time = evaluation_time_ns(*df, x, repeat);
+      const double simplified_time = evaluation_time_ns(*sdf, x, repeat);
+      total_nodes += nodes;
+      total_simplified_nodes += simplified_nodes;
+      total_time += time;
+      total_simplified_time += simplified_time;
+      std::cout << std::left << std::setw(26) << expression << std::right << std::setw(6) << order << std::setw(8)
+                << nodes << std::setw(12) << simplified_nodes << std::setw(12) << std::fixed << std::setprecision(1)
+                << time << std::setw(12) << simplified_time << '\n';
+      df = df->diff(1);
+      sdf = sdf->diff(1, DiffOptions{true});
+    }
+  }
+  std::cout << std::left << std::setw(32) << "total" << std::right << std::setw(8) << total_nodes << std::setw(12)
+            << total_simplified_nodes << std::setw(12) << total_time << std::setw(12) << total_simplified_time << '\n';
+  return 0;
+}
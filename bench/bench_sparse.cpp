@@ -0,0 +1,59 @@
+// Full symbolic gradient (d/dx_i for every i) evaluated on the trees, in growing dimension.
+// One-hot values make the d/dx_i of norm2(x) O(1); derivatives that keep a dense dot(x,x) stay O(d).
+// Then the gradient of a sum of x_k*x_k over one coordinate in ten is built by partial_derivatives: each term is
+// differentiated along its own coordinates only, the others share the zero function.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+int main(int argc, char** argv) {
+  std::vector<std::string> expressions = {"norm2(x)", "exp(-0.5*dot(x,x))", "dot(x,2*x-x/e)"};
+  if (argc > 1)
+    expressions.assign(argv + 1, argv + argc);
+
+  std::cout << std::left << std::setw(26) << "expression" << std::right << std::setw(10) << "dimension"
+            << std::setw(16) << "gradient (ms)" << std::setw(16) << "per d/dx_i (us)" << '\n';
+  for (const std::string& expression : expressions) {
+    string_input in(expression, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> f = build_function(*parse(in));
+    for (const Index d : {Index{100}, Index{1000}, Index{10000}}) {
+      const Vector x(d, 0.5);
+      std::vector<ScalarFunctionPtr> derivatives;
+      for (Index i = 0; i < d; ++i) {
+        derivatives.push_back(f->diff(i, DiffOptions{true}));
+      }
+      volatile Number sink = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for (const auto& derivative : derivatives) {
+        sink = sink + derivative->apply(x);
+      }
+      const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      std::cout << std::left << std::setw(26) << expression << std::right << std::setw(10) << d << std::fixed
+                << std::setprecision(2) << std::setw(16) << ms << std::setw(16) << 1000 * ms / d << '\n';
+    }
+  }
+
+  std::cout << '\n'
+            << std::setw(10) << "dimension" << std::setw(10) << "nonzeros" << std::setw(16) << "gradient (ms)"
+            << std::setw(18) << "per nonzero (us)" << '\n';
+  for (const Index d : {Index{1000}, Index{10000}, Index{100000}}) {
+    std::string expression = "x_0*x_0";
+    for (Index k = 10; k < d; k += 10)
+      expression += "+x_" + std::to_string(k) + "*x_" + std::to_string(k);
+    string_input in(expression, "benchmark expression");
+    const std::unique_ptr<IScalarFunction> f = build_function(*parse(in));
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<ScalarFunctionPtr> gradient = partial_derivatives(*f, 0, d, DiffOptions{true});
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const Index nonzeros = dependencies(*f).indices.size();
+    std::cout << std::setw(10) << d << std::setw(10) << nonzeros << std::fixed << std::setprecision(2)
+              << std::setw(16) << ms << std::setw(18) << 1000 * ms / nonzeros << '\n';
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Performance harness: parse, build_function, direct parsing (parse_function), diff and apply on generated
+// expression families, parameterized by depth, width and vector dimension.
+// Results are printed as CSV (one line per family, size and operation) to be compared between commits:
+//   family,depth,width,dimension,operation,ns_per_op,allocations_per_op,bytes_per_op,dag_nodes,tree_nodes
+// Node counts are those of the built function, and of the derivative for diff.
+// An optional argument gives the minimal measurement time per operation in milliseconds (default 20).
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/AllocationCounter.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+struct Measure {
+  double ns = 0;
+  double allocations = 0;
+  double bytes = 0;
+};
+
+// repeats f until min_ms is spent (at least once), after one warm-up call
+template <typename F>
+Measure measure(F&& f, const double min_ms) {
+  f();
+  std::size_t repeat = 1;
+  while (true) {
+    const AllocationCounter counter;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t r = 0; r < repeat; ++r) {
+      f();
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (ns >= min_ms * 1e6 || repeat >= (std::size_t{1} << 24)) {
+      const auto n = static_cast<double>(repeat);
+      const AllocationCount count = counter.count();
+      return {ns / n, static_cast<double>(count.allocations) / n, static_cast<double>(count.bytes) / n};
+    }
+    repeat *= 2;
+  }
+}
+
+std::string component(const Index i, const Index dimension) {
+  return "x_" + std::to_string(i % dimension);
+}
+
+// sum of `width` terms, each a product chain of `depth` coordinates: scalar nodes only
+std::string scalar_family(const Index depth, const Index width, const Index dimension) {
+  std::string sum;
+  for (Index w = 0; w < width; ++w) {
+    std::string term = component(w, dimension);
+    for (Index k = 1; k <= depth; ++k) {
+      term = "(" + term + "*" + component(w + k, dimension) + "+" + std::to_string(k) + ")";
+    }
+    sum += ((w == 0) ? "" : "+") + term;
+  }
+  return sum;
+}
+
+// sum of `width` gaussian-like terms over a vector expression nested `depth` times
+std::string vector_family(const Index depth, const Index width, const Index dimension) {
+  std::string v = "x";
+  for (Index k = 1; k <= depth; ++k) {
+    v = "(" + v + "/" + std::to_string(k + 1) + "-" + component(k, dimension) + "*x)";
+  }
+  std::string sum;
+  for (Index w = 0; w < width; ++w) {
+    sum += ((w == 0) ? "" : "+") + std::string{"exp(-norm2("} + v + ")/" + std::to_string(w + 1) + ")*dot(x,"
+           + component(w, dimension) + "*x)";
+  }
+  return sum;
+}
+
+void report(const std::string& family,
+            const Index depth,
+            const Index width,
+            const Index dimension,
+            const char* operation,
+            const Measure& m,
+            const IFunction& f) {
+  std::cout << family << ',' << depth << ',' << width << ',' << dimension << ',' << operation << ',' << m.ns << ','
+            << m.allocations << ',' << m.bytes << ',' << dag_size(f) << ',' << tree_size(f) << '\n';
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const double min_ms = (argc > 1) ? std::stod(argv[1]) : 20;
+
+  using Generator = std::string (*)(Index, Index, Index);
+  const std::vector<std::pair<std::string, Generator>> families = {{"scalar", scalar_family},
+                                                                   {"vector", vector_family}};
+
+  std::cout << "family,depth,width,dimension,operation,ns_per_op,allocations_per_op,bytes_per_op,dag_nodes,tree_nodes\n";
+  for (const auto& [family, generate] : families) {
+    for (const Index depth : {Index{1}, Index{4}, Index{16}}) {
+      for (const Index width : {Index{1}, Index{8}, Index{64}}) {
+        for (const Index dimension : {Index{3}, Index{32}, Index{1024}}) {
+          const std::string expression = generate(depth, width, dimension);
+          string_input in(expression, "benchmark expression");
+          const std::unique_ptr<ASTNode> tree = parse(in);
+          const std::unique_ptr<IScalarFunction> f = build_function(*tree);
+          const ScalarFunctionPtr df = f->diff(0);
+          const Vector x(dimension, 0.5);
+
+          const Measure parsing = measure(
+              [&] {
+                string_input input(expression, "benchmark expression");
+                (void)parse(input);
+              },
+              min_ms);
+          report(family, depth, width, dimension, "parse", parsing, *f);
+          // nodes are interned: rebuilding finds them in the intern table
+          const Measure build = measure([&] { (void)build_function(*tree); }, min_ms);
+          report(family, depth, width, dimension, "build", build, *f);
+          // parse + build without parse tree
+          const Measure direct = measure(
+              [&] {
+                string_input input(expression, "benchmark expression");
+                (void)parse_function(input);
+              },
+              min_ms);
+          report(family, depth, width, dimension, "direct", direct, *f);
+          const Measure diff = measure([&] { (void)f->diff(0); }, min_ms);
+          report(family, depth, width, dimension, "diff", diff, *df);
+          volatile Number sink = 0;
+          const Measure apply = measure([&] { sink = sink + f->apply(x); }, min_ms);
+          report(family, depth, width, dimension, "apply", apply, *f);
+        }
+      }
+    }
+  }
+  return 0;
+}
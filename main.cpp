@@ -1,18 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
 
 #include <tao/pegtl/contrib/parse_tree_to_dot.hpp>
 #include "src/ASTNode.hpp"
+#include "src/BatchEvaluator.hpp"
+#include "src/BulkLoader.hpp"
 #include "src/Demangle.hpp"
+#include "src/PointStream.hpp"
 using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
 
 #include "src/grammar.hpp"
 
+namespace {
+void usage(const char* program) {
+  std::cerr << "Usage: " << program << " EXPR\n"
+            << "Generate a 'dot' file from expression.\n\n"
+            << "Example: " << program << " \"(2*a + 3*b) / (4*n)\" | dot -Tpng -o parse_tree.png\n\n"
+            << "Usage: " << program << " --eval EXPR --dimension D [OPTIONS]\n"
+            << "Evaluate expression on a stream of points of dimension D (CSV lines read from stdin by default).\n"
+            << "  --input FILE           raw binary points (native doubles, point after point)\n"
+            << "  --gradient             write the gradient after each value\n"
+            << "  --output-format FMT    csv (default) or binary\n"
+            << "  --block N              points per block (default 65536)\n"
+            << "  --threads N            evaluation threads (default: hardware concurrency)\n"
+            << "Throughput is reported on stderr.\n\n"
+            << "Usage: " << program << " --load FILE [--threads N]\n"
+            << "Parse and build in parallel a catalogue of expressions (lines 'expression' or 'name = expression').\n"
+            << "Built functions are written in catalogue order, errors and latencies are reported on stderr.\n";
+}
+
+// message, expression and a caret under the error, as BulkLoader reports them
+void report(const parse_error& e, const string_input<>& in) {
+  const auto p = e.positions.front();
+  std::cerr << e.what() << std::endl << in.line_at(p) << std::endl << std::string(p.byte_in_line, ' ') << '^' << std::endl;
+}
+
+int load_mode(int argc, char** argv) {
+  std::string filename;
+  std::size_t threads = std::thread::hardware_concurrency();
+  for (int i = 1; i < argc; i += 2) {
+    const std::string option = argv[i];
+    if (i + 1 == argc || (option != "--load" && option != "--threads")) {  // no other option applies
+      usage(argv[0]);
+      return 1;
+    }
+    const std::string value = argv[i + 1];
+    if (option == "--load") {
+      filename = value;
+    } else {
+      threads = std::stoul(value);
+    }
+  }
+
+  std::ifstream file(filename);
+  if (!file) {
+    std::cerr << "cannot read " << filename << std::endl;
+    return 1;
+  }
+  const std::vector<CatalogueRecord> records = read_catalogue(file);
+  ThreadPool pool(threads);
+  const BulkLoad load = load_catalogue(records, pool, filename);
+
+  for (std::size_t k = 0; k < records.size(); ++k) {
+    const LoadedFunction& loaded = load.functions[k];
+    if (loaded.function) {
+      std::cout << records[k].line << '\t' << records[k].name << '\t' << loaded.function->string() << '\n';
+    } else {
+      std::cerr << loaded.error << std::endl;
+    }
+  }
+  std::cout.flush();
+  std::cerr << records.size() << " expressions (" << load.failures() << " failed) in " << load.seconds << " s ("
+            << load.throughput() << " expressions/s), latency p50 " << 1e6 * load.latency(0.5) << " us, p99 "
+            << 1e6 * load.latency(0.99) << " us\n";
+  return (load.failures() == 0) ? 0 : 1;
+}
+
+int stream_mode(int argc, char** argv) {
+  std::string expression, input;
+  Index dimension = 0, block = 65536;
+  std::size_t threads = std::thread::hardware_concurrency();
+  bool gradient = false;
+  StreamFormat format = StreamFormat::Csv;
+  for (int i = 1; i < argc; ++i) {
+    const std::string option = argv[i];
+    if (option == "--gradient") {
+      gradient = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    const std::string value = argv[++i];
+    if (option == "--eval") {
+      expression = value;
+    } else if (option == "--dimension") {
+      dimension = std::stoul(value);
+    } else if (option == "--input") {
+      input = value;
+    } else if (option == "--output-format" && (value == "csv" || value == "binary")) {
+      format = (value == "csv") ? StreamFormat::Csv : StreamFormat::Binary;
+    } else if (option == "--block") {
+      block = std::stoul(value);
+    } else if (option == "--threads") {
+      threads = std::stoul(value);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (dimension == 0 || block == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  string_input in(expression, "from command line");
+  std::unique_ptr<IScalarFunction> f;
+  try {
+    f = build_function(*parse(in));
+  } catch (const parse_error& e) {
+    report(e, in);
+    return 1;
+  }
+  ThreadPool pool(threads);
+  const BatchEvaluator evaluator(*f, pool);
+
+  std::ios::sync_with_stdio(false);
+  std::unique_ptr<PointSource> source;
+  if (input.empty()) {
+    source = std::make_unique<CsvPointReader>(std::cin, dimension);
+  } else {
+    source = std::make_unique<BinaryPointFile>(input, dimension);
+  }
+  ResultWriter writer(std::cout, format);
+
+  const auto start = std::chrono::steady_clock::now();
+  Index count = 0;
+  for (VectorBlock points = source->read(block); points.count > 0; points = source->read(block)) {
+    writer.write(evaluator.apply(points), (gradient) ? evaluator.gradient(points) : VectorBlock{});
+    count += points.count;
+  }
+  std::cout.flush();
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << count << " points in " << seconds << " s (" << count / seconds << " points/s)\n";
+  return 0;
+}
+}  // namespace
+
 int main(int argc, char** argv) {
   if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " EXPR\n"
-              << "Generate a 'dot' file from expression.\n\n"
-              << "Example: " << argv[0] << " \"(2*a + 3*b) / (4*n)\" | dot -Tpng -o parse_tree.png\n";
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (std::strncmp(argv[1], "--", 2) == 0) {
+    const bool load = std::any_of(argv + 1, argv + argc, [](const char* arg) { return std::strcmp(arg, "--load") == 0; });
+    try {
+      return (load) ? load_mode(argc, argv) : stream_mode(argc, argv);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
     return 1;
   }
 
@@ -27,10 +179,7 @@ int main(int argc, char** argv) {
       Vector x = {1, 2, 3};
       std::cerr << "f({1,2}) = " << a->apply(x) << std::endl;
     } catch (const parse_error& e) {
-      const auto p = e.positions.front();
-      std::cerr << e.what() << std::endl
-                << in.line_at(p) << std::endl
-                << std::string(p.byte_in_line, ' ') << '^' << std::endl;
+      report(e, in);
     } catch (const std::exception& e) {
       std::cerr << e.what() << std::endl;
     }
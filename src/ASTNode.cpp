@@ -3,33 +3,82 @@
 //
 
 #include "ASTNode.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include "Demangle.hpp"
+#include "ExpressionArena.hpp"
+#include "Kernels.hpp"
+#include "Tape.hpp"
 #include "grammar_symbol.hpp"
 
+namespace {
+//! bytes of s held outside of its object (none while the characters fit in the string itself)
+std::size_t heap_size(const std::pmr::string& s) {
+  return (s.capacity() > std::pmr::string().capacity()) ? s.capacity() + 1 : 0;
+}
+//! shared zero vector: the derivative of a vector function along the coordinates it does not depend on
+VectorFunctionPtr zero_vector_function();
+}  // namespace
+
 class ScalarNumber : public IScalarFunction {
  public:
-  explicit ScalarNumber(std::string s) : m_s(std::move(s)), m_number(std::stod(m_s)) {}
-  explicit ScalarNumber(Number x) : m_s(std::to_string(x)), m_number(x) {}
+  explicit ScalarNumber(std::string_view s)
+      : m_s(s, ExpressionArena::current_resource()), m_number(std::stod(std::string{s})) {}
+  explicit ScalarNumber(Number x) : m_s(format(x), ExpressionArena::current_resource()), m_number(x) {}
 
-  [[nodiscard]] std::string string() const override { return m_s; }
+  [[nodiscard]] Number value() const { return m_number; }
+
+  [[nodiscard]] std::string string() const override { return std::string{m_s}; }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override { return std::make_unique<ScalarNumber>(m_s); }
   [[nodiscard]] auto apply(const Vector& x) const -> Number override { return m_number; }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override { return m_number; }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override { return Vector(x.count, m_number); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarNumber>("0");
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this) + heap_size(m_s); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), m_s}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override { return zero_function(); }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override { return builder.constant(m_number); }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override { return {m_number, 0}; }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    return {m_number, Vector(directions.count, Number{0})};
   }
 
  private:
-  std::string m_s;  //! keep string to get exact registered form
+  std::pmr::string m_s;  //! keep string to get exact registered form
   Number m_number;
+
+ public:
+  //! shortest decimal form that reads back as x
+  static std::string format(const Number x) {
+    std::ostringstream oss;
+    for (int precision = 1; precision <= 17; ++precision) {
+      oss.str("");
+      oss << std::setprecision(precision) << x;
+      if (std::stod(oss.str()) == x)
+        break;
+    }
+    return oss.str();
+  }
 };
 
 class ScalarValue : public IScalarFunction {
  public:
-  explicit ScalarValue(std::string s) : m_s(std::move(s)) {}
+  explicit ScalarValue(std::string_view s) : m_s(s, ExpressionArena::current_resource()) {}
 
-  [[nodiscard]] std::string string() const override { return m_s; }
+  [[nodiscard]] std::string string() const override { return std::string{m_s}; }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override { return std::make_unique<ScalarValue>(m_s); }
   [[nodiscard]] Number apply(const Vector& x) const override {
     if (m_s == "pi") {
@@ -37,16 +86,25 @@ class ScalarValue : public IScalarFunction {
     } else if (m_s == "e") {
       return exp(1);
     } else {
-      throw NotImplementedException(__PRETTY_FUNCTION__, "[symbol=" + m_s + "]");
+      throw NotImplementedException(__PRETTY_FUNCTION__, "[symbol=" + std::string{m_s} + "]");
     }
   }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override { return apply(x); }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override { return Vector(x.count, apply(Vector{})); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarNumber>("0");
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this) + heap_size(m_s); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), m_s}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override { return zero_function(); }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override { return builder.constant(apply(Vector{})); }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override { return {apply(x), 0}; }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    return {apply(x), Vector(directions.count, Number{0})};
   }
 
  private:
-  std::string m_s;
+  std::pmr::string m_s;
 };
 
 class VectorZero : public IVectorFunction {
@@ -54,9 +112,26 @@ class VectorZero : public IVectorFunction {
   explicit VectorZero() {}
   [[nodiscard]] std::string string() const override { return "<x_i=0>"; }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override { return std::make_unique<VectorZero>(); }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(x); }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override { return VectorValue::zero(x.size()); }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    std::fill_n(out.data, out.size, Number{0});
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    return VectorBlock(x.dimension, x.count);
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override { return std::make_unique<VectorZero>(); }
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override { return std::make_unique<VectorZero>(); }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override { return builder.vector(OpCode::VectorZero); }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    return {impl(x), impl(x)};
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    return {impl(x), VectorBlock(directions.dimension, directions.count)};
+  }
 
  public:
   static Vector impl(const Vector& a) {
@@ -68,13 +143,39 @@ class VectorZero : public IVectorFunction {
 class VectorPartialOne : public IVectorFunction {
  public:
   explicit VectorPartialOne(Index index) : m_index(index) {}
+
+  [[nodiscard]] Index index() const { return m_index; }
   [[nodiscard]] std::string string() const override { return "<x_" + std::to_string(m_index) + "=1>"; }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
     return std::make_unique<VectorPartialOne>(m_index);
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(x, m_index); }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override {
+    return VectorValue::one_hot(x.size(), m_index);
+  }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    std::fill_n(out.data, out.size, Number{0});
+    out[m_index] = 1;
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    VectorBlock result(x.dimension, x.count);
+    std::fill_n(result.component(m_index), result.count, Number{1});
+    return result;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override { return std::make_unique<VectorZero>(); }
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, m_index}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override { return std::make_unique<VectorZero>(); }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.vector(OpCode::VectorPartialOne, m_index);
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    return {impl(x, m_index), VectorZero::impl(x)};
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    return {impl(x, m_index), VectorBlock(directions.dimension, directions.count)};
+  }
 
  private:
   Index m_index;
@@ -89,308 +190,749 @@ class VectorPartialOne : public IVectorFunction {
 
 class ScalarAdd : public IScalarFunction {
  public:
-  explicit ScalarAdd(std::unique_ptr<IScalarFunction>&& a, std::unique_ptr<IScalarFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit ScalarAdd(ScalarOperand a, ScalarOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const ScalarFunctionPtr& lhs() const { return m_a; }
+  [[nodiscard]] const ScalarFunctionPtr& rhs() const { return m_b; }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "+" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarAdd>(m_a->clone(), m_b->clone());
+    return std::make_unique<ScalarAdd>(m_a, m_b);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return m_a->apply(x) + m_b->apply(x); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    return m_a->apply(x, workspace) + m_b->apply(x, workspace);
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_a->apply_batch(x);
+    kernels::add(a.data(), a.data(), m_b->apply_batch(x).data(), a.size());
+    return a;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Term; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarAdd>(m_a->diff(I), m_b->diff(I));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    ScalarFunctionPtr a = m_a->diff(I);
+    ScalarFunctionPtr b = m_b->diff(I);
+    const ScalarFunctionPtr zero = zero_function();
+    if (a == zero)
+      return b;  // no 0+ node: a sum of n terms has a derivative of the size of its dependent terms
+    if (b == zero)
+      return a;
+    return std::make_unique<ScalarAdd>(std::move(a), std::move(b));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Add, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    const Tangent b = m_b->apply_tangent(x, v);
+    return {a.value + b.value, a.derivative + b.derivative};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_a->apply_tangents(x, directions);
+    const Tangents b = m_b->apply_tangents(x, directions);
+    a.value += b.value;
+    kernels::add(a.derivatives.data(), a.derivatives.data(), b.derivatives.data(), a.derivatives.size());
+    return a;
   }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
-  std::unique_ptr<IScalarFunction> m_b;
+  ScalarFunctionPtr m_a;
+  ScalarFunctionPtr m_b;
 };
 
 class ScalarSub : public IScalarFunction {
  public:
-  explicit ScalarSub(std::unique_ptr<IScalarFunction>&& a, std::unique_ptr<IScalarFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit ScalarSub(ScalarOperand a, ScalarOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const ScalarFunctionPtr& lhs() const { return m_a; }
+  [[nodiscard]] const ScalarFunctionPtr& rhs() const { return m_b; }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "-" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarSub>(m_a->clone(), m_b->clone());
+    return std::make_unique<ScalarSub>(m_a, m_b);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return m_a->apply(x) - m_b->apply(x); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    return m_a->apply(x, workspace) - m_b->apply(x, workspace);
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_a->apply_batch(x);
+    kernels::sub(a.data(), a.data(), m_b->apply_batch(x).data(), a.size());
+    return a;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Term; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarSub>(m_a->diff(I), m_b->diff(I));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    ScalarFunctionPtr a = m_a->diff(I);
+    ScalarFunctionPtr b = m_b->diff(I);
+    if (b == zero_function())
+      return a;
+    return std::make_unique<ScalarSub>(std::move(a), std::move(b));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Sub, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    const Tangent b = m_b->apply_tangent(x, v);
+    return {a.value - b.value, a.derivative - b.derivative};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_a->apply_tangents(x, directions);
+    const Tangents b = m_b->apply_tangents(x, directions);
+    a.value -= b.value;
+    kernels::sub(a.derivatives.data(), a.derivatives.data(), b.derivatives.data(), a.derivatives.size());
+    return a;
   }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
-  std::unique_ptr<IScalarFunction> m_b;
+  ScalarFunctionPtr m_a;
+  ScalarFunctionPtr m_b;
 };
 
 class VectorAdd : public IVectorFunction {
  public:
-  explicit VectorAdd(std::unique_ptr<IVectorFunction>&& a, std::unique_ptr<IVectorFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit VectorAdd(VectorOperand a, VectorOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "+" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
-    return std::make_unique<VectorAdd>(m_a->clone(), m_b->clone());
+    return std::make_unique<VectorAdd>(m_a, m_b);
+  }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override {
+    return VectorValue::add(m_a->apply(x), m_b->apply(x));
+  }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    const Workspace::Buffer b(workspace, out.size);
+    m_a->apply_into(x, out, workspace);
+    m_b->apply_into(x, b.span(), workspace);
+    kernels::add(out.data, out.data, b.data(), out.size);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    VectorBlock a = m_a->apply_batch(x);
+    a.data = impl(std::move(a.data), m_b->apply_batch(x).data);
+    return a;
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(m_a->apply(x), m_b->apply(x)); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Term; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override {
-    return std::make_unique<VectorAdd>(m_a->diff(I), m_b->diff(I));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override {
+    VectorFunctionPtr a = m_a->diff(I);
+    VectorFunctionPtr b = m_b->diff(I);
+    const VectorFunctionPtr zero = zero_vector_function();
+    if (a == zero)
+      return b;
+    if (b == zero)
+      return a;
+    return std::make_unique<VectorAdd>(std::move(a), std::move(b));
+  }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.vector(OpCode::VectorAdd, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    VectorTangent a = m_a->apply_tangent(x, v);
+    const VectorTangent b = m_b->apply_tangent(x, v);
+    return {impl(std::move(a.value), b.value), impl(std::move(a.derivative), b.derivative)};
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    VectorTangents a = m_a->apply_tangents(x, directions);
+    const VectorTangents b = m_b->apply_tangents(x, directions);
+    a.value = impl(std::move(a.value), b.value);
+    a.derivatives.data = impl(std::move(a.derivatives.data), b.derivatives.data);
+    return a;
   }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
-  std::unique_ptr<IVectorFunction> m_b;
+  VectorFunctionPtr m_a;
+  VectorFunctionPtr m_b;
 
  public:
   static Vector impl(Vector a, const Vector& b) {
     assert(a.size() == b.size());
-    Vector result{};
-    for (std::size_t i = 0; i < a.size(); ++i) {
-      a[i] += b[i];
-    }
+    kernels::add(a.data(), a.data(), b.data(), a.size());
     return a;
   }
 };
 
 class VectorSub : public IVectorFunction {
  public:
-  explicit VectorSub(std::unique_ptr<IVectorFunction>&& a, std::unique_ptr<IVectorFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit VectorSub(VectorOperand a, VectorOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const VectorFunctionPtr& lhs() const { return m_a; }
+  [[nodiscard]] const VectorFunctionPtr& rhs() const { return m_b; }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "-" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
-    return std::make_unique<VectorSub>(m_a->clone(), m_b->clone());
+    return std::make_unique<VectorSub>(m_a, m_b);
+  }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override {
+    return VectorValue::sub(m_a->apply(x), m_b->apply(x));
+  }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    const Workspace::Buffer b(workspace, out.size);
+    m_a->apply_into(x, out, workspace);
+    m_b->apply_into(x, b.span(), workspace);
+    kernels::sub(out.data, out.data, b.data(), out.size);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    VectorBlock a = m_a->apply_batch(x);
+    a.data = impl(std::move(a.data), m_b->apply_batch(x).data);
+    return a;
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(m_a->apply(x), m_b->apply(x)); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Term; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override {
-    return std::make_unique<VectorSub>(m_a->diff(I), m_b->diff(I));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override {
+    VectorFunctionPtr a = m_a->diff(I);
+    VectorFunctionPtr b = m_b->diff(I);
+    if (b == zero_vector_function())
+      return a;
+    return std::make_unique<VectorSub>(std::move(a), std::move(b));
+  }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.vector(OpCode::VectorSub, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    VectorTangent a = m_a->apply_tangent(x, v);
+    const VectorTangent b = m_b->apply_tangent(x, v);
+    return {impl(std::move(a.value), b.value), impl(std::move(a.derivative), b.derivative)};
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    VectorTangents a = m_a->apply_tangents(x, directions);
+    const VectorTangents b = m_b->apply_tangents(x, directions);
+    a.value = impl(std::move(a.value), b.value);
+    a.derivatives.data = impl(std::move(a.derivatives.data), b.derivatives.data);
+    return a;
   }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
-  std::unique_ptr<IVectorFunction> m_b;
+  VectorFunctionPtr m_a;
+  VectorFunctionPtr m_b;
 
  public:
   static Vector impl(Vector a, const Vector& b) {
     assert(a.size() == b.size());
-    Vector result{};
-    for (std::size_t i = 0; i < a.size(); ++i) {
-      a[i] -= b[i];
-    }
+    kernels::sub(a.data(), a.data(), b.data(), a.size());
     return a;
   }
 };
 
 class ScalarPrefixPlus : public IScalarFunction {
  public:
-  explicit ScalarPrefixPlus(std::unique_ptr<IScalarFunction>&& a) : m_a(std::move(a)) {}
+  explicit ScalarPrefixPlus(ScalarOperand a) : m_a(std::move(a)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return "+" + strHelper(*m_a); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarPrefixPlus>(m_a->clone());
+    return std::make_unique<ScalarPrefixPlus>(m_a);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return m_a->apply(x); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override { return m_a->apply(x, workspace); }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override { return m_a->apply_batch(x); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Prefixed; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override { return m_a->diff(I); }
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override { return m_a->diff(I); }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override { return m_a->compile(builder); }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    return m_a->apply_tangent(x, v);
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    return m_a->apply_tangents(x, directions);
+  }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
+  ScalarFunctionPtr m_a;
 };
 
 class ScalarPrefixMinus : public IScalarFunction {
  public:
-  explicit ScalarPrefixMinus(std::unique_ptr<IScalarFunction>&& a) : m_a(std::move(a)) {}
+  explicit ScalarPrefixMinus(ScalarOperand a) : m_a(std::move(a)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const ScalarFunctionPtr& operand() const { return m_a; }
 
   [[nodiscard]] std::string string() const override { return "-" + strHelper(*m_a); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarPrefixMinus>(m_a->clone());
+    return std::make_unique<ScalarPrefixMinus>(m_a);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return -m_a->apply(x); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override { return -m_a->apply(x, workspace); }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_a->apply_batch(x);
+    kernels::negate(a.data(), a.data(), a.size());
+    return a;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Prefixed; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
     return std::make_unique<ScalarPrefixMinus>(m_a->diff(I));
   }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Neg, m_a->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    return {-a.value, -a.derivative};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_a->apply_tangents(x, directions);
+    a.value = -a.value;
+    kernels::negate(a.derivatives.data(), a.derivatives.data(), a.derivatives.size());
+    return a;
+  }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
+  ScalarFunctionPtr m_a;
 };
 
 class VectorPrefixPlus : public IVectorFunction {
  public:
-  explicit VectorPrefixPlus(std::unique_ptr<IVectorFunction>&& a) : m_a(std::move(a)) {}
+  explicit VectorPrefixPlus(VectorOperand a) : m_a(std::move(a)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const VectorFunctionPtr& operand() const { return m_a; }
 
   [[nodiscard]] std::string string() const override { return "+" + strHelper(*m_a); }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override { return m_a->clone(); }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return m_a->apply(x); }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
+    return std::make_unique<VectorPrefixPlus>(m_a);
+  }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override { return m_a->apply(x); }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    m_a->apply_into(x, out, workspace);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override { return m_a->apply_batch(x); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Prefixed; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override { return m_a->diff(I); }
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get()}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override { return m_a->diff(I); }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override { return m_a->compile(builder); }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    return m_a->apply_tangent(x, v);
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    return m_a->apply_tangents(x, directions);
+  }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
+  VectorFunctionPtr m_a;
 };
 
 class VectorPrefixMinus : public IVectorFunction {
  public:
-  explicit VectorPrefixMinus(std::unique_ptr<IVectorFunction>&& a) : m_a(std::move(a)) {}
+  explicit VectorPrefixMinus(VectorOperand a) : m_a(std::move(a)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const VectorFunctionPtr& operand() const { return m_a; }
 
   [[nodiscard]] std::string string() const override { return "-" + strHelper(*m_a); }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
-    return std::make_unique<VectorPrefixMinus>(m_a->clone());
+    return std::make_unique<VectorPrefixMinus>(m_a);
+  }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override { return VectorValue::negate(m_a->apply(x)); }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    m_a->apply_into(x, out, workspace);
+    kernels::negate(out.data, out.data, out.size);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    VectorBlock a = m_a->apply_batch(x);
+    a.data = impl(std::move(a.data));
+    return a;
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(m_a->apply(x)); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Prefixed; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get()}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override {
     return std::make_unique<VectorPrefixMinus>(m_a->diff(I));
   }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.vector(OpCode::VectorNeg, m_a->compile(builder));
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    VectorTangent a = m_a->apply_tangent(x, v);
+    return {impl(std::move(a.value)), impl(std::move(a.derivative))};
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    VectorTangents a = m_a->apply_tangents(x, directions);
+    a.value = impl(std::move(a.value));
+    a.derivatives.data = impl(std::move(a.derivatives.data));
+    return a;
+  }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
+  VectorFunctionPtr m_a;
 
  public:
   static Vector impl(Vector a) {
-    for (double& ai : a) {
-      ai *= -1;
-    }
+    kernels::negate(a.data(), a.data(), a.size());
     return a;
   }
 };
 
 class ScalarScalarProduct : public IScalarFunction {
  public:
-  explicit ScalarScalarProduct(std::unique_ptr<IScalarFunction>&& a, std::unique_ptr<IScalarFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit ScalarScalarProduct(ScalarOperand a, ScalarOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "*" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarScalarProduct>(m_a->clone(), m_b->clone());
+    return std::make_unique<ScalarScalarProduct>(m_a, m_b);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return m_a->apply(x) * m_b->apply(x); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    return m_a->apply(x, workspace) * m_b->apply(x, workspace);
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_a->apply_batch(x);
+    kernels::multiply(a.data(), a.data(), m_b->apply_batch(x).data(), a.size());
+    return a;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Factor; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarAdd>(std::make_unique<ScalarScalarProduct>(m_a->clone(), m_b->diff(I)),
-                                       std::make_unique<ScalarScalarProduct>(m_a->diff(I), m_b->clone()));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    return std::make_unique<ScalarAdd>(std::make_unique<ScalarScalarProduct>(m_a, m_b->diff(I)),
+                                       std::make_unique<ScalarScalarProduct>(m_a->diff(I), m_b));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Mul, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    const Tangent b = m_b->apply_tangent(x, v);
+    return {a.value * b.value, a.value * b.derivative + a.derivative * b.value};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_a->apply_tangents(x, directions);
+    const Tangents b = m_b->apply_tangents(x, directions);
+    for (std::size_t p = 0; p < a.derivatives.size(); ++p) {
+      a.derivatives[p] = a.value * b.derivatives[p] + a.derivatives[p] * b.value;
+    }
+    a.value *= b.value;
+    return a;
   }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
-  std::unique_ptr<IScalarFunction> m_b;
+  ScalarFunctionPtr m_a;
+  ScalarFunctionPtr m_b;
 };
 
 class ScalarVectorProduct : public IVectorFunction {
  public:
-  explicit ScalarVectorProduct(std::unique_ptr<IScalarFunction>&& a, std::unique_ptr<IVectorFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit ScalarVectorProduct(ScalarOperand a, VectorOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const ScalarFunctionPtr& lhs() const { return m_a; }
+  [[nodiscard]] const VectorFunctionPtr& rhs() const { return m_b; }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "*" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
-    return std::make_unique<ScalarVectorProduct>(m_a->clone(), m_b->clone());
+    return std::make_unique<ScalarVectorProduct>(m_a, m_b);
+  }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override {
+    return VectorValue::scale(m_a->apply(x), m_b->apply(x));
+  }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    const Number a = m_a->apply(x, workspace);
+    m_b->apply_into(x, out, workspace);
+    kernels::scale(out.data, out.data, a, out.size);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    const Vector a = m_a->apply_batch(x);
+    VectorBlock b = m_b->apply_batch(x);
+    for (std::size_t i = 0; i < b.dimension; ++i) {
+      kernels::multiply(b.component(i), b.component(i), a.data(), b.count);
+    }
+    return b;
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(m_a->apply(x), m_b->apply(x)); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Factor; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override {
-    return std::make_unique<VectorAdd>(std::make_unique<ScalarVectorProduct>(m_a->clone(), m_b->diff(I)),
-                                       std::make_unique<ScalarVectorProduct>(m_a->diff(I), m_b->clone()));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override {
+    return std::make_unique<VectorAdd>(std::make_unique<ScalarVectorProduct>(m_a, m_b->diff(I)),
+                                       std::make_unique<ScalarVectorProduct>(m_a->diff(I), m_b));
+  }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.vector(OpCode::ScalarVectorProduct, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    VectorTangent b = m_b->apply_tangent(x, v);
+    for (std::size_t i = 0; i < b.value.size(); ++i) {
+      b.derivative[i] = a.value * b.derivative[i] + a.derivative * b.value[i];
+      b.value[i] *= a.value;
+    }
+    return b;
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    const Tangents a = m_a->apply_tangents(x, directions);
+    VectorTangents b = m_b->apply_tangents(x, directions);
+    for (std::size_t i = 0; i < b.value.size(); ++i) {
+      Number* derivatives = b.derivatives.component(i);
+      for (std::size_t p = 0; p < b.derivatives.count; ++p) {
+        derivatives[p] = a.value * derivatives[p] + a.derivatives[p] * b.value[i];
+      }
+      b.value[i] *= a.value;
+    }
+    return b;
   }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
-  std::unique_ptr<IVectorFunction> m_b;
+  ScalarFunctionPtr m_a;
+  VectorFunctionPtr m_b;
 
  public:
   static Vector impl(const Number a, Vector b) {
-    for (std::size_t i = 0; i < b.size(); ++i) {
-      b[i] *= a;
-    }
+    kernels::scale(b.data(), b.data(), a, b.size());
     return b;
   }
 };
 
 class VectorScalarDivide : public IVectorFunction {
  public:
-  explicit VectorScalarDivide(std::unique_ptr<IVectorFunction>&& a, std::unique_ptr<IScalarFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit VectorScalarDivide(VectorOperand a, ScalarOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
+
+  [[nodiscard]] const VectorFunctionPtr& lhs() const { return m_a; }
+  [[nodiscard]] const ScalarFunctionPtr& rhs() const { return m_b; }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "/" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
-    return std::make_unique<VectorScalarDivide>(m_a->clone(), m_b->clone());
+    return std::make_unique<VectorScalarDivide>(m_a, m_b);
+  }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override {
+    return VectorValue::scale_divide(m_a->apply(x), m_b->apply(x));
+  }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    m_a->apply_into(x, out, workspace);
+    kernels::scale_divide(out.data, out.data, m_b->apply(x, workspace), out.size);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    VectorBlock a = m_a->apply_batch(x);
+    const Vector b = m_b->apply_batch(x);
+    for (std::size_t i = 0; i < a.dimension; ++i) {
+      kernels::divide(a.component(i), a.component(i), b.data(), a.count);
+    }
+    return a;
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return impl(m_a->apply(x), m_b->apply(x)); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Quotient; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override {
     return std::make_unique<VectorScalarDivide>(
-        std::make_unique<VectorSub>(std::make_unique<ScalarVectorProduct>(m_b->clone(), m_a->diff(I)),
-                                    std::make_unique<ScalarVectorProduct>(m_b->diff(I), m_a->clone())),
-        std::make_unique<ScalarScalarProduct>(m_b->clone(), m_b->clone()));
+        std::make_unique<VectorSub>(std::make_unique<ScalarVectorProduct>(m_b, m_a->diff(I)),
+                                    std::make_unique<ScalarVectorProduct>(m_b->diff(I), m_a)),
+        std::make_unique<ScalarScalarProduct>(m_b, m_b));
+  }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.vector(OpCode::VectorScalarDivide, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    VectorTangent a = m_a->apply_tangent(x, v);
+    const Tangent b = m_b->apply_tangent(x, v);
+    for (std::size_t i = 0; i < a.value.size(); ++i) {
+      a.value[i] /= b.value;
+      a.derivative[i] = (a.derivative[i] - a.value[i] * b.derivative) / b.value;
+    }
+    return a;
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    VectorTangents a = m_a->apply_tangents(x, directions);
+    const Tangents b = m_b->apply_tangents(x, directions);
+    for (std::size_t i = 0; i < a.value.size(); ++i) {
+      a.value[i] /= b.value;
+      Number* derivatives = a.derivatives.component(i);
+      for (std::size_t p = 0; p < a.derivatives.count; ++p) {
+        derivatives[p] = (derivatives[p] - a.value[i] * b.derivatives[p]) / b.value;
+      }
+    }
+    return a;
   }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
-  std::unique_ptr<IScalarFunction> m_b;
+  VectorFunctionPtr m_a;
+  ScalarFunctionPtr m_b;
 
  public:
   static Vector impl(Vector a, const Number b) {
-    for (double& i : a) {
-      i /= b;
-    }
+    kernels::scale_divide(a.data(), a.data(), b, a.size());
     return a;
   }
 };
 
 class ScalarScalarDivide : public IScalarFunction {
  public:
-  explicit ScalarScalarDivide(std::unique_ptr<IScalarFunction>&& a, std::unique_ptr<IScalarFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit ScalarScalarDivide(ScalarOperand a, ScalarOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "/" + strHelper(*m_b); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarScalarDivide>(m_a->clone(), m_b->clone());
+    return std::make_unique<ScalarScalarDivide>(m_a, m_b);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return m_a->apply(x) / m_b->apply(x); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    return m_a->apply(x, workspace) / m_b->apply(x, workspace);
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_a->apply_batch(x);
+    kernels::divide(a.data(), a.data(), m_b->apply_batch(x).data(), a.size());
+    return a;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Quotient; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
     return std::make_unique<ScalarScalarDivide>(
-        std::make_unique<ScalarSub>(std::make_unique<ScalarScalarProduct>(m_b->clone(), m_a->diff(I)),
-                                    std::make_unique<ScalarScalarProduct>(m_b->diff(I), m_a->clone())),
-        std::make_unique<ScalarScalarProduct>(m_b->clone(), m_b->clone()));
+        std::make_unique<ScalarSub>(std::make_unique<ScalarScalarProduct>(m_b, m_a->diff(I)),
+                                    std::make_unique<ScalarScalarProduct>(m_b->diff(I), m_a)),
+        std::make_unique<ScalarScalarProduct>(m_b, m_b));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Div, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    const Tangent b = m_b->apply_tangent(x, v);
+    const Number value = a.value / b.value;
+    return {value, (a.derivative - value * b.derivative) / b.value};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_a->apply_tangents(x, directions);
+    const Tangents b = m_b->apply_tangents(x, directions);
+    a.value /= b.value;
+    for (std::size_t p = 0; p < a.derivatives.size(); ++p) {
+      a.derivatives[p] = (a.derivatives[p] - a.value * b.derivatives[p]) / b.value;
+    }
+    return a;
   }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
-  std::unique_ptr<IScalarFunction> m_b;
+  ScalarFunctionPtr m_a;
+  ScalarFunctionPtr m_b;
 };
 
 class DotProduct : public IScalarFunction {
  public:
-  explicit DotProduct(std::unique_ptr<IVectorFunction>&& a, std::unique_ptr<IVectorFunction>&& b)
-      : m_a(std::move(a)), m_b(std::move(b)) {}
+  explicit DotProduct(VectorOperand a, VectorOperand b)
+      : m_a(std::move(a)), m_b(std::move(b)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return "dot(" + m_a->string() + "," + m_b->string() + ")"; }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<DotProduct>(m_a->clone(), m_b->clone());
+    return std::make_unique<DotProduct>(m_a, m_b);
+  }
+  [[nodiscard]] Number apply(const Vector& x) const override { return VectorValue::dot(m_a->apply(x), m_b->apply(x)); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    const Workspace::Buffer a(workspace, x.size()), b(workspace, x.size());
+    m_a->apply_into(x, a.span(), workspace);
+    m_b->apply_into(x, b.span(), workspace);
+    return kernels::dot(a.data(), b.data(), x.size());
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    return impl_batch(m_a->apply_batch(x), m_b->apply_batch(x));
   }
-  [[nodiscard]] Number apply(const Vector& x) const override { return impl(m_a->apply(x), m_b->apply(x)); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarAdd>(std::make_unique<DotProduct>(m_a->diff(I), m_b->clone()),
-                                       std::make_unique<DotProduct>(m_a->clone(), m_b->diff(I)));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get(), m_b.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    return std::make_unique<ScalarAdd>(std::make_unique<DotProduct>(m_a->diff(I), m_b),
+                                       std::make_unique<DotProduct>(m_a, m_b->diff(I)));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Dot, m_a->compile(builder), m_b->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const VectorTangent a = m_a->apply_tangent(x, v);
+    const VectorTangent b = m_b->apply_tangent(x, v);
+    return {impl(a.value, b.value), impl(a.derivative, b.value) + impl(a.value, b.derivative)};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    const VectorTangents a = m_a->apply_tangents(x, directions);
+    const VectorTangents b = m_b->apply_tangents(x, directions);
+    return {impl(a.value, b.value), impl_tangents(a, b)};
   }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
-  std::unique_ptr<IVectorFunction> m_b;
+  VectorFunctionPtr m_a;
+  VectorFunctionPtr m_b;
 
  public:
   static Number impl(const Vector& a, const Vector& b) {
     assert(a.size() == b.size());
-    Number result = 0;
-    for (std::size_t i = 0; i < a.size(); ++i) {
-      result += a[i] * b[i];
+    return kernels::dot(a.data(), b.data(), a.size());
+  }
+  static Vector impl_batch(const VectorBlock& a, const VectorBlock& b) {
+    assert(a.dimension == b.dimension && a.count == b.count);
+    Vector result(a.count, Number{0});
+    for (std::size_t i = 0; i < a.dimension; ++i) {
+      kernels::multiply_add(result.data(), a.component(i), b.component(i), a.count);
+    }
+    return result;
+  }
+  //! derivatives of dot(a, b) along each direction: dot(da, b) + dot(a, db)
+  static Vector impl_tangents(const VectorTangents& a, const VectorTangents& b) {
+    assert(a.value.size() == b.value.size() && a.derivatives.count == b.derivatives.count);
+    Vector result(a.derivatives.count, Number{0});
+    for (std::size_t i = 0; i < a.value.size(); ++i) {
+      const Number* da = a.derivatives.component(i);
+      const Number* db = b.derivatives.component(i);
+      for (std::size_t p = 0; p < result.size(); ++p) {
+        result[p] += da[p] * b.value[i] + a.value[i] * db[p];
+      }
     }
     return result;
   }
@@ -398,86 +940,218 @@ class DotProduct : public IScalarFunction {
 
 class ExpFunction : public IScalarFunction {
  public:
-  explicit ExpFunction(std::unique_ptr<IScalarFunction>&& a) : m_a(std::move(a)) {}
+  explicit ExpFunction(ScalarOperand a) : m_a(std::move(a)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return "exp(" + m_a->string() + ")"; }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ExpFunction>(m_a->clone());
+    return std::make_unique<ExpFunction>(m_a);
   }
   [[nodiscard]] Number apply(const Vector& x) const override { return exp(m_a->apply(x)); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    return exp(m_a->apply(x, workspace));
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_a->apply_batch(x);
+    for (double& ap : a) {
+      ap = exp(ap);
+    }
+    return a;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
-    return std::make_unique<ScalarScalarProduct>(std::make_unique<ExpFunction>(m_a->clone()), m_a->diff(I));
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    return std::make_unique<ScalarScalarProduct>(std::make_unique<ExpFunction>(m_a), m_a->diff(I));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Exp, m_a->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_a->apply_tangent(x, v);
+    const Number value = exp(a.value);
+    return {value, value * a.derivative};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_a->apply_tangents(x, directions);
+    a.value = exp(a.value);
+    kernels::scale(a.derivatives.data(), a.derivatives.data(), a.value, a.derivatives.size());
+    return a;
   }
 
  private:
-  std::unique_ptr<IScalarFunction> m_a;
+  ScalarFunctionPtr m_a;
 };
 
 class ScalarNorm : public IScalarFunction {
  public:
-  explicit ScalarNorm(std::unique_ptr<IVectorFunction>&& a) : m_a(std::move(a)) {}
+  explicit ScalarNorm(VectorOperand a) : m_a(std::move(a)) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return "norm2(" + m_a->string() + ")"; }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<ScalarNorm>(m_a->clone());
+    return std::make_unique<ScalarNorm>(m_a);
+  }
+  [[nodiscard]] Number apply(const Vector& x) const override {
+    const VectorValue a = m_a->apply(x);
+    return VectorValue::dot(a, a);
+  }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    const Workspace::Buffer a(workspace, x.size());
+    m_a->apply_into(x, a.span(), workspace);
+    return kernels::dot(a.data(), a.data(), x.size());
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    const VectorBlock a = m_a->apply_batch(x);
+    return DotProduct::impl_batch(a, a);
   }
-  [[nodiscard]] Number apply(const Vector& x) const override { return DotProduct::impl(x, x); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, 0, {m_a.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
     return std::make_unique<ScalarScalarProduct>(std::make_unique<ScalarNumber>("2"),
-                                                 std::make_unique<DotProduct>(m_a->diff(I), m_a->clone()));
+                                                 std::make_unique<DotProduct>(m_a->diff(I), m_a));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Norm, m_a->compile(builder));
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const VectorTangent a = m_a->apply_tangent(x, v);
+    return {DotProduct::impl(a.value, a.value), 2 * DotProduct::impl(a.value, a.derivative)};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    const VectorTangents a = m_a->apply_tangents(x, directions);
+    return {DotProduct::impl(a.value, a.value), DotProduct::impl_tangents(a, a)};
   }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
+  VectorFunctionPtr m_a;
 };
 
 class VectorIdentity : public IVectorFunction {
  public:
-  explicit VectorIdentity(std::string s) : m_s(std::move(s)) {
-    if (m_s != "x")
+  //! x, or y: the second point of a function of two points (a covariance kernel), constant for diff
+  explicit VectorIdentity(std::string_view s) : m_s(s, ExpressionArena::current_resource()) {
+    if (m_s != "x" && m_s != "y")
       throw NotImplementedException(__PRETTY_FUNCTION__);
+    init_dependencies();
   }
-  [[nodiscard]] std::string string() const override { return m_s; }
+  //! "x" or "y"
+  [[nodiscard]] std::string_view name() const { return m_s; }
+
+  [[nodiscard]] std::string string() const override { return std::string{m_s}; }
   [[nodiscard]] std::unique_ptr<IVectorFunction> clone() const override {
     return std::make_unique<VectorIdentity>(m_s);
   }
-  [[nodiscard]] Vector apply(const Vector& x) const override { return x; }
+  [[nodiscard]] VectorValue apply(const Vector& x) const override {
+    check_x();
+    return VectorValue::view(x.data(), x.size());
+  }
+  void apply_into(const Vector& x, Span out, Workspace& workspace) const override {
+    check_x();
+    assert(out.size == x.size());
+    std::copy(x.begin(), x.end(), out.data);
+  }
+  [[nodiscard]] VectorBlock apply_batch(const VectorBlock& x) const override {
+    check_x();
+    return x;
+  }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IVectorFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this) + heap_size(m_s); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), m_s}; }
+  [[nodiscard]] VectorOperand diff_impl(Index I) const override {
     return std::make_unique<VectorPartialOne>(I);
   }
+  [[nodiscard]] std::unique_ptr<IVectorFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IVectorFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return (m_s == "x") ? builder.input() : builder.second_input();
+  }
+  [[nodiscard]] VectorTangent apply_tangent(const Vector& x, const Vector& v) const override {
+    check_x();
+    assert(x.size() == v.size());
+    return {x, v};
+  }
+  [[nodiscard]] VectorTangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    check_x();
+    assert(x.size() == directions.dimension);
+    return {x, directions};
+  }
+
+ private:
+  //! trees are evaluated at a single point: functions of y are evaluated by their Tape (see IScalarFunction::apply)
+  void check_x() const {
+    if (m_s != "x")
+      throw NotImplementedException(__PRETTY_FUNCTION__, " for y out of a Tape");
+  }
 
  private:
-  std::string m_s;
+  std::pmr::string m_s;
 };
 
 class IndexedVectorIdentity : public IScalarFunction {
  public:
-  explicit IndexedVectorIdentity(std::unique_ptr<IVectorFunction>&& a,
+  explicit IndexedVectorIdentity(VectorOperand a,
                                  const std::string& index)  // TODO could get direct VectorVariable
-      : m_a(std::move(a)), m_index(std::stoul(index)) {}
-  explicit IndexedVectorIdentity(std::unique_ptr<IVectorFunction>&& a,
+      : m_a(std::move(a)), m_index(std::stoul(index)) {
+    init_dependencies();
+  }
+  explicit IndexedVectorIdentity(VectorOperand a,
                                  const Index index)  // TODO could get direct VectorVariable
-      : m_a(std::move(a)), m_index(index) {}
+      : m_a(std::move(a)), m_index(index) {
+    init_dependencies();
+  }
 
   [[nodiscard]] std::string string() const override { return strHelper(*m_a) + "_" + std::to_string(m_index); }
   [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
-    return std::make_unique<IndexedVectorIdentity>(m_a->clone(), m_index);
+    return std::make_unique<IndexedVectorIdentity>(m_a, m_index);
+  }
+  [[nodiscard]] Number apply(const Vector& x) const override { return m_a->apply(x)[m_index]; }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override {
+    const Workspace::Buffer a(workspace, x.size());
+    m_a->apply_into(x, a.span(), workspace);
+    assert(m_index < x.size());
+    return a.data()[m_index];
+  }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    const VectorBlock a = m_a->apply_batch(x);
+    assert(m_index < a.dimension);
+    return Vector(a.component(m_index), a.component(m_index) + a.count);
   }
-  [[nodiscard]] Number apply(const Vector& x) const override { return impl(m_a->apply(x), m_index); }
   [[nodiscard]] PriorityLevel level() const override { return PriorityLevel::Value; }
-  [[nodiscard]] std::unique_ptr<IScalarFunction> diff(Index I) const override {
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), {}, m_index, {m_a.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
     if (m_index == I) {
       return std::make_unique<ScalarNumber>("1");
     } else {
-      return std::make_unique<ScalarNumber>("0");
+      return zero_function();
     }
   }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override;
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override;
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    return builder.scalar(OpCode::Component, m_a->compile(builder), m_index);
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const VectorTangent a = m_a->apply_tangent(x, v);
+    return {impl(a.value, m_index), impl(a.derivative, m_index)};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    const VectorTangents a = m_a->apply_tangents(x, directions);
+    assert(m_index < a.derivatives.dimension);
+    const Number* derivatives = a.derivatives.component(m_index);
+    return {impl(a.value, m_index), Vector(derivatives, derivatives + a.derivatives.count)};
+  }
 
  private:
-  std::unique_ptr<IVectorFunction> m_a;
+  VectorFunctionPtr m_a;
   Index m_index;
 
  public:
@@ -487,89 +1161,865 @@ class IndexedVectorIdentity : public IScalarFunction {
   }
 };
 
+// Simplification rules: children are simplified first, then the node is rewritten from its simplified operands.
+
 namespace {
-ASTNode::Kind mark_data_kind(ASTNode& node) {
-  if (node.is_root()) {
-    return node.updateKind(mark_data_kind(*node.children.front()));
-  } else if (node.is<language::scalar_variable>() || node.is<language::scalar_constant>()
-             || node.is<language::number>()) {
-    return node.updateKind(ASTNode::Kind::Scalar);
-  } else if (node.is<language::vector_variable>()) {
-    return node.updateKind(ASTNode::Kind::Vectorial);
-  } else if (node.is<language::indexed_vector_variable>()) {
-    mark_data_kind(*node.children[0]);
-    return node.updateKind(ASTNode::Kind::Scalar);
-  } else if (node.is<language::prefix_minus>() || node.is<language::prefix_plus>()) {
-    return node.updateKind(mark_data_kind(*node.children[0]));
-  } else if (node.is<language::unary_s2s_function_name>() || node.is<language::unary_v2s_function_name>()
-             || node.is<language::binary_v2s_function_name>()) {
-    for (auto&& c : node.children) {
-      mark_data_kind(*c);
-    }
-    return node.updateKind(ASTNode::Kind::Scalar);
-  } else if (node.is<language::unary_v2v_function_name>()) {
-    for (auto&& c : node.children) {
-      mark_data_kind(*c);
-    }
-    return node.updateKind(ASTNode::Kind::Vectorial);
-  } else if (node.is<language::plus>() || node.is<language::minus>() || node.is<language::multiply>()
-             || node.is<language::divide>()) {
-    for (auto&& c : node.children) {
-      node.updateKind(mark_data_kind(*c));
-    }
-    return node.kind();
-  } else {
-    return ASTNode::Kind::Unknown;
-  }
+//! value of f if it is a number (possibly negated)
+std::optional<Number> number_value(const IScalarFunction& f) {
+  if (const auto* number = dynamic_cast<const ScalarNumber*>(&f))
+    return number->value();
+  if (const auto* minus = dynamic_cast<const ScalarPrefixMinus*>(&f))
+    if (const auto* number = dynamic_cast<const ScalarNumber*>(minus->operand().get()))
+      return -number->value();
+  return std::nullopt;
 }
 
-std::unique_ptr<IScalarFunction> make_scalar_function(const ASTNode& node);
-std::unique_ptr<IVectorFunction> make_vector_function(const ASTNode& node);
+std::unique_ptr<IScalarFunction> number(const Number value) {
+  if (value < 0)
+    return std::make_unique<ScalarPrefixMinus>(std::make_unique<ScalarNumber>(-value));
+  return std::make_unique<ScalarNumber>((value == 0) ? Number{0} : value);  // no -0
+}
 
-auto make_named_unary_s2s_function(const std::string& name, std::unique_ptr<IScalarFunction>&& a) {
-  if (name == "exp") {
-    return std::make_unique<ExpFunction>(std::move(a));
-  } else {
-    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
-  }
+bool is_zero(const IVectorFunction& f) {
+  return dynamic_cast<const VectorZero*>(&f) != nullptr;
 }
 
-auto make_named_unary_v2v_function(const std::string& name, std::unique_ptr<IVectorFunction>&& a)
-    -> std::unique_ptr<IVectorFunction> { // type cannot yet inferred (needs at least one return)
-  throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
+const VectorPartialOne* as_partial_one(const IVectorFunction& f) {
+  return dynamic_cast<const VectorPartialOne*>(&f);
 }
 
-auto make_named_unary_v2s_function(const std::string& name, std::unique_ptr<IVectorFunction>&& a) {
-  if (name == "norm2") {
-    return std::make_unique<ScalarNorm>(std::move(a));
-  } else {
-    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
-  }
+//! operand of -a, or nullptr
+const ScalarFunctionPtr* negated(const IScalarFunction& f) {
+  const auto* minus = dynamic_cast<const ScalarPrefixMinus*>(&f);
+  return (minus && !number_value(f)) ? &minus->operand() : nullptr;
 }
 
-auto make_named_binary_v2s_function(const std::string& name,
-                                    std::unique_ptr<IVectorFunction>&& a,
-                                    std::unique_ptr<IVectorFunction>&& b) {
-  if (name == "dot") {
-    return std::make_unique<DotProduct>(std::move(a), std::move(b));
-  } else {
-    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
-  }
+const VectorFunctionPtr* negated(const IVectorFunction& f) {
+  const auto* minus = dynamic_cast<const VectorPrefixMinus*>(&f);
+  return (minus) ? &minus->operand() : nullptr;
 }
 
-std::unique_ptr<IScalarFunction> make_scalar_function(const ASTNode& node) {
-  if (node.is_root())
-    return make_scalar_function(*node.children.front());
+//! -f, folding double negations
+std::unique_ptr<IScalarFunction> negate(ScalarOperand operand) {
+  const ScalarFunctionPtr f = std::move(operand);
+  if (const std::optional<Number> v = number_value(*f))
+    return number(-*v);
+  if (const ScalarFunctionPtr* a = negated(*f))
+    return (*a)->clone();
+  return std::make_unique<ScalarPrefixMinus>(f);
+}
 
-  if (node.is<language::unary_s2s_function_name>()) {
-    const ASTNode& a = *node.children[0];
-    return make_named_unary_s2s_function(node.string(), make_scalar_function(a));
-  } else if (node.is<language::unary_v2s_function_name>()) {
-    const ASTNode& a = *node.children[0];
-    assert(a.kind() == ASTNode::Kind::Vectorial);
-    return make_named_unary_v2s_function(node.string(), make_vector_function(a));
-  } else if (node.is<language::binary_v2s_function_name>()) {
-    const ASTNode& a = *node.children[0];
+std::unique_ptr<IVectorFunction> negate(VectorOperand operand) {
+  const VectorFunctionPtr f = std::move(operand);
+  if (is_zero(*f))
+    return std::make_unique<VectorZero>();
+  if (const VectorFunctionPtr* a = negated(*f))
+    return (*a)->clone();
+  return std::make_unique<VectorPrefixMinus>(f);
+}
+}  // namespace
+
+std::unique_ptr<IScalarFunction> ScalarNumber::simplify() const {
+  return clone();
+}
+
+std::unique_ptr<IScalarFunction> ScalarValue::simplify() const {
+  return clone();
+}
+
+std::unique_ptr<IVectorFunction> VectorZero::simplify() const {
+  return clone();
+}
+
+std::unique_ptr<IVectorFunction> VectorPartialOne::simplify() const {
+  return clone();
+}
+
+std::unique_ptr<IVectorFunction> VectorIdentity::simplify() const {
+  return clone();
+}
+
+std::unique_ptr<IScalarFunction> ScalarAdd::simplify() const {
+  const ScalarFunctionPtr a = intern(m_a->simplify());
+  const ScalarFunctionPtr b = intern(m_b->simplify());
+  const std::optional<Number> va = number_value(*a);
+  const std::optional<Number> vb = number_value(*b);
+  if (va && vb)
+    return number(*va + *vb);
+  if (va == 0)
+    return b->clone();
+  if (vb == 0)
+    return a->clone();
+  if (const ScalarFunctionPtr* nb = negated(*b))
+    return ScalarSub(a, *nb).simplify();
+  if (const ScalarFunctionPtr* na = negated(*a))
+    return ScalarSub(b, *na).simplify();
+  return std::make_unique<ScalarAdd>(a, b);
+}
+
+std::unique_ptr<IScalarFunction> ScalarSub::simplify() const {
+  const ScalarFunctionPtr a = intern(m_a->simplify());
+  const ScalarFunctionPtr b = intern(m_b->simplify());
+  const std::optional<Number> va = number_value(*a);
+  const std::optional<Number> vb = number_value(*b);
+  if (va && vb)
+    return number(*va - *vb);
+  if (vb == 0)
+    return a->clone();
+  if (va == 0)
+    return negate(b);
+  if (a == b)
+    return number(0);
+  if (const ScalarFunctionPtr* nb = negated(*b))
+    return ScalarAdd(a, *nb).simplify();
+  return std::make_unique<ScalarSub>(a, b);
+}
+
+std::unique_ptr<IScalarFunction> ScalarPrefixPlus::simplify() const {
+  return m_a->simplify();
+}
+
+std::unique_ptr<IScalarFunction> ScalarPrefixMinus::simplify() const {
+  return negate(intern(m_a->simplify()));
+}
+
+std::unique_ptr<IScalarFunction> ScalarScalarProduct::simplify() const {
+  ScalarFunctionPtr a = intern(m_a->simplify());
+  ScalarFunctionPtr b = intern(m_b->simplify());
+  const std::optional<Number> va = number_value(*a);
+  const std::optional<Number> vb = number_value(*b);
+  if (va && vb)
+    return number(*va * *vb);
+  if (va == 0 || vb == 0)
+    return number(0);
+  if (va == 1)
+    return b->clone();
+  if (vb == 1)
+    return a->clone();
+  if (va == -1)
+    return negate(b);
+  if (vb == -1)
+    return negate(a);
+  // pull negations out of the product
+  bool negative = false;
+  if (const ScalarFunctionPtr* na = negated(*a)) {
+    a = *na;
+    negative = !negative;
+  }
+  if (const ScalarFunctionPtr* nb = negated(*b)) {
+    b = *nb;
+    negative = !negative;
+  }
+  auto product = std::make_unique<ScalarScalarProduct>(a, b);
+  return (negative) ? negate(std::move(product)) : std::move(product);
+}
+
+std::unique_ptr<IScalarFunction> ScalarScalarDivide::simplify() const {
+  ScalarFunctionPtr a = intern(m_a->simplify());
+  ScalarFunctionPtr b = intern(m_b->simplify());
+  const std::optional<Number> va = number_value(*a);
+  const std::optional<Number> vb = number_value(*b);
+  if (va && vb)
+    return number(*va / *vb);
+  if (va == 0 && vb != 0)
+    return number(0);
+  if (vb == 1)
+    return a->clone();
+  if (vb == -1)
+    return negate(a);
+  bool negative = false;
+  if (const ScalarFunctionPtr* na = negated(*a)) {
+    a = *na;
+    negative = !negative;
+  }
+  if (const ScalarFunctionPtr* nb = negated(*b)) {
+    b = *nb;
+    negative = !negative;
+  }
+  auto quotient = std::make_unique<ScalarScalarDivide>(a, b);
+  return (negative) ? negate(std::move(quotient)) : std::move(quotient);
+}
+
+std::unique_ptr<IScalarFunction> DotProduct::simplify() const {
+  VectorFunctionPtr a = intern(m_a->simplify());
+  VectorFunctionPtr b = intern(m_b->simplify());
+  if (is_zero(*a) || is_zero(*b))
+    return number(0);
+  bool negative = false;
+  if (const VectorFunctionPtr* na = negated(*a)) {
+    a = *na;
+    negative = !negative;
+  }
+  if (const VectorFunctionPtr* nb = negated(*b)) {
+    b = *nb;
+    negative = !negative;
+  }
+  // dot(e_i, e_j) = delta_ij and dot(e_i, x) = x_i
+  std::unique_ptr<IScalarFunction> product;
+  const VectorPartialOne* ea = as_partial_one(*a);
+  const VectorPartialOne* eb = as_partial_one(*b);
+  if (ea && eb)
+    product = number((ea->index() == eb->index()) ? 1 : 0);
+  else if (ea && dynamic_cast<const VectorIdentity*>(b.get()))
+    product = std::make_unique<IndexedVectorIdentity>(b, ea->index());
+  else if (eb && dynamic_cast<const VectorIdentity*>(a.get()))
+    product = std::make_unique<IndexedVectorIdentity>(a, eb->index());
+  else
+    product = std::make_unique<DotProduct>(a, b);
+  if (negative)
+    return negate(std::move(product));
+  return product;
+}
+
+std::unique_ptr<IScalarFunction> ExpFunction::simplify() const {
+  const ScalarFunctionPtr a = intern(m_a->simplify());
+  if (const std::optional<Number> va = number_value(*a))
+    return number(exp(*va));
+  return std::make_unique<ExpFunction>(a);
+}
+
+std::unique_ptr<IScalarFunction> ScalarNorm::simplify() const {
+  VectorFunctionPtr a = intern(m_a->simplify());
+  if (is_zero(*a))
+    return number(0);
+  if (as_partial_one(*a))
+    return number(1);
+  if (const VectorFunctionPtr* na = negated(*a))
+    a = *na;
+  return std::make_unique<ScalarNorm>(a);
+}
+
+std::unique_ptr<IScalarFunction> IndexedVectorIdentity::simplify() const {
+  const VectorFunctionPtr a = intern(m_a->simplify());
+  if (is_zero(*a))
+    return number(0);
+  if (const VectorPartialOne* ea = as_partial_one(*a))
+    return number((ea->index() == m_index) ? 1 : 0);
+  return std::make_unique<IndexedVectorIdentity>(a, m_index);
+}
+
+std::unique_ptr<IVectorFunction> VectorAdd::simplify() const {
+  const VectorFunctionPtr a = intern(m_a->simplify());
+  const VectorFunctionPtr b = intern(m_b->simplify());
+  if (is_zero(*a))
+    return b->clone();
+  if (is_zero(*b))
+    return a->clone();
+  if (const VectorFunctionPtr* nb = negated(*b))
+    return VectorSub(a, *nb).simplify();
+  if (const VectorFunctionPtr* na = negated(*a))
+    return VectorSub(b, *na).simplify();
+  return std::make_unique<VectorAdd>(a, b);
+}
+
+std::unique_ptr<IVectorFunction> VectorSub::simplify() const {
+  const VectorFunctionPtr a = intern(m_a->simplify());
+  const VectorFunctionPtr b = intern(m_b->simplify());
+  if (is_zero(*b))
+    return a->clone();
+  if (is_zero(*a))
+    return negate(b);
+  if (a == b)
+    return std::make_unique<VectorZero>();
+  if (const VectorFunctionPtr* nb = negated(*b))
+    return VectorAdd(a, *nb).simplify();
+  return std::make_unique<VectorSub>(a, b);
+}
+
+std::unique_ptr<IVectorFunction> VectorPrefixPlus::simplify() const {
+  return m_a->simplify();
+}
+
+std::unique_ptr<IVectorFunction> VectorPrefixMinus::simplify() const {
+  return negate(intern(m_a->simplify()));
+}
+
+std::unique_ptr<IVectorFunction> ScalarVectorProduct::simplify() const {
+  ScalarFunctionPtr a = intern(m_a->simplify());
+  VectorFunctionPtr b = intern(m_b->simplify());
+  const std::optional<Number> va = number_value(*a);
+  if (va == 0 || is_zero(*b))
+    return std::make_unique<VectorZero>();
+  if (va == 1)
+    return b->clone();
+  if (va == -1)
+    return negate(b);
+  bool negative = false;
+  if (const ScalarFunctionPtr* na = negated(*a)) {
+    a = *na;
+    negative = !negative;
+  }
+  if (const VectorFunctionPtr* nb = negated(*b)) {
+    b = *nb;
+    negative = !negative;
+  }
+  auto product = std::make_unique<ScalarVectorProduct>(a, b);
+  return (negative) ? negate(std::move(product)) : std::move(product);
+}
+
+std::unique_ptr<IVectorFunction> VectorScalarDivide::simplify() const {
+  VectorFunctionPtr a = intern(m_a->simplify());
+  ScalarFunctionPtr b = intern(m_b->simplify());
+  const std::optional<Number> vb = number_value(*b);
+  if (is_zero(*a) && vb != 0)
+    return std::make_unique<VectorZero>();
+  if (vb == 1)
+    return a->clone();
+  if (vb == -1)
+    return negate(a);
+  bool negative = false;
+  if (const VectorFunctionPtr* na = negated(*a)) {
+    a = *na;
+    negative = !negative;
+  }
+  if (const ScalarFunctionPtr* nb = negated(*b)) {
+    b = *nb;
+    negative = !negative;
+  }
+  auto quotient = std::make_unique<VectorScalarDivide>(a, b);
+  return (negative) ? negate(std::move(quotient)) : std::move(quotient);
+}
+
+// Fused kernel nodes: the shapes of usual covariance kernels, recognized by fuse() on a built tree.
+
+namespace {
+//! value of a constant scalar: a number or a named constant (pi, e)
+std::optional<Number> constant_value(const IScalarFunction& f) {
+  if (const std::optional<Number> v = number_value(f))
+    return v;
+  if (const auto* value = dynamic_cast<const ScalarValue*>(&f)) {
+    const std::string name = value->string();
+    if (name == "pi" || name == "e")
+      return value->apply(Vector{});
+  }
+  return std::nullopt;
+}
+
+bool is_second_input(const IVectorFunction& f) {
+  return static_cast<const VectorIdentity&>(f).name() == "y";
+}
+}  // namespace
+
+//! scale * dot(u1 - u2, v1 - v2) where u1, v1 are x or y and u2, v2 are x, y or absent:
+//! dot(x, y), norm2(x - y) and their constant multiples (-0.5*dot(x-y,x-y), norm2(x/l), ...).
+//! Evaluated in a single loop over the coordinates: the differences are never stored.
+class QuadraticForm : public IScalarFunction {
+ public:
+  //! u1, u2, v1, v2: VectorIdentity nodes, u2 and v2 may be null
+  using Terms = std::array<VectorFunctionPtr, 4>;
+
+  QuadraticForm(const Number scale, Terms terms)
+      : m_s(ScalarNumber::format(scale), ExpressionArena::current_resource()),
+        m_scale(scale),
+        m_terms(std::move(terms)) {
+    for (std::size_t k = 0; k < m_terms.size(); ++k) {
+      if (!m_terms[k])
+        continue;
+      const bool second = is_second_input(*m_terms[k]);
+      (second ? m_y : m_x) = m_terms[k];
+      m_code |= Index{second ? 2u : 1u} << (2 * k);
+    }
+    init_dependencies();
+  }
+
+  [[nodiscard]] Number scale() const { return m_scale; }
+  [[nodiscard]] const Terms& terms() const { return m_terms; }
+
+  [[nodiscard]] std::string string() const override {
+    const std::string form
+        = "dot(" + difference(m_terms[0], m_terms[1]) + "," + difference(m_terms[2], m_terms[3]) + ")";
+    if (m_scale == 1)
+      return form;
+    if (m_scale == -1)
+      return "-" + form;
+    return std::string{m_s} + "*" + form;
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
+    return std::make_unique<QuadraticForm>(m_scale, m_terms);
+  }
+  [[nodiscard]] Number apply(const Vector& x) const override {
+    return m_scale * impl(data(m_terms[0], x), data(m_terms[1], x), data(m_terms[2], x), data(m_terms[3], x), x.size());
+  }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override { return apply(x); }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector result(x.count, Number{0});
+    for (Index i = 0; i < x.dimension; ++i) {
+      const Number* u1 = component(m_terms[0], x, i);
+      const Number* u2 = component(m_terms[1], x, i);
+      const Number* v1 = component(m_terms[2], x, i);
+      const Number* v2 = component(m_terms[3], x, i);
+      for (Index p = 0; p < x.count; ++p) {
+        result[p] += at(u1, u2, p) * at(v1, v2, p);
+      }
+    }
+    kernels::scale(result.data(), result.data(), m_scale, result.size());
+    return result;
+  }
+  [[nodiscard]] PriorityLevel level() const override {
+    if (m_scale == 1)
+      return PriorityLevel::Value;
+    return (m_scale < 0) ? PriorityLevel::Prefixed : PriorityLevel::Factor;
+  }
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this) + heap_size(m_s); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), m_s, m_code, {m_x.get(), m_y.get()}}; }
+  //! scale * (du * v_I + dv * u_I), du and dv being the derivatives of u_I and v_I along x_I (-1, 0 or 1)
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    const Number du = slope(m_terms[0], m_terms[1]);
+    const Number dv = slope(m_terms[2], m_terms[3]);
+    if (same_terms())
+      return scaled(2 * m_scale * du, coordinate(m_terms[0], m_terms[1], I));
+    std::unique_ptr<IScalarFunction> result;
+    if (du != 0)
+      result = scaled(m_scale * du, coordinate(m_terms[2], m_terms[3], I));
+    if (dv != 0) {
+      std::unique_ptr<IScalarFunction> term = scaled(m_scale * dv, coordinate(m_terms[0], m_terms[1], I));
+      result = (result) ? std::make_unique<ScalarAdd>(std::move(result), std::move(term)) : std::move(term);
+    }
+    return (result) ? std::move(result) : number(0);
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override { return clone(); }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override { return clone(); }
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    auto reg = [&builder](const VectorFunctionPtr& term) { return term->compile(builder); };
+    Index form;
+    if (same_terms() && m_terms[1]) {
+      form = builder.scalar(OpCode::SquaredDistance, reg(m_terms[0]), reg(m_terms[1]));
+    } else if (same_terms()) {
+      form = builder.scalar(OpCode::Norm, reg(m_terms[0]));
+    } else {
+      auto vector = [&](const VectorFunctionPtr& a, const VectorFunctionPtr& b) {
+        return (b) ? builder.vector(OpCode::VectorSub, reg(a), reg(b)) : reg(a);
+      };
+      const Index u = vector(m_terms[0], m_terms[1]);
+      form = builder.scalar(OpCode::Dot, u, vector(m_terms[2], m_terms[3]));
+    }
+    return (m_scale == 1) ? form : builder.scalar(OpCode::Mul, builder.constant(m_scale), form);
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Number* u1 = data(m_terms[0], x);
+    const Number* u2 = data(m_terms[1], x);
+    const Number* v1 = data(m_terms[2], x);
+    const Number* v2 = data(m_terms[3], x);
+    const Number du = slope(m_terms[0], m_terms[1]);
+    const Number dv = slope(m_terms[2], m_terms[3]);
+    Number derivative = 0;
+    for (Index i = 0; i < x.size(); ++i) {
+      derivative += (du * at(v1, v2, i) + dv * at(u1, u2, i)) * v[i];
+    }
+    return {m_scale * impl(u1, u2, v1, v2, x.size()), m_scale * derivative};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    const Number* u1 = data(m_terms[0], x);
+    const Number* u2 = data(m_terms[1], x);
+    const Number* v1 = data(m_terms[2], x);
+    const Number* v2 = data(m_terms[3], x);
+    const Number du = slope(m_terms[0], m_terms[1]);
+    const Number dv = slope(m_terms[2], m_terms[3]);
+    Vector derivatives(directions.count, Number{0});
+    for (Index i = 0; i < x.size(); ++i) {
+      const Number* d = directions.component(i);
+      const Number w = m_scale * (du * at(v1, v2, i) + dv * at(u1, u2, i));
+      for (Index p = 0; p < directions.count; ++p) {
+        derivatives[p] += w * d[p];
+      }
+    }
+    return {m_scale * impl(u1, u2, v1, v2, x.size()), std::move(derivatives)};
+  }
+
+ private:
+  [[nodiscard]] bool same_terms() const { return m_terms[0] == m_terms[2] && m_terms[1] == m_terms[3]; }
+
+  static std::string difference(const VectorFunctionPtr& a, const VectorFunctionPtr& b) {
+    return (b) ? a->string() + "-" + b->string() : a->string();
+  }
+  //! trees are evaluated at a single point: functions of y are evaluated by their Tape
+  static void check_x(const IVectorFunction& term) {
+    if (is_second_input(term))
+      throw NotImplementedException(__PRETTY_FUNCTION__, " for y out of a Tape");
+  }
+  //! entries of a term at x, or null for an absent term
+  static const Number* data(const VectorFunctionPtr& term, const Vector& x) {
+    if (!term)
+      return nullptr;
+    check_x(*term);
+    return x.data();
+  }
+  static const Number* component(const VectorFunctionPtr& term, const VectorBlock& x, const Index i) {
+    if (!term)
+      return nullptr;
+    check_x(*term);
+    return x.component(i);
+  }
+  static Number at(const Number* a, const Number* b, const Index i) { return (b) ? a[i] - b[i] : a[i]; }
+  //! derivative of a_I - b_I along x_I
+  static Number slope(const VectorFunctionPtr& a, const VectorFunctionPtr& b) {
+    Number slope = (is_second_input(*a)) ? 0 : 1;
+    if (b && !is_second_input(*b))
+      slope -= 1;
+    return slope;
+  }
+  static std::unique_ptr<IScalarFunction> coordinate(const VectorFunctionPtr& a, const VectorFunctionPtr& b, Index I) {
+    auto a_I = std::make_unique<IndexedVectorIdentity>(a, I);
+    if (!b)
+      return a_I;
+    return std::make_unique<ScalarSub>(std::move(a_I), std::make_unique<IndexedVectorIdentity>(b, I));
+  }
+  static std::unique_ptr<IScalarFunction> scaled(const Number c, std::unique_ptr<IScalarFunction> f) {
+    if (c == 1)
+      return f;
+    if (c == -1)
+      return std::make_unique<ScalarPrefixMinus>(std::move(f));
+    if (c < 0)
+      return std::make_unique<ScalarPrefixMinus>(std::make_unique<ScalarScalarProduct>(number(-c), std::move(f)));
+    return std::make_unique<ScalarScalarProduct>(number(c), std::move(f));
+  }
+
+ private:
+  std::pmr::string m_s;  // scale
+  Number m_scale;
+  Terms m_terms;
+  VectorFunctionPtr m_x;  // the x and y terms, children of the key
+  VectorFunctionPtr m_y;
+  Index m_code = 0;  // 2 bits per term: 0 absent, 1 x, 2 y
+
+ public:
+  //! dot(u1 - u2, v1 - v2), the absent terms being null
+  static Number impl(const Number* u1, const Number* u2, const Number* v1, const Number* v2, const Index n) {
+    if (u1 == v1 && u2 == v2)
+      return (u2) ? kernels::squared_distance(u1, u2, n) : kernels::dot(u1, u1, n);
+    if (!u2 && !v2)
+      return kernels::dot(u1, v1, n);
+    Number result = 0;
+    for (Index i = 0; i < n; ++i) {
+      result += at(u1, u2, i) * at(v1, v2, i);
+    }
+    return result;
+  }
+};
+
+//! amplitude * exp(q) of any QuadraticForm q, whatever the sign of its scale or its terms: squared exponential
+//! kernels exp(-dot(x-y,x-y)/(2*l^2)) with their variance are one case. Its derivative along x_I is itself times
+//! the derivative of q, so it keeps this node (shared) and costs O(1) nodes per coordinate.
+class ExponentialQuadratic : public IScalarFunction {
+ public:
+  ExponentialQuadratic(const Number amplitude, ScalarOperand form)
+      : m_s(ScalarNumber::format(amplitude), ExpressionArena::current_resource()),
+        m_amplitude(amplitude),
+        m_form(std::move(form)) {
+    assert(dynamic_cast<const QuadraticForm*>(m_form.get()));
+    init_dependencies();
+  }
+
+  [[nodiscard]] Number amplitude() const { return m_amplitude; }
+  [[nodiscard]] const ScalarFunctionPtr& form() const { return m_form; }
+
+  [[nodiscard]] std::string string() const override {
+    const std::string exponential = "exp(" + m_form->string() + ")";
+    if (m_amplitude == 1)
+      return exponential;
+    if (m_amplitude == -1)
+      return "-" + exponential;
+    return std::string{m_s} + "*" + exponential;
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> clone() const override {
+    return std::make_unique<ExponentialQuadratic>(m_amplitude, m_form);
+  }
+  [[nodiscard]] Number apply(const Vector& x) const override { return m_amplitude * exp(m_form->apply(x)); }
+  [[nodiscard]] Number apply(const Vector& x, Workspace& workspace) const override { return apply(x); }
+  [[nodiscard]] Vector apply_batch(const VectorBlock& x) const override {
+    Vector a = m_form->apply_batch(x);
+    for (double& ap : a) {
+      ap = m_amplitude * exp(ap);
+    }
+    return a;
+  }
+  [[nodiscard]] PriorityLevel level() const override {
+    if (m_amplitude == 1)
+      return PriorityLevel::Value;
+    return (m_amplitude < 0) ? PriorityLevel::Prefixed : PriorityLevel::Factor;
+  }
+  [[nodiscard]] std::size_t memory_size() const override { return sizeof(*this) + heap_size(m_s); }
+  [[nodiscard]] NodeKey key() const override { return {typeid(*this), m_s, 0, {m_form.get()}}; }
+  [[nodiscard]] ScalarOperand diff_impl(Index I) const override {
+    return std::make_unique<ScalarScalarProduct>(clone(), m_form->diff(I));
+  }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> simplify() const override { return clone(); }
+  [[nodiscard]] std::unique_ptr<IScalarFunction> fuse() const override { return clone(); }
+  [[nodiscard]] Index compile_impl(TapeBuilder& builder) const override {
+    const Index exponential = builder.scalar(OpCode::Exp, m_form->compile(builder));
+    return (m_amplitude == 1) ? exponential : builder.scalar(OpCode::Mul, builder.constant(m_amplitude), exponential);
+  }
+  [[nodiscard]] Tangent apply_tangent(const Vector& x, const Vector& v) const override {
+    const Tangent a = m_form->apply_tangent(x, v);
+    const Number value = m_amplitude * exp(a.value);
+    return {value, value * a.derivative};
+  }
+  [[nodiscard]] Tangents apply_tangents(const Vector& x, const VectorBlock& directions) const override {
+    Tangents a = m_form->apply_tangents(x, directions);
+    a.value = m_amplitude * exp(a.value);
+    kernels::scale(a.derivatives.data(), a.derivatives.data(), a.value, a.derivatives.size());
+    return a;
+  }
+
+ private:
+  std::pmr::string m_s;  // amplitude
+  Number m_amplitude;
+  ScalarFunctionPtr m_form;
+};
+
+// Fusion rules: children are fused first, then the node is rewritten from its fused operands.
+
+namespace {
+//! u = scale * (plus - minus), plus and minus being x or y (minus is null when absent)
+struct LinearForm {
+  Number scale = 1;
+  VectorFunctionPtr plus;
+  VectorFunctionPtr minus;
+};
+
+//! linear form of x, y, x - y and their products and quotients by constants
+std::optional<LinearForm> linear_form(const VectorFunctionPtr& f) {
+  if (dynamic_cast<const VectorIdentity*>(f.get()))
+    return LinearForm{1, f, nullptr};
+  if (const auto* plus = dynamic_cast<const VectorPrefixPlus*>(f.get()))
+    return linear_form(plus->operand());
+  if (const VectorFunctionPtr* a = negated(*f)) {
+    std::optional<LinearForm> form = linear_form(*a);
+    if (form)
+      form->scale = -form->scale;
+    return form;
+  }
+  if (const auto* product = dynamic_cast<const ScalarVectorProduct*>(f.get())) {
+    const std::optional<Number> c = constant_value(*product->lhs());
+    std::optional<LinearForm> form = (c) ? linear_form(product->rhs()) : std::nullopt;
+    if (form)
+      form->scale *= *c;
+    return form;
+  }
+  if (const auto* quotient = dynamic_cast<const VectorScalarDivide*>(f.get())) {
+    const std::optional<Number> c = constant_value(*quotient->rhs());
+    std::optional<LinearForm> form = (c) ? linear_form(quotient->lhs()) : std::nullopt;
+    if (form)
+      form->scale /= *c;
+    return form;
+  }
+  if (const auto* sub = dynamic_cast<const VectorSub*>(f.get())) {
+    const std::optional<LinearForm> a = linear_form(sub->lhs());
+    const std::optional<LinearForm> b = linear_form(sub->rhs());
+    if (a && b && !a->minus && !b->minus && a->scale == b->scale)
+      return LinearForm{a->scale, a->plus, b->plus};
+  }
+  return std::nullopt;
+}
+
+//! the fused node f with its scale (or amplitude) s replaced by rescale(s); nullptr if f is not fused
+template <typename Rescale>
+std::unique_ptr<IScalarFunction> rescaled(const IScalarFunction& f, Rescale rescale) {
+  if (const auto* form = dynamic_cast<const QuadraticForm*>(&f))
+    return std::make_unique<QuadraticForm>(rescale(form->scale()), form->terms());
+  if (const auto* exponential = dynamic_cast<const ExponentialQuadratic*>(&f))
+    return std::make_unique<ExponentialQuadratic>(rescale(exponential->amplitude()), exponential->form());
+  return nullptr;
+}
+}  // namespace
+
+std::unique_ptr<IScalarFunction> ScalarNumber::fuse() const {
+  return clone();
+}
+
+std::unique_ptr<IScalarFunction> ScalarValue::fuse() const {
+  return clone();
+}
+
+std::unique_ptr<IVectorFunction> VectorZero::fuse() const {
+  return clone();
+}
+
+std::unique_ptr<IVectorFunction> VectorPartialOne::fuse() const {
+  return clone();
+}
+
+std::unique_ptr<IVectorFunction> VectorIdentity::fuse() const {
+  return clone();
+}
+
+std::unique_ptr<IScalarFunction> ScalarAdd::fuse() const {
+  return std::make_unique<ScalarAdd>(m_a->fuse(), m_b->fuse());
+}
+
+std::unique_ptr<IScalarFunction> ScalarSub::fuse() const {
+  return std::make_unique<ScalarSub>(m_a->fuse(), m_b->fuse());
+}
+
+std::unique_ptr<IScalarFunction> ScalarPrefixPlus::fuse() const {
+  return std::make_unique<ScalarPrefixPlus>(m_a->fuse());
+}
+
+std::unique_ptr<IScalarFunction> ScalarPrefixMinus::fuse() const {
+  const ScalarFunctionPtr a = intern(m_a->fuse());
+  if (auto fused = rescaled(*a, [](const Number s) { return -s; }))
+    return fused;
+  return std::make_unique<ScalarPrefixMinus>(a);
+}
+
+std::unique_ptr<IScalarFunction> ScalarScalarProduct::fuse() const {
+  const ScalarFunctionPtr a = intern(m_a->fuse());
+  const ScalarFunctionPtr b = intern(m_b->fuse());
+  if (const std::optional<Number> cb = constant_value(*b))
+    if (auto fused = rescaled(*a, [&](const Number s) { return s * *cb; }))
+      return fused;
+  if (const std::optional<Number> ca = constant_value(*a))
+    if (auto fused = rescaled(*b, [&](const Number s) { return *ca * s; }))
+      return fused;
+  return std::make_unique<ScalarScalarProduct>(a, b);
+}
+
+std::unique_ptr<IScalarFunction> ScalarScalarDivide::fuse() const {
+  const ScalarFunctionPtr a = intern(m_a->fuse());
+  const ScalarFunctionPtr b = intern(m_b->fuse());
+  if (const std::optional<Number> cb = constant_value(*b))
+    if (auto fused = rescaled(*a, [&](const Number s) { return s / *cb; }))
+      return fused;
+  return std::make_unique<ScalarScalarDivide>(a, b);
+}
+
+std::unique_ptr<IScalarFunction> DotProduct::fuse() const {
+  const VectorFunctionPtr a = intern(m_a->fuse());
+  const VectorFunctionPtr b = intern(m_b->fuse());
+  const std::optional<LinearForm> u = linear_form(a);
+  const std::optional<LinearForm> v = linear_form(b);
+  if (u && v)
+    return std::make_unique<QuadraticForm>(u->scale * v->scale,
+                                           QuadraticForm::Terms{u->plus, u->minus, v->plus, v->minus});
+  return std::make_unique<DotProduct>(a, b);
+}
+
+std::unique_ptr<IScalarFunction> ExpFunction::fuse() const {
+  const ScalarFunctionPtr a = intern(m_a->fuse());
+  if (dynamic_cast<const QuadraticForm*>(a.get()))
+    return std::make_unique<ExponentialQuadratic>(1, a);
+  return std::make_unique<ExpFunction>(a);
+}
+
+std::unique_ptr<IScalarFunction> ScalarNorm::fuse() const {
+  const VectorFunctionPtr a = intern(m_a->fuse());
+  if (const std::optional<LinearForm> u = linear_form(a))
+    return std::make_unique<QuadraticForm>(u->scale * u->scale,
+                                           QuadraticForm::Terms{u->plus, u->minus, u->plus, u->minus});
+  return std::make_unique<ScalarNorm>(a);
+}
+
+std::unique_ptr<IScalarFunction> IndexedVectorIdentity::fuse() const {
+  return std::make_unique<IndexedVectorIdentity>(m_a->fuse(), m_index);
+}
+
+std::unique_ptr<IVectorFunction> VectorAdd::fuse() const {
+  return std::make_unique<VectorAdd>(m_a->fuse(), m_b->fuse());
+}
+
+std::unique_ptr<IVectorFunction> VectorSub::fuse() const {
+  return std::make_unique<VectorSub>(m_a->fuse(), m_b->fuse());
+}
+
+std::unique_ptr<IVectorFunction> VectorPrefixPlus::fuse() const {
+  return std::make_unique<VectorPrefixPlus>(m_a->fuse());
+}
+
+std::unique_ptr<IVectorFunction> VectorPrefixMinus::fuse() const {
+  return std::make_unique<VectorPrefixMinus>(m_a->fuse());
+}
+
+std::unique_ptr<IVectorFunction> ScalarVectorProduct::fuse() const {
+  return std::make_unique<ScalarVectorProduct>(m_a->fuse(), m_b->fuse());
+}
+
+std::unique_ptr<IVectorFunction> VectorScalarDivide::fuse() const {
+  return std::make_unique<VectorScalarDivide>(m_a->fuse(), m_b->fuse());
+}
+
+namespace {
+ASTNode::Kind mark_data_kind(ASTNode& node) {
+  if (node.is_root()) {
+    return node.updateKind(mark_data_kind(*node.children.front()));
+  } else if (node.is<language::scalar_variable>() || node.is<language::scalar_constant>()
+             || node.is<language::number>()) {
+    return node.updateKind(ASTNode::Kind::Scalar);
+  } else if (node.is<language::vector_variable>()) {
+    return node.updateKind(ASTNode::Kind::Vectorial);
+  } else if (node.is<language::indexed_vector_variable>()) {
+    mark_data_kind(*node.children[0]);
+    return node.updateKind(ASTNode::Kind::Scalar);
+  } else if (node.is<language::prefix_minus>() || node.is<language::prefix_plus>()) {
+    return node.updateKind(mark_data_kind(*node.children[0]));
+  } else if (node.is<language::unary_s2s_function_name>() || node.is<language::unary_v2s_function_name>()
+             || node.is<language::binary_v2s_function_name>()) {
+    for (auto&& c : node.children) {
+      mark_data_kind(*c);
+    }
+    return node.updateKind(ASTNode::Kind::Scalar);
+  } else if (node.is<language::unary_v2v_function_name>()) {
+    for (auto&& c : node.children) {
+      mark_data_kind(*c);
+    }
+    return node.updateKind(ASTNode::Kind::Vectorial);
+  } else if (node.is<language::plus>() || node.is<language::minus>() || node.is<language::multiply>()
+             || node.is<language::divide>()) {
+    for (auto&& c : node.children) {
+      node.updateKind(mark_data_kind(*c));
+    }
+    return node.kind();
+  } else {
+    return ASTNode::Kind::Unknown;
+  }
+}
+
+std::unique_ptr<IScalarFunction> make_scalar_function(const ASTNode& node);
+std::unique_ptr<IVectorFunction> make_vector_function(const ASTNode& node);
+
+auto make_named_unary_s2s_function(const std::string& name, std::unique_ptr<IScalarFunction>&& a) {
+  if (name == "exp") {
+    return std::make_unique<ExpFunction>(std::move(a));
+  } else {
+    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
+  }
+}
+
+auto make_named_unary_v2v_function(const std::string& name, std::unique_ptr<IVectorFunction>&& a)
+    -> std::unique_ptr<IVectorFunction> { // type cannot yet inferred (needs at least one return)
+  throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
+}
+
+auto make_named_unary_v2s_function(const std::string& name, std::unique_ptr<IVectorFunction>&& a) {
+  if (name == "norm2") {
+    return std::make_unique<ScalarNorm>(std::move(a));
+  } else {
+    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
+  }
+}
+
+auto make_named_binary_v2s_function(const std::string& name,
+                                    std::unique_ptr<IVectorFunction>&& a,
+                                    std::unique_ptr<IVectorFunction>&& b) {
+  if (name == "dot") {
+    return std::make_unique<DotProduct>(std::move(a), std::move(b));
+  } else {
+    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
+  }
+}
+
+std::unique_ptr<IScalarFunction> make_scalar_function(const ASTNode& node) {
+  if (node.is_root())
+    return make_scalar_function(*node.children.front());
+
+  if (node.is<language::unary_s2s_function_name>()) {
+    const ASTNode& a = *node.children[0];
+    return make_named_unary_s2s_function(node.string(), make_scalar_function(a));
+  } else if (node.is<language::unary_v2s_function_name>()) {
+    const ASTNode& a = *node.children[0];
+    assert(a.kind() == ASTNode::Kind::Vectorial);
+    return make_named_unary_v2s_function(node.string(), make_vector_function(a));
+  } else if (node.is<language::binary_v2s_function_name>()) {
+    const ASTNode& a = *node.children[0];
     const ASTNode& b = *node.children[1];
     assert(a.kind() == b.kind() && b.kind() == ASTNode::Kind::Vectorial);
     assert(node.kind() == ASTNode::Kind::Scalar);
@@ -663,6 +2113,143 @@ std::unique_ptr<IScalarFunction> build_function(ASTNode& node) {
   return make_scalar_function(node);
 }
 
+void FunctionBuilder::scalar_value(std::string_view name) {
+  m_values.push_back({std::make_unique<ScalarValue>(name), {}});
+}
+
+void FunctionBuilder::number(std::string_view text) {
+  m_values.push_back({std::make_unique<ScalarNumber>(text), {}});
+}
+
+void FunctionBuilder::vector_value(std::string_view name) {
+  m_values.push_back({{}, std::make_unique<VectorIdentity>(name)});
+}
+
+void FunctionBuilder::index(std::string_view index) {
+  assert(!m_values.empty() && m_values.back().vector);
+  Value& value = m_values.back();
+  value.scalar = std::make_unique<IndexedVectorIdentity>(std::move(value.vector), std::string{index});
+}
+
+void FunctionBuilder::operation(const Operator op) {
+  m_operators.push_back(op);
+}
+
+void FunctionBuilder::open() {
+  m_frames.push_back({m_values.size(), m_operators.size(), {}});
+}
+
+void FunctionBuilder::drop() {
+  assert(!m_frames.empty());
+  m_values.resize(m_frames.back().values);
+  m_operators.resize(m_frames.back().operators);
+  m_frames.pop_back();
+}
+
+void FunctionBuilder::close() {
+  assert(!m_frames.empty());
+  m_frames.pop_back();
+}
+
+void FunctionBuilder::fold() {
+  assert(!m_frames.empty() && m_values.size() > m_frames.back().values);
+  const Frame& frame = m_frames.back();
+  auto op = m_operators.begin() + frame.operators;
+  auto value = m_values.begin() + frame.values;
+  Value result = std::move(*value++);
+  if (op != m_operators.end() && (*op == Operator::PrefixPlus || *op == Operator::PrefixMinus)) {
+    result = prefix(*op++, std::move(result));
+  }
+  // a term may end with an operator not followed by a factor: the enclosing rule fails
+  for (; value != m_values.end(); ++value, ++op) {
+    assert(op != m_operators.end());
+    result = combine(*op, std::move(result), std::move(*value));
+  }
+  reduce(std::move(result));
+}
+
+void FunctionBuilder::name(std::string_view name) {
+  assert(!m_frames.empty());
+  m_frames.back().name = name;
+}
+
+void FunctionBuilder::call() {
+  assert(!m_frames.empty());
+  const std::string name{m_frames.back().name};
+  Value* arguments = m_values.data() + m_frames.back().values;
+  const std::size_t count = m_values.size() - m_frames.back().values;
+  if (count == 1 && arguments[0].scalar) {
+    reduce({make_named_unary_s2s_function(name, std::move(arguments[0].scalar)), {}});
+  } else if (count == 1 && name == "abs") {  // abs is also a vector to vector function
+    reduce({{}, make_named_unary_v2v_function(name, std::move(arguments[0].vector))});
+  } else if (count == 1) {
+    reduce({make_named_unary_v2s_function(name, std::move(arguments[0].vector)), {}});
+  } else if (count == 2) {
+    reduce({make_named_binary_v2s_function(name, std::move(arguments[0].vector), std::move(arguments[1].vector)),
+            {}});
+  } else {
+    throw NotImplementedException(__PRETTY_FUNCTION__, "[name:" + name + "]");
+  }
+}
+
+std::unique_ptr<IScalarFunction> FunctionBuilder::result() {
+  assert(m_frames.empty() && m_values.size() == 1 && m_values.front().scalar);
+  return std::move(m_values.front().scalar);
+}
+
+auto FunctionBuilder::combine(const Operator op, Value&& lhs, Value&& rhs) -> Value {
+  if (lhs.scalar && rhs.scalar) {
+    switch (op) {
+      case Operator::Add:
+        return {std::make_unique<ScalarAdd>(std::move(lhs.scalar), std::move(rhs.scalar)), {}};
+      case Operator::Sub:
+        return {std::make_unique<ScalarSub>(std::move(lhs.scalar), std::move(rhs.scalar)), {}};
+      case Operator::Multiply:
+        return {std::make_unique<ScalarScalarProduct>(std::move(lhs.scalar), std::move(rhs.scalar)), {}};
+      case Operator::Divide:
+        return {std::make_unique<ScalarScalarDivide>(std::move(lhs.scalar), std::move(rhs.scalar)), {}};
+      default:
+        break;
+    }
+  } else if (lhs.vector && rhs.vector) {
+    switch (op) {
+      case Operator::Add:
+        return {{}, std::make_unique<VectorAdd>(std::move(lhs.vector), std::move(rhs.vector))};
+      case Operator::Sub:
+        return {{}, std::make_unique<VectorSub>(std::move(lhs.vector), std::move(rhs.vector))};
+      default:
+        break;
+    }
+  } else if (op == Operator::Multiply && lhs.scalar) {
+    return {{}, std::make_unique<ScalarVectorProduct>(std::move(lhs.scalar), std::move(rhs.vector))};
+  } else if (op == Operator::Multiply) {
+    return {{}, std::make_unique<ScalarVectorProduct>(std::move(rhs.scalar), std::move(lhs.vector))};
+  } else if (op == Operator::Divide && lhs.vector) {
+    return {{}, std::make_unique<VectorScalarDivide>(std::move(lhs.vector), std::move(rhs.scalar))};
+  }
+  throw NotImplementedException(__PRETTY_FUNCTION__, "[operator:" + std::to_string(static_cast<int>(op)) + "]");
+}
+
+auto FunctionBuilder::prefix(const Operator op, Value&& operand) -> Value {
+  assert(op == Operator::PrefixPlus || op == Operator::PrefixMinus);
+  if (operand.scalar && op == Operator::PrefixPlus) {
+    return {std::make_unique<ScalarPrefixPlus>(std::move(operand.scalar)), {}};
+  } else if (operand.scalar) {
+    return {std::make_unique<ScalarPrefixMinus>(std::move(operand.scalar)), {}};
+  } else if (op == Operator::PrefixPlus) {
+    return {{}, std::make_unique<VectorPrefixPlus>(std::move(operand.vector))};
+  } else {
+    return {{}, std::make_unique<VectorPrefixMinus>(std::move(operand.vector))};
+  }
+}
+
+void FunctionBuilder::reduce(Value&& value) {
+  m_values.resize(m_frames.back().values);
+  m_operators.resize(m_frames.back().operators);
+  m_frames.pop_back();
+  m_values.push_back(std::move(value));
+}
+
 ASTNode::Kind ASTNode::updateKind(ASTNode::Kind kind) {
   assert(kind != Kind::Unknown);
   if (m_kind == Kind::Unknown) {
@@ -675,6 +2262,642 @@ ASTNode::Kind ASTNode::updateKind(ASTNode::Kind kind) {
   return m_kind;
 }
 
+VectorBlock VectorBlock::from_points(const std::vector<Vector>& points) {
+  VectorBlock block((points.empty()) ? 0 : points.front().size(), points.size());
+  for (std::size_t p = 0; p < block.count; ++p) {
+    assert(points[p].size() == block.dimension);
+    for (std::size_t i = 0; i < block.dimension; ++i) {
+      block.component(i)[p] = points[p][i];
+    }
+  }
+  return block;
+}
+
+Vector VectorBlock::point(const Index p) const {
+  assert(p < count);
+  Vector result(dimension);
+  for (std::size_t i = 0; i < dimension; ++i) {
+    result[i] = component(i)[p];
+  }
+  return result;
+}
+
+VectorValue VectorValue::zero(const Index dimension) {
+  VectorValue result;
+  result.m_dimension = dimension;
+  return result;
+}
+
+VectorValue VectorValue::one_hot(const Index dimension, const Index index) {
+  return sparse(dimension, {index}, {1});
+}
+
+VectorValue VectorValue::sparse(const Index dimension, std::vector<Index> indices, Vector values) {
+  assert(indices.size() == values.size());
+  assert(std::is_sorted(indices.begin(), indices.end()) && (indices.empty() || indices.back() < dimension));
+  VectorValue result;
+  result.m_kind = Kind::Sparse;
+  result.m_dimension = dimension;
+  result.m_indices = std::move(indices);
+  result.m_values = std::move(values);
+  return result;
+}
+
+VectorValue VectorValue::view(const Number* data, const Index dimension) {
+  VectorValue result;
+  result.m_kind = Kind::Dense;
+  result.m_dimension = dimension;
+  result.m_view = data;
+  return result;
+}
+
+Index VectorValue::stored() const {
+  switch (m_kind) {
+    case Kind::Zero:
+      return 0;
+    case Kind::Sparse:
+      return m_indices.size();
+    case Kind::Dense:
+      return m_dimension;
+  }
+  return 0;
+}
+
+Number VectorValue::operator[](const Index i) const {
+  assert(i < m_dimension);
+  switch (m_kind) {
+    case Kind::Zero:
+      return 0;
+    case Kind::Sparse: {
+      auto found = std::lower_bound(m_indices.begin(), m_indices.end(), i);
+      return (found != m_indices.end() && *found == i) ? m_values[found - m_indices.begin()] : 0;
+    }
+    case Kind::Dense:
+      return data()[i];
+  }
+  return 0;
+}
+
+Vector VectorValue::dense() const& {
+  if (m_kind == Kind::Dense)
+    return Vector(data(), data() + m_dimension);
+  Vector result(m_dimension, Number{0});
+  for (std::size_t k = 0; k < m_indices.size(); ++k) {
+    result[m_indices[k]] = m_values[k];
+  }
+  return result;
+}
+
+Vector VectorValue::dense() && {
+  if (m_kind == Kind::Dense && !m_view)
+    return std::move(m_values);
+  return static_cast<const VectorValue&>(*this).dense();
+}
+
+namespace {
+bool all_finite(const VectorValue& v) {
+  const Number* values = (v.kind() == VectorValue::Kind::Dense) ? v.data() : v.values().data();
+  return std::all_of(values, values + v.stored(), [](const Number x) { return std::isfinite(x); });
+}
+
+// sparse a op b over the union of their indices (a missing entry is 0)
+template <typename Op>
+VectorValue merge(const VectorValue& a, const VectorValue& b, Op op) {
+  std::vector<Index> indices;
+  Vector values;
+  indices.reserve(a.stored() + b.stored());
+  values.reserve(a.stored() + b.stored());
+  std::size_t i = 0, j = 0;
+  const auto &ia = a.indices(), &ib = b.indices();
+  while (i < ia.size() || j < ib.size()) {
+    if (j == ib.size() || (i < ia.size() && ia[i] < ib[j])) {
+      indices.push_back(ia[i]);
+      values.push_back(op(a.values()[i++], Number{0}));
+    } else if (i == ia.size() || ib[j] < ia[i]) {
+      indices.push_back(ib[j]);
+      values.push_back(op(Number{0}, b.values()[j++]));
+    } else {
+      indices.push_back(ia[i]);
+      values.push_back(op(a.values()[i++], b.values()[j++]));
+    }
+  }
+  return VectorValue::sparse(a.dimension(), std::move(indices), std::move(values));
+}
+}  // namespace
+
+VectorValue VectorValue::add(VectorValue a, const VectorValue& b) {
+  assert(a.dimension() == b.dimension());
+  if (b.kind() == Kind::Zero)
+    return a;
+  if (a.kind() == Kind::Zero)
+    return b;
+  if (a.kind() == Kind::Sparse && b.kind() == Kind::Sparse)
+    return merge(a, b, std::plus<>{});
+  if (a.kind() == Kind::Sparse) {
+    Vector result = b.dense();
+    for (std::size_t k = 0; k < a.m_indices.size(); ++k) {
+      result[a.m_indices[k]] = a.m_values[k] + result[a.m_indices[k]];
+    }
+    return VectorValue(std::move(result));
+  }
+  const Index n = a.dimension();
+  Vector result = std::move(a).dense();
+  if (b.kind() == Kind::Dense) {
+    kernels::add(result.data(), result.data(), b.data(), n);
+  } else {
+    for (std::size_t k = 0; k < b.m_indices.size(); ++k) {
+      result[b.m_indices[k]] += b.m_values[k];
+    }
+  }
+  return VectorValue(std::move(result));
+}
+
+VectorValue VectorValue::sub(VectorValue a, const VectorValue& b) {
+  assert(a.dimension() == b.dimension());
+  if (b.kind() == Kind::Zero)
+    return a;
+  if (a.kind() == Kind::Zero)
+    return negate(b);
+  if (a.kind() == Kind::Sparse && b.kind() == Kind::Sparse)
+    return merge(a, b, std::minus<>{});
+  if (a.kind() == Kind::Sparse) {
+    Vector result = negate(b).dense();
+    for (std::size_t k = 0; k < a.m_indices.size(); ++k) {
+      result[a.m_indices[k]] = a.m_values[k] - b.data()[a.m_indices[k]];
+    }
+    return VectorValue(std::move(result));
+  }
+  const Index n = a.dimension();
+  Vector result = std::move(a).dense();
+  if (b.kind() == Kind::Dense) {
+    kernels::sub(result.data(), result.data(), b.data(), n);
+  } else {
+    for (std::size_t k = 0; k < b.m_indices.size(); ++k) {
+      result[b.m_indices[k]] -= b.m_values[k];
+    }
+  }
+  return VectorValue(std::move(result));
+}
+
+VectorValue VectorValue::negate(VectorValue a) {
+  if (a.kind() == Kind::Sparse) {
+    kernels::negate(a.m_values.data(), a.m_values.data(), a.m_values.size());
+  } else if (a.kind() == Kind::Dense) {
+    const Index n = a.dimension();
+    Vector result = std::move(a).dense();
+    kernels::negate(result.data(), result.data(), n);
+    return VectorValue(std::move(result));
+  }
+  return a;
+}
+
+VectorValue VectorValue::scale(const Number s, VectorValue a) {
+  if (a.kind() != Kind::Dense && !std::isfinite(s))
+    return scale(s, VectorValue(std::move(a).dense()));  // s * 0 is NaN
+  if (a.kind() == Kind::Sparse) {
+    kernels::scale(a.m_values.data(), a.m_values.data(), s, a.m_values.size());
+  } else if (a.kind() == Kind::Dense) {
+    const Index n = a.dimension();
+    Vector result = std::move(a).dense();
+    kernels::scale(result.data(), result.data(), s, n);
+    return VectorValue(std::move(result));
+  }
+  return a;
+}
+
+VectorValue VectorValue::scale_divide(VectorValue a, const Number s) {
+  if (a.kind() != Kind::Dense && (s == 0 || std::isnan(s)))
+    return scale_divide(VectorValue(std::move(a).dense()), s);  // 0 / s is NaN
+  if (a.kind() == Kind::Sparse) {
+    kernels::scale_divide(a.m_values.data(), a.m_values.data(), s, a.m_values.size());
+  } else if (a.kind() == Kind::Dense) {
+    const Index n = a.dimension();
+    Vector result = std::move(a).dense();
+    kernels::scale_divide(result.data(), result.data(), s, n);
+    return VectorValue(std::move(result));
+  }
+  return a;
+}
+
+Number VectorValue::dot(const VectorValue& a, const VectorValue& b) {
+  assert(a.dimension() == b.dimension());
+  if (a.kind() == Kind::Dense && b.kind() == Kind::Dense)
+    return kernels::dot(a.data(), b.data(), a.dimension());
+  // a structural zero times an infinite or NaN entry is NaN: then the product is the dense one
+  if ((a.kind() != Kind::Dense && !all_finite(b)) || (b.kind() != Kind::Dense && !all_finite(a)))
+    return kernels::dot(a.dense().data(), b.dense().data(), a.dimension());
+  if (a.kind() == Kind::Zero || b.kind() == Kind::Zero)
+    return 0;
+  Number result = 0;
+  if (a.kind() == Kind::Sparse && b.kind() == Kind::Sparse) {
+    std::size_t i = 0, j = 0;
+    while (i < a.m_indices.size() && j < b.m_indices.size()) {
+      if (a.m_indices[i] < b.m_indices[j]) {
+        ++i;
+      } else if (b.m_indices[j] < a.m_indices[i]) {
+        ++j;
+      } else {
+        result += a.m_values[i++] * b.m_values[j++];
+      }
+    }
+  } else if (a.kind() == Kind::Sparse) {
+    for (std::size_t k = 0; k < a.m_indices.size(); ++k) {
+      result += a.m_values[k] * b.data()[a.m_indices[k]];
+    }
+  } else {
+    for (std::size_t k = 0; k < b.m_indices.size(); ++k) {
+      result += a.data()[b.m_indices[k]] * b.m_values[k];
+    }
+  }
+  return result;
+}
+
+Workspace::Buffer::Buffer(Workspace& workspace, const Index n) : m_workspace(workspace) {
+  if (workspace.m_depth == workspace.m_buffers.size())
+    workspace.m_buffers.emplace_back();
+  Vector& buffer = workspace.m_buffers[workspace.m_depth++];
+  buffer.resize(std::max(buffer.size(), n));
+  m_span = Span(buffer.data(), n);
+}
+
+bool NodeKey::operator==(const NodeKey& other) const {
+  return type == other.type && index == other.index && children == other.children && data == other.data;
+}
+
+std::size_t NodeKey::hash() const {
+  std::size_t seed = type.hash_code();
+  auto combine = [&seed](const std::size_t h) { seed ^= h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2); };
+  combine(std::hash<std::string_view>{}(data));
+  combine(std::hash<Index>{}(index));
+  for (const IFunction* child : children) {
+    combine(std::hash<const IFunction*>{}(child));
+  }
+  return seed;
+}
+
+// Weak registry of interned nodes: a node lives as long as someone uses it.
+// Expired entries are dropped while probing a bucket and by a full sweep when the table doubles.
+struct InternTable {
+  std::mutex mutex;
+  std::unordered_multimap<std::size_t, std::weak_ptr<const IFunction>> nodes;
+  std::size_t sweep_threshold = 1024;
+
+  static InternTable& instance() {
+    static InternTable table;
+    return table;
+  }
+
+  template <typename T>
+  std::shared_ptr<const T> intern(std::shared_ptr<const T> f) {
+    if (!f)
+      return f;
+    if (!f->m_interned && ExpressionArena::owner(*f))
+      f = std::shared_ptr<const T>(f->clone());  // arena nodes cannot be owned by the heap table
+    std::lock_guard<std::mutex> lock(mutex);
+    if (f->m_interned)
+      return f;
+    const NodeKey key = f->key();
+    const std::size_t hash = key.hash();
+    auto [it, last] = nodes.equal_range(hash);
+    while (it != last) {
+      if (auto node = it->second.lock()) {
+        if (node->key() == key)
+          return std::static_pointer_cast<const T>(node);  // same key implies same dynamic type
+        ++it;
+      } else {
+        it = nodes.erase(it);
+      }
+    }
+    if (nodes.size() >= sweep_threshold) {
+      sweep();
+      sweep_threshold = std::max(sweep_threshold, 2 * nodes.size());
+    }
+    f->m_interned = true;
+    nodes.emplace(hash, f);
+    return f;
+  }
+
+  void sweep() {
+    for (auto it = nodes.begin(); it != nodes.end();) {
+      it = (it->second.expired()) ? nodes.erase(it) : std::next(it);
+    }
+  }
+};
+
+namespace {
+template <typename T>
+std::shared_ptr<const T> intern_node(std::shared_ptr<const T> f) {
+  if (ExpressionArena* arena = ExpressionArena::current())
+    return arena->intern(std::move(f));
+  return InternTable::instance().intern(std::move(f));
+}
+}  // namespace
+
+ScalarFunctionPtr intern(std::unique_ptr<IScalarFunction> f) {
+  if (ExpressionArena* arena = ExpressionArena::current())
+    return arena->intern(std::move(f));
+  return intern_node(ScalarFunctionPtr(std::move(f)));
+}
+
+ScalarFunctionPtr intern(ScalarFunctionPtr f) {
+  return intern_node(std::move(f));
+}
+
+VectorFunctionPtr intern(std::unique_ptr<IVectorFunction> f) {
+  if (ExpressionArena* arena = ExpressionArena::current())
+    return arena->intern(std::move(f));
+  return intern_node(VectorFunctionPtr(std::move(f)));
+}
+
+VectorFunctionPtr intern(VectorFunctionPtr f) {
+  return intern_node(std::move(f));
+}
+
+void* IFunction::operator new(const std::size_t size) {
+  return ExpressionArena::allocate_node(size);
+}
+
+void IFunction::operator delete(void* p) {
+  ExpressionArena::deallocate_node(p);
+}
+
+std::size_t interned_count() {
+  InternTable& table = InternTable::instance();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.sweep();
+  return table.nodes.size();
+}
+
+std::size_t dag_size(const IFunction& f) {
+  std::unordered_set<const IFunction*> visited;
+  std::vector<const IFunction*> stack{&f};
+  while (!stack.empty()) {
+    const IFunction* node = stack.back();
+    stack.pop_back();
+    if (!visited.insert(node).second)
+      continue;
+    for (const IFunction* child : node->key().children) {
+      if (child)
+        stack.push_back(child);
+    }
+  }
+  return visited.size();
+}
+
+std::size_t tree_size(const IFunction& f) {
+  std::unordered_map<const IFunction*, std::size_t> sizes;
+  std::function<std::size_t(const IFunction&)> size_of = [&](const IFunction& node) -> std::size_t {
+    if (auto found = sizes.find(&node); found != sizes.end())
+      return found->second;
+    std::size_t size = 1;
+    for (const IFunction* child : node.key().children) {
+      if (child)
+        size += size_of(*child);
+    }
+    return sizes[&node] = size;
+  };
+  return size_of(f);
+}
+
+MemoryFootprint memory_footprint(const IFunction& f) {
+  MemoryFootprint result;
+  std::unordered_map<const IFunction*, std::size_t> depths;
+  std::function<std::size_t(const IFunction&)> visit = [&](const IFunction& node) -> std::size_t {
+    if (auto found = depths.find(&node); found != depths.end())
+      return found->second;
+    const NodeKey key = node.key();
+    result.bytes += ExpressionArena::node_header_size + node.memory_size();
+    ++result.nodes;
+    ++result.nodes_by_class[demangle(key.type.name())];
+    if (!ExpressionArena::owner(node)) {
+      ++result.heap_allocations;
+      if (key.data.size() > std::pmr::string().capacity())  // strings are the only data held out of line
+        ++result.heap_allocations;
+    }
+    std::size_t depth = 0;
+    for (const IFunction* child : key.children) {
+      if (child)
+        depth = std::max(depth, visit(*child));
+    }
+    return depths[&node] = depth + 1;
+  };
+  result.depth = visit(f);
+  return result;
+}
+
+DependencyMask DependencyMask::all() {
+  DependencyMask mask;
+  mask.m_all = true;
+  return mask;
+}
+
+DependencyMask DependencyMask::index(const Index i) {
+  DependencyMask mask;
+  mask.m_min = mask.m_max = i;
+  mask.m_bits = std::uint64_t{1} << (i % 64);
+  return mask;
+}
+
+void DependencyMask::merge(const DependencyMask& other) {
+  m_all = m_all || other.m_all;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+  m_bits |= other.m_bits;
+}
+
+void IFunction::init_dependencies() {
+  const NodeKey key = this->key();
+  if (key.type == typeid(VectorIdentity)) {
+    if (key.data == "x")
+      m_dependencies = DependencyMask::all();  // y is constant
+  } else if (key.type == typeid(IndexedVectorIdentity)) {
+    if (!key.children[0]->m_dependencies.empty())
+      m_dependencies = DependencyMask::index(key.index);  // x_i (y_i is constant)
+  } else {
+    for (const IFunction* child : key.children) {
+      if (child)
+        m_dependencies.merge(child->m_dependencies);
+    }
+  }
+}
+
+bool Dependencies::contains(const Index i) const {
+  return all || std::binary_search(indices.begin(), indices.end(), i);
+}
+
+Dependencies dependencies(const IFunction& f) {
+  Dependencies result;
+  std::unordered_set<const IFunction*> visited;
+  std::vector<const IFunction*> stack{&f};
+  while (!stack.empty() && !result.all) {
+    const IFunction* node = stack.back();
+    stack.pop_back();
+    if (node->dependency_mask().empty() || !visited.insert(node).second)
+      continue;
+    const NodeKey key = node->key();
+    if (key.type == typeid(VectorIdentity)) {
+      result.all = true;
+    } else if (key.type == typeid(IndexedVectorIdentity)) {
+      result.indices.push_back(key.index);  // x_i (y and y_i have empty masks)
+    } else {
+      for (const IFunction* child : key.children) {
+        if (child)
+          stack.push_back(child);
+      }
+    }
+  }
+  if (result.all) {
+    result.indices.clear();
+  } else {
+    std::sort(result.indices.begin(), result.indices.end());
+    result.indices.erase(std::unique(result.indices.begin(), result.indices.end()), result.indices.end());
+  }
+  return result;
+}
+
+ScalarFunctionPtr zero_function() {
+  auto make = [] { return intern(std::unique_ptr<IScalarFunction>(std::make_unique<ScalarNumber>("0"))); };
+  if (ExpressionArena::current())
+    return make();  // interned in the arena
+  static const ScalarFunctionPtr zero = make();
+  return zero;
+}
+
+namespace {
+VectorFunctionPtr zero_vector_function() {
+  auto make = [] { return intern(std::unique_ptr<IVectorFunction>(std::make_unique<VectorZero>())); };
+  if (ExpressionArena::current())
+    return make();
+  static const VectorFunctionPtr zero = make();
+  return zero;
+}
+}  // namespace
+
+std::vector<ScalarFunctionPtr> partial_derivatives(const IScalarFunction& f,
+                                                   const Index first,
+                                                   const Index last,
+                                                   const DiffOptions& options) {
+  // f = ((t_0 ± t_1) ± t_2) ± ... (a single term if f is not a sum)
+  struct Term {
+    const IScalarFunction* function;
+    bool subtracted;
+  };
+  std::vector<Term> terms;
+  for (const IScalarFunction* node = &f;;) {
+    if (const auto* sum = dynamic_cast<const ScalarAdd*>(node)) {
+      terms.push_back({sum->rhs().get(), false});
+      node = sum->lhs().get();
+    } else if (const auto* difference = dynamic_cast<const ScalarSub*>(node)) {
+      terms.push_back({difference->rhs().get(), true});
+      node = difference->lhs().get();
+    } else {
+      terms.push_back({node, false});
+      break;
+    }
+  }
+  std::reverse(terms.begin(), terms.end());
+
+  // terms using each coordinate, in order, from the exact dependencies of each term
+  std::vector<std::vector<std::size_t>> users(last - first);
+  std::vector<std::size_t> dense;  // terms using x as a whole
+  for (std::size_t k = 0; k < terms.size(); ++k) {
+    const Dependencies d = dependencies(*terms[k].function);
+    if (d.all) {
+      dense.push_back(k);
+      continue;
+    }
+    for (auto it = std::lower_bound(d.indices.begin(), d.indices.end(), first); it != d.indices.end() && *it < last;
+         ++it) {
+      users[*it - first].push_back(k);
+    }
+  }
+
+  // as diff: a term that does not use x_i adds no node, a difference from a constant prefix keeps its 0-
+  std::vector<ScalarFunctionPtr> result;
+  result.reserve(last - first);
+  std::vector<std::size_t> selected;
+  for (Index i = first; i < last; ++i) {
+    selected.clear();
+    std::merge(users[i - first].begin(), users[i - first].end(), dense.begin(), dense.end(),
+               std::back_inserter(selected));
+    ScalarFunctionPtr d;
+    for (const std::size_t k : selected) {
+      ScalarFunctionPtr dk = terms[k].function->diff(i);
+      if (terms[k].subtracted) {
+        d = intern(std::unique_ptr<IScalarFunction>(
+            std::make_unique<ScalarSub>((d) ? std::move(d) : zero_function(), std::move(dk))));
+      } else if (d) {
+        d = intern(std::unique_ptr<IScalarFunction>(std::make_unique<ScalarAdd>(std::move(d), std::move(dk))));
+      } else {
+        d = std::move(dk);
+      }
+    }
+    if (!d) {
+      result.push_back(zero_function());
+    } else {
+      result.push_back((options.simplify) ? intern(d->simplify()) : std::move(d));
+    }
+  }
+  return result;
+}
+
+auto IScalarFunction::diff(const Index I) const -> ScalarFunctionPtr {
+  if (!may_depend_on(I))
+    return zero_function();
+  return diff_impl(I);
+}
+
+auto IVectorFunction::diff(const Index I) const -> VectorFunctionPtr {
+  if (!may_depend_on(I))
+    return zero_vector_function();
+  return diff_impl(I);
+}
+
+auto IScalarFunction::diff(const Index I, const DiffOptions& options) const -> ScalarFunctionPtr {
+  ScalarFunctionPtr d = diff(I);
+  return (options.simplify) ? intern(d->simplify()) : d;
+}
+
+auto IVectorFunction::diff(const Index I, const DiffOptions& options) const -> VectorFunctionPtr {
+  VectorFunctionPtr d = diff(I);
+  return (options.simplify) ? intern(d->simplify()) : d;
+}
+
+auto IScalarFunction::compile(TapeBuilder& builder) const -> Index {
+  if (const std::optional<Index> found = builder.compiled(*this))
+    return *found;
+  return builder.remember(*this, compile_impl(builder));
+}
+
+auto IVectorFunction::compile(TapeBuilder& builder) const -> Index {
+  if (const std::optional<Index> found = builder.compiled(*this))
+    return *found;
+  return builder.remember(*this, compile_impl(builder));
+}
+
+IScalarFunction::~IScalarFunction() {
+  delete m_tape.load(std::memory_order_acquire);
+}
+
+auto IScalarFunction::apply(const Vector& x, const Vector& y) const -> Number {
+  return tape().apply(x, y);
+}
+
+auto IScalarFunction::gradient(const Vector& x) const -> Vector {
+  return tape().gradient(x);
+}
+
+auto IScalarFunction::tape() const -> const Tape& {
+  if (const Tape* compiled = m_tape.load(std::memory_order_acquire))
+    return *compiled;
+  // concurrent first uses may both compile: the first stored tape is kept
+  auto compiled = std::make_unique<const Tape>(::compile(*this));
+  const Tape* expected = nullptr;
+  if (m_tape.compare_exchange_strong(expected, compiled.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+    return *compiled.release();
+  return *expected;
+}
+
 std::string IFunction::strHelper(const IFunction& subExpr) const {
   if (subExpr.level() > this->level()) {
     return "(" + subExpr.string() + ")";
@@ -5,20 +5,184 @@
 #ifndef LIBKRIGING_PARSER__ASTNODE_HPP
 #define LIBKRIGING_PARSER__ASTNODE_HPP
 
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <typeindex>
 #include <vector>
 
 using Number = double;
 using Vector = std::vector<Number>;
 using Index =std::size_t;
 
+class TapeBuilder;
+struct IFunction;
+struct IScalarFunction;
+struct IVectorFunction;
+class Tape;
+template <typename T>
+class Operand;
+
+//! shared immutable nodes; children of every node are interned (hash-consed)
+using ScalarFunctionPtr = std::shared_ptr<const IScalarFunction>;
+using VectorFunctionPtr = std::shared_ptr<const IVectorFunction>;
+
+//! structural identity of a node: its type, its own data and its children.
+//! Children are interned, so they are compared by address.
+struct NodeKey {
+  std::type_index type;
+  std::string_view data;  // valid while the node is alive
+  Index index = 0;
+  std::array<const IFunction*, 2> children{};
+
+  bool operator==(const NodeKey& other) const;
+  [[nodiscard]] std::size_t hash() const;
+};
+
+//! dimension-major block of `count` vectors of size `dimension`:
+//! component i of vector p is stored at data[i * count + p]
+struct VectorBlock {
+  Index dimension = 0;
+  Index count = 0;
+  Vector data;
+
+  VectorBlock() = default;
+  VectorBlock(Index dimension, Index count, Number value = 0)
+      : dimension(dimension), count(count), data(dimension * count, value) {}
+
+  static VectorBlock from_points(const std::vector<Vector>& points);
+  [[nodiscard]] Vector point(Index p) const;
+
+  //! all values of component i (`count` contiguous values)
+  Number* component(Index i) { return data.data() + i * count; }
+  [[nodiscard]] const Number* component(Index i) const { return data.data() + i * count; }
+};
+
+//! value of a vector function, with its structure: known zero, sparse (one-hot vectors are sparse with a single
+//! entry of 1) or dense. Operations only visit stored entries: O(1) for zero and one-hot values, O(nnz) for sparse.
+//! Results are those of dense evaluation (the tape, apply_into): a structural zero times an infinite or NaN entry is
+//! NaN, so a dot product of a sparse or zero value with a dense one also checks the dense entries for them.
+class VectorValue {
+ public:
+  enum class Kind { Zero, Sparse, Dense };
+
+ public:
+  VectorValue() = default;
+  //! dense value
+  explicit VectorValue(Vector values) : m_kind(Kind::Dense), m_dimension(values.size()), m_values(std::move(values)) {}
+  static VectorValue zero(Index dimension);
+  static VectorValue one_hot(Index dimension, Index index);
+  //! indices are strictly increasing
+  static VectorValue sparse(Index dimension, std::vector<Index> indices, Vector values);
+  //! dense value reading data (not copied), which must outlive the value and its copies
+  static VectorValue view(const Number* data, Index dimension);
+
+  [[nodiscard]] Kind kind() const { return m_kind; }
+  [[nodiscard]] Index dimension() const { return m_dimension; }
+  //! stored entries: 0 for zero, nnz for sparse, the dimension for dense
+  [[nodiscard]] Index stored() const;
+  //! indices and values of a sparse value
+  [[nodiscard]] const std::vector<Index>& indices() const { return m_indices; }
+  [[nodiscard]] const Vector& values() const { return m_values; }
+  //! entries of a dense value
+  [[nodiscard]] const Number* data() const { return (m_view) ? m_view : m_values.data(); }
+
+  [[nodiscard]] Number operator[](Index i) const;
+  [[nodiscard]] Vector dense() const&;
+  [[nodiscard]] Vector dense() &&;
+
+  static VectorValue add(VectorValue a, const VectorValue& b);
+  static VectorValue sub(VectorValue a, const VectorValue& b);
+  static VectorValue negate(VectorValue a);
+  static VectorValue scale(Number s, VectorValue a);
+  static VectorValue scale_divide(VectorValue a, Number s);
+  static Number dot(const VectorValue& a, const VectorValue& b);
+
+ private:
+  Kind m_kind = Kind::Zero;
+  Index m_dimension = 0;
+  std::vector<Index> m_indices;    // sparse
+  Vector m_values;                 // sparse values, or dense entries when not a view
+  const Number* m_view = nullptr;  // dense entries not owned
+};
+
+//! non-owning view of `size` contiguous numbers
+struct Span {
+  Number* data = nullptr;
+  Index size = 0;
+
+  Span() = default;
+  Span(Number* data, Index size) : data(data), size(size) {}
+  Span(Vector& v) : data(v.data()), size(v.size()) {}
+  Number& operator[](Index i) const { return data[i]; }
+};
+
+//! scratch buffers of tree evaluation (apply with a Workspace, apply_into).
+//! Buffers are kept between evaluations: once warmed up on a function and a dimension, evaluations allocate nothing.
+class Workspace {
+ public:
+  //! buffer of n numbers, released at the end of its scope (in reverse order of acquisition)
+  class Buffer {
+   public:
+    Buffer(Workspace& workspace, Index n);
+    ~Buffer() { --m_workspace.m_depth; }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    [[nodiscard]] Span span() const { return m_span; }
+    [[nodiscard]] Number* data() const { return m_span.data; }
+
+   private:
+    Workspace& m_workspace;
+    Span m_span;
+  };
+
+  //! number of buffers held (maximum nesting reached)
+  [[nodiscard]] std::size_t buffer_count() const { return m_buffers.size(); }
+
+ private:
+  std::vector<Vector> m_buffers;  // moving a Vector keeps its data in place
+  std::size_t m_depth = 0;
+};
+
+//! value and directional derivative of a scalar function (forward mode)
+struct Tangent {
+  Number value = 0;
+  Number derivative = 0;
+};
+
+//! value and directional derivatives along k directions
+struct Tangents {
+  Number value = 0;
+  Vector derivatives;  // one per direction
+};
+
+struct VectorTangent {
+  Vector value;
+  Vector derivative;
+};
+
+struct VectorTangents {
+  Vector value;
+  VectorBlock derivatives;  // derivatives.component(i)[p] is the derivative of value[i] along direction p
+};
+
 class NotImplementedException : public std::logic_error {
  public:
   explicit NotImplementedException(const char* func_name, std::string extra = "")
       : std::logic_error{std::string{func_name} + " is not yet implemented" + extra} {}
 };
 
+struct DiffOptions {
+  bool simplify = false;  //! simplify the derivative before returning it
+};
+
 enum class PriorityLevel : int {
   Unknown,
   Value,
@@ -28,27 +192,150 @@ enum class PriorityLevel : int {
   Term
 };
 
+//! coordinates of x a node may depend on, summarized once when the node is built (O(1) size and merge).
+//! Conservative: may_contain(i) is false only when the node surely does not depend on x_i. It is exact for nodes
+//! using x_i with distinct i % 64 only: a node using more coordinates seems to depend on most of its range, so the
+//! gradient of a large sum is built by partial_derivatives from exact dependencies.
+class DependencyMask {
+ public:
+  static DependencyMask all();
+  static DependencyMask index(Index i);
+
+  void merge(const DependencyMask& other);
+  [[nodiscard]] bool empty() const { return !m_all && m_bits == 0; }
+  [[nodiscard]] bool may_contain(const Index i) const {
+    return m_all || (m_min <= i && i <= m_max && ((m_bits >> (i % 64)) & 1) != 0);
+  }
+
+ private:
+  bool m_all = false;
+  Index m_min = std::numeric_limits<Index>::max();
+  Index m_max = 0;
+  std::uint64_t m_bits = 0;  // bit i % 64 for each x_i
+};
+
 struct IFunction {
   virtual ~IFunction() = default;
 
  public:
   [[nodiscard]] virtual std::string string() const = 0;
   [[nodiscard]] virtual PriorityLevel level() const = 0;
+  [[nodiscard]] virtual NodeKey key() const = 0;
+  //! bytes held by this node alone: its object and the data it owns (children excluded)
+  [[nodiscard]] virtual std::size_t memory_size() const = 0;
   
   std::string strHelper(const IFunction & subExpr) const;
+
+  //! false when this function surely does not depend on x_i: its derivative along x_i is zero
+  [[nodiscard]] bool may_depend_on(const Index i) const { return m_dependencies.may_contain(i); }
+  [[nodiscard]] const DependencyMask& dependency_mask() const { return m_dependencies; }
+
+  //! nodes are allocated in the current ExpressionArena, if any (see ExpressionArena.hpp)
+  static void* operator new(std::size_t size);
+  static void operator delete(void* p);
+
+ protected:
+  //! summarizes the dependencies of the node from its key(); called by the constructors of nodes using x
+  void init_dependencies();
+
+ private:
+  friend struct InternTable;
+  friend class ExpressionArena;
+  DependencyMask m_dependencies;
+  mutable std::atomic<bool> m_interned{false};  // set by the intern table (or by its arena), read without lock
 };
 
 struct IScalarFunction : IFunction {
+  ~IScalarFunction() override;
   virtual std::unique_ptr<IScalarFunction> clone() const = 0;  
   [[nodiscard]] virtual auto apply(const Vector& x) const -> Number = 0;
-  virtual auto diff(const Index I) const -> std::unique_ptr<IScalarFunction> = 0; 
+  //! same as apply(x), with temporaries taken from workspace
+  [[nodiscard]] virtual auto apply(const Vector& x, Workspace& workspace) const -> Number = 0;
+  //! one result per point of x
+  [[nodiscard]] virtual auto apply_batch(const VectorBlock& x) const -> Vector = 0;
+  //! value of a function of x and y at the pair (x, y), through tape()
+  [[nodiscard]] auto apply(const Vector& x, const Vector& y) const -> Number;
+  //! derivative along x_I, interned; the shared zero_function() at once when this function does not depend on x_I
+  auto diff(Index I) const -> ScalarFunctionPtr;
+  [[nodiscard]] auto diff(Index I, const DiffOptions& options) const -> ScalarFunctionPtr;
+  //! equivalent function without dead arithmetic (constant folding, neutral and absorbing elements, zero vectors).
+  //! Equivalent for finite operands and nonzero divisors only: 0*f, 0/f and f-f become 0 and dot(e_i,x) becomes x_i,
+  //! where IEEE arithmetic gives NaN for an infinite f (or 0/0) and propagates a NaN of x
+  [[nodiscard]] virtual auto simplify() const -> std::unique_ptr<IScalarFunction> = 0;
+  //! equivalent function where the known shapes of covariance kernels are single fused nodes (see QuadraticForm and
+  //! ExponentialQuadratic in ASTNode.cpp): each is evaluated in one pass without temporary vectors, and so are its
+  //! derivatives
+  [[nodiscard]] virtual auto fuse() const -> std::unique_ptr<IScalarFunction> = 0;
+  //! all partial derivatives at x in a single forward and backward sweep (reverse mode), through tape()
+  [[nodiscard]] auto gradient(const Vector& x) const -> Vector;
+  //! this function compiled, on first use only (nodes are immutable); for repeated calls without allocating, keep
+  //! a Workspace for tape().apply(x, y, workspace) or tape().gradient(x, workspace)
+  [[nodiscard]] auto tape() const -> const Tape&;
+  //! emits instructions computing this function, once per builder (a shared subexpression reuses its register);
+  //! returns the scalar register holding the result
+  auto compile(TapeBuilder& builder) const -> Index;
+  //! f(x) and its derivative along v, in a single pass (forward mode)
+  [[nodiscard]] virtual auto apply_tangent(const Vector& x, const Vector& v) const -> Tangent = 0;
+  //! f(x) and its derivatives along each point of directions (a block of dimension x.size())
+  [[nodiscard]] virtual auto apply_tangents(const Vector& x, const VectorBlock& directions) const -> Tangents = 0;
+
+ private:
+  //! derivative of a node that may depend on x_I
+  virtual auto diff_impl(Index I) const -> Operand<IScalarFunction> = 0;
+  //! emits the instructions of this node, its children being compiled through compile
+  virtual auto compile_impl(TapeBuilder& builder) const -> Index = 0;
+
+  mutable std::atomic<const Tape*> m_tape{nullptr};  // set once by tape(), read without lock, owned
 };
 
 struct IVectorFunction : IFunction {
   virtual std::unique_ptr<IVectorFunction> clone() const = 0;
-  [[nodiscard]] virtual auto apply(const Vector& x) const -> Vector = 0;
-  virtual auto diff(const Index I) const -> std::unique_ptr<IVectorFunction> = 0;
+  //! the value may refer to x
+  [[nodiscard]] virtual auto apply(const Vector& x) const -> VectorValue = 0;
+  //! writes apply(x) to out (of size x.size()), with temporaries taken from workspace
+  virtual void apply_into(const Vector& x, Span out, Workspace& workspace) const = 0;
+  //! one result vector per point of x
+  [[nodiscard]] virtual auto apply_batch(const VectorBlock& x) const -> VectorBlock = 0;
+  //! derivative along x_I, interned; a shared zero vector at once when this function does not depend on x_I
+  auto diff(Index I) const -> VectorFunctionPtr;
+  [[nodiscard]] auto diff(Index I, const DiffOptions& options) const -> VectorFunctionPtr;
+  //! same as IScalarFunction::simplify, assuming finite operands
+  [[nodiscard]] virtual auto simplify() const -> std::unique_ptr<IVectorFunction> = 0;
+  [[nodiscard]] virtual auto fuse() const -> std::unique_ptr<IVectorFunction> = 0;
+  //! emits instructions computing this function, once per builder; returns the vector register holding the result
+  auto compile(TapeBuilder& builder) const -> Index;
+  [[nodiscard]] virtual auto apply_tangent(const Vector& x, const Vector& v) const -> VectorTangent = 0;
+  [[nodiscard]] virtual auto apply_tangents(const Vector& x, const VectorBlock& directions) const
+      -> VectorTangents = 0;
+
+ private:
+  virtual auto diff_impl(Index I) const -> Operand<IVectorFunction> = 0;
+  virtual auto compile_impl(TapeBuilder& builder) const -> Index = 0;
+};
+
+//! unique shared node structurally equal to f (hash-consing); f itself if it is the first of its kind.
+//! Inside an ExpressionArena scope, nodes are interned in the arena.
+ScalarFunctionPtr intern(std::unique_ptr<IScalarFunction> f);
+ScalarFunctionPtr intern(ScalarFunctionPtr f);
+VectorFunctionPtr intern(std::unique_ptr<IVectorFunction> f);
+VectorFunctionPtr intern(VectorFunctionPtr f);
+
+//! child argument of node constructors: takes a new node or shares an existing one, and interns it
+template <typename T>
+class Operand {
+ public:
+  template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  Operand(std::unique_ptr<U>&& f) : m_f(intern(std::unique_ptr<T>(std::move(f)))) {}
+  template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, const T*>>>
+  Operand(const std::shared_ptr<U>& f) : m_f(intern(std::shared_ptr<const T>(f))) {}
+
+  operator std::shared_ptr<const T>() && { return std::move(m_f); }
+
+ private:
+  std::shared_ptr<const T> m_f;
 };
+using ScalarOperand = Operand<IScalarFunction>;
+using VectorOperand = Operand<IVectorFunction>;
 
 #include <tao/pegtl/contrib/parse_tree.hpp>
 
@@ -72,4 +359,92 @@ class ASTNode : public tao::TAO_PEGTL_NAMESPACE::parse_tree::basic_node<ASTNode>
 
 std::unique_ptr<IScalarFunction> build_function(ASTNode& node);
 
+//! builds a function bottom-up from parser events, without parse tree (see parse_function in grammar.hpp).
+//! Values and operators are pushed in source order; a frame gathers those of one grammar rule, and is either
+//! dropped (the rule failed and the parser backtracks) or reduced to a single value.
+//! The kind (scalar or vectorial) of each value is known as soon as it is built.
+class FunctionBuilder {
+ public:
+  enum class Operator { Add, Sub, Multiply, Divide, PrefixPlus, PrefixMinus };
+
+  void scalar_value(std::string_view name);  // variable or constant
+  void number(std::string_view text);
+  void vector_value(std::string_view name);
+  //! replaces the vectorial top value v by v_index
+  void index(std::string_view index);
+  void operation(Operator op);
+
+  void open();
+  //! drops values and operators of the frame
+  void drop();
+  //! keeps values and operators of the frame in the enclosing one
+  void close();
+  //! left-associative reduction of the frame (an optional prefix operator, then alternating values and operators)
+  void fold();
+  //! names the function applied by call
+  void name(std::string_view name);
+  //! replaces the values of the frame by the named function applied to them
+  void call();
+
+  //! the built function, once the whole expression is parsed
+  std::unique_ptr<IScalarFunction> result();
+
+ private:
+  struct Value {
+    std::unique_ptr<IScalarFunction> scalar;
+    std::unique_ptr<IVectorFunction> vector;  // set instead of scalar for vectorial values
+  };
+  struct Frame {
+    std::size_t values;
+    std::size_t operators;
+    std::string_view name;
+  };
+
+  static Value combine(Operator op, Value&& lhs, Value&& rhs);
+  static Value prefix(Operator op, Value&& operand);
+  void reduce(Value&& value);
+
+  std::vector<Value> m_values;
+  std::vector<Operator> m_operators;
+  std::vector<Frame> m_frames;
+};
+
+//! number of live interned nodes (outside arenas)
+std::size_t interned_count();
+
+//! number of distinct nodes reachable from f (shared subexpressions counted once)
+std::size_t dag_size(const IFunction& f);
+//! number of nodes of the equivalent tree (shared subexpressions counted at each use)
+std::size_t tree_size(const IFunction& f);
+
+//! coordinates of x a function depends on: every coordinate if it uses x as a whole, else its x_i
+struct Dependencies {
+  bool all = false;
+  std::vector<Index> indices;  // strictly increasing, empty when all is set
+
+  [[nodiscard]] bool empty() const { return !all && indices.empty(); }
+  [[nodiscard]] bool contains(Index i) const;
+};
+Dependencies dependencies(const IFunction& f);
+//! shared constant 0: the derivative along the coordinates a function does not depend on
+ScalarFunctionPtr zero_function();
+//! f.diff(i, options) for first <= i < last, in one pass: a sum or difference is split into its terms, each term
+//! is differentiated along the coordinates it uses only (its exact dependencies, found once) and the other
+//! coordinates get zero_function(). A sum of n terms using a few x_i each costs O(n + nonzeros), where calling
+//! diff(i) for each i walks the whole chain of sums each time.
+std::vector<ScalarFunctionPtr> partial_derivatives(const IScalarFunction& f,
+                                                   Index first,
+                                                   Index last,
+                                                   const DiffOptions& options = {});
+
+//! memory held by a function, shared subexpressions counted once
+struct MemoryFootprint {
+  std::size_t bytes = 0;             //! nodes (with their allocation header) and the data they own
+  std::size_t nodes = 0;             //! distinct nodes, as dag_size
+  std::size_t depth = 0;             //! nodes on the longest path from the root to a leaf
+  std::size_t heap_allocations = 0;  //! heap blocks held: nodes outside of arenas and their out of line strings
+  std::map<std::string, std::size_t> nodes_by_class;  //! distinct nodes per class
+};
+MemoryFootprint memory_footprint(const IFunction& f);
+
 #endif  // LIBKRIGING_PARSER__ASTNODE_HPP
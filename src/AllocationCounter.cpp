@@ -0,0 +1,44 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local AllocationCount thread_count;  // trivial: usable from operator new at any time
+
+void* allocate(const std::size_t size) {
+  ++thread_count.allocations;
+  thread_count.bytes += size;
+  if (void* p = std::malloc((size == 0) ? 1 : size))
+    return p;
+  throw std::bad_alloc{};
+}
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+  return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+AllocationCount allocation_count() {
+  return thread_count;
+}
@@ -0,0 +1,33 @@
+#ifndef LIBKRIGING_PARSER__ALLOCATIONCOUNTER_HPP
+#define LIBKRIGING_PARSER__ALLOCATIONCOUNTER_HPP
+
+#include <cstddef>
+
+// Count of heap allocations, per thread (threads never share a counter).
+// AllocationCounter.cpp replaces the global operator new by one counting every allocation and the bytes requested.
+// It is not part of the parser library: programs counting their allocations link the allocation_counter object
+// library (see src/CMakeLists.txt), and must not replace operator new themselves.
+
+struct AllocationCount {
+  std::size_t allocations = 0;
+  std::size_t bytes = 0;
+};
+
+//! allocations made by the current thread since it started
+AllocationCount allocation_count();
+
+//! allocations made by the current thread since construction
+class AllocationCounter {
+ public:
+  AllocationCounter() : m_start(allocation_count()) {}
+
+  [[nodiscard]] AllocationCount count() const {
+    const AllocationCount now = allocation_count();
+    return {now.allocations - m_start.allocations, now.bytes - m_start.bytes};
+  }
+
+ private:
+  AllocationCount m_start;
+};
+
+#endif  // LIBKRIGING_PARSER__ALLOCATIONCOUNTER_HPP
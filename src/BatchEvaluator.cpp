@@ -0,0 +1,41 @@
+#include "BatchEvaluator.hpp"
+
+namespace {
+void gather(const VectorBlock& points, const Index p, Vector& x) {
+  for (std::size_t i = 0; i < points.dimension; ++i) {
+    x[i] = points.component(i)[p];
+  }
+}
+}  // namespace
+
+BatchEvaluator::BatchEvaluator(const IScalarFunction& f, ThreadPool& pool, const Index chunk)
+    : m_tape(::compile(f)), m_pool(pool), m_chunk(chunk) {}
+
+Vector BatchEvaluator::apply(const VectorBlock& points) const {
+  Vector result(points.count);
+  m_pool.parallel_for(0, points.count, m_chunk, [&](const Index begin, const Index end) {
+    Tape::Workspace workspace;
+    Vector x(points.dimension);
+    for (Index p = begin; p < end; ++p) {
+      gather(points, p, x);
+      result[p] = m_tape.apply(x, workspace);
+    }
+  });
+  return result;
+}
+
+VectorBlock BatchEvaluator::gradient(const VectorBlock& points) const {
+  VectorBlock result(points.dimension, points.count);
+  m_pool.parallel_for(0, points.count, m_chunk, [&](const Index begin, const Index end) {
+    Tape::Workspace workspace;
+    Vector x(points.dimension);
+    for (Index p = begin; p < end; ++p) {
+      gather(points, p, x);
+      const Vector g = m_tape.gradient(x, workspace);
+      for (std::size_t i = 0; i < points.dimension; ++i) {
+        result.component(i)[p] = g[i];
+      }
+    }
+  });
+  return result;
+}
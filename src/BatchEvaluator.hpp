@@ -0,0 +1,30 @@
+#ifndef LIBKRIGING_PARSER__BATCHEVALUATOR_HPP
+#define LIBKRIGING_PARSER__BATCHEVALUATOR_HPP
+
+#include "ASTNode.hpp"
+#include "Tape.hpp"
+#include "ThreadPool.hpp"
+
+// Evaluation of one function on a large set of points, in parallel on a ThreadPool.
+// Points are split into chunks evaluated by the compiled tape, with one workspace per chunk.
+//
+// Thread safety: const member functions of the nodes (apply, apply_batch, apply_tangent(s), diff, simplify,
+// compile, string) never modify a node, and interning only uses the atomic flag of a node and the locked table.
+// A function may therefore be shared and evaluated by any number of threads, as done here.
+
+class BatchEvaluator {
+ public:
+  BatchEvaluator(const IScalarFunction& f, ThreadPool& pool, Index chunk = 1024);
+
+  //! one value per point
+  [[nodiscard]] Vector apply(const VectorBlock& points) const;
+  //! gradients of f: component i of point p is the partial derivative along x_i at point p
+  [[nodiscard]] VectorBlock gradient(const VectorBlock& points) const;
+
+ private:
+  Tape m_tape;
+  ThreadPool& m_pool;
+  Index m_chunk;
+};
+
+#endif  // LIBKRIGING_PARSER__BATCHEVALUATOR_HPP
@@ -0,0 +1,92 @@
+#include "BulkLoader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <istream>
+#include <sstream>
+#include <tao/pegtl/string_input.hpp>
+
+#include "grammar.hpp"
+
+namespace {
+std::string trimmed(const std::string& s, const std::size_t begin, const std::size_t end) {
+  const std::size_t first = s.find_first_not_of(" \t\r", begin);
+  if (first == std::string::npos || first >= end)
+    return {};
+  const std::size_t last = s.find_last_not_of(" \t\r", end - 1);
+  return s.substr(first, last + 1 - first);
+}
+
+LoadedFunction load(const CatalogueRecord& record, const std::string& source) {
+  LoadedFunction loaded;
+  const auto start = std::chrono::steady_clock::now();
+  tao::TAO_PEGTL_NAMESPACE::string_input in(record.expression, source + ":" + std::to_string(record.line));
+  try {
+    loaded.function = parse_function(in);
+  } catch (const tao::TAO_PEGTL_NAMESPACE::parse_error& e) {
+    const auto p = e.positions.front();
+    std::ostringstream report;
+    report << e.what() << '\n' << in.line_at(p) << '\n' << std::string(p.byte_in_line, ' ') << '^';
+    loaded.error = report.str();
+  } catch (const std::exception& e) {
+    loaded.error = e.what();
+  }
+  loaded.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return loaded;
+}
+}  // namespace
+
+std::vector<CatalogueRecord> read_catalogue(std::istream& in) {
+  std::vector<CatalogueRecord> records;
+  std::string line;
+  for (Index number = 1; std::getline(in, line); ++number) {
+    const std::size_t equal = line.find('=');
+    CatalogueRecord record{number, {}, trimmed(line, 0, line.size())};
+    if (record.expression.empty() || record.expression.front() == '#')
+      continue;
+    if (equal != std::string::npos) {
+      record.name = trimmed(line, 0, equal);
+      record.expression = trimmed(line, equal + 1, line.size());
+    }
+    records.push_back(std::move(record));
+  }
+  return records;
+}
+
+std::size_t BulkLoad::failures() const {
+  return std::count_if(functions.begin(), functions.end(), [](const LoadedFunction& f) { return !f.function; });
+}
+
+double BulkLoad::throughput() const {
+  return (seconds > 0) ? static_cast<double>(functions.size()) / seconds : 0;
+}
+
+double BulkLoad::latency(const double q) const {
+  assert(q >= 0 && q <= 1);
+  if (functions.empty())
+    return 0;
+  std::vector<double> latencies(functions.size());
+  std::transform(functions.begin(), functions.end(), latencies.begin(), [](const LoadedFunction& f) {
+    return f.seconds;
+  });
+  const auto rank = static_cast<std::size_t>(std::ceil(q * static_cast<double>(latencies.size())));
+  const auto nth = latencies.begin() + ((rank > 0) ? rank - 1 : 0);
+  std::nth_element(latencies.begin(), nth, latencies.end());
+  return *nth;
+}
+
+BulkLoad load_catalogue(const std::vector<CatalogueRecord>& records, ThreadPool& pool, const std::string& source) {
+  BulkLoad result;
+  result.functions.resize(records.size());
+  const auto start = std::chrono::steady_clock::now();
+  // expressions cost a few microseconds: small chunks balance uneven ones by stealing
+  pool.parallel_for(0, records.size(), 16, [&](const Index begin, const Index end) {
+    for (Index k = begin; k < end; ++k) {
+      result.functions[k] = load(records[k], source);
+    }
+  });
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
@@ -0,0 +1,50 @@
+#ifndef LIBKRIGING_PARSER__BULKLOADER_HPP
+#define LIBKRIGING_PARSER__BULKLOADER_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "ThreadPool.hpp"
+
+// Bulk loading of expression catalogues: every expression is parsed and built (parse_function) in parallel on a
+// ThreadPool, and results are kept in the order of the catalogue.
+//
+// Catalogue format: one record per line, either `expression` or `name = expression` (expressions never contain
+// '='). Blank lines and lines starting with '#' are skipped.
+// An expression that fails keeps its error report; parse errors are reported as by main:
+//   source:line:column(byte): message     (source is `catalogue source:catalogue line`, line/column in the record)
+//   expression
+//       ^
+
+struct CatalogueRecord {
+  Index line = 0;  // 1-based line in the catalogue
+  std::string name;
+  std::string expression;
+};
+
+//! records of a catalogue, in order
+std::vector<CatalogueRecord> read_catalogue(std::istream& in);
+
+struct LoadedFunction {
+  std::unique_ptr<IScalarFunction> function;  // null if the expression failed
+  std::string error;
+  double seconds = 0;  // parse + build latency
+};
+
+struct BulkLoad {
+  std::vector<LoadedFunction> functions;  // functions[k] is built from records[k]
+  double seconds = 0;                     // wall time of the whole load
+
+  [[nodiscard]] std::size_t failures() const;
+  //! expressions per second
+  [[nodiscard]] double throughput() const;
+  //! q-quantile (0 <= q <= 1) of the per-expression latencies, by nearest rank
+  [[nodiscard]] double latency(double q) const;
+};
+
+//! parses and builds every record on pool; source names the catalogue in error reports
+BulkLoad load_catalogue(const std::vector<CatalogueRecord>& records, ThreadPool& pool, const std::string& source);
+
+#endif  // LIBKRIGING_PARSER__BULKLOADER_HPP
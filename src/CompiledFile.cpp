@@ -0,0 +1,299 @@
+#include "CompiledFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LIBKRIGING_PARSER_HAS_MMAP
+#endif
+
+static_assert(std::is_trivially_copyable_v<Instruction>);
+
+namespace {
+constexpr char magic[8] = "LKPTAPE";
+constexpr std::uint32_t format_version = 1;
+
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t number_size;
+  std::uint32_t instruction_size;
+  std::uint32_t function_count;
+};
+
+struct TapeHeader {
+  std::uint32_t instructions;
+  std::uint32_t constants;
+  std::uint32_t scalar_registers;
+  std::uint32_t vector_registers;
+  std::uint32_t result;
+  std::uint32_t padding;
+};
+
+constexpr std::size_t align(const std::size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+class Writer {
+ public:
+  explicit Writer(std::ostream& out) : m_out(out) {}
+
+  void write(const void* data, const std::size_t size) {
+    m_out.write(static_cast<const char*>(data), size);
+    static const char zeros[8] = {};
+    m_out.write(zeros, align(size) - size);
+  }
+  template <typename T>
+  void write(const T& value) {
+    write(&value, sizeof(T));
+  }
+
+ private:
+  std::ostream& m_out;
+};
+
+// read-only view of the whole file
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename) {
+#ifdef LIBKRIGING_PARSER_HAS_MMAP
+    const int descriptor = ::open(filename.c_str(), O_RDONLY);
+    struct stat status {};
+    if (descriptor < 0 || ::fstat(descriptor, &status) != 0) {
+      if (descriptor >= 0)
+        ::close(descriptor);
+      throw std::runtime_error("cannot open " + filename);
+    }
+    m_size = static_cast<std::size_t>(status.st_size);
+    void* data = (m_size > 0) ? ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0) : nullptr;
+    ::close(descriptor);
+    if (data == MAP_FAILED)
+      throw std::runtime_error("cannot map " + filename);
+    m_data = static_cast<const char*>(data);
+#else
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in)
+      throw std::runtime_error("cannot open " + filename);
+    m_buffer.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(m_buffer.data(), m_buffer.size());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+  }
+  ~MappedFile() {
+#ifdef LIBKRIGING_PARSER_HAS_MMAP
+    if (m_data)
+      ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  [[nodiscard]] const char* data() const { return m_data; }
+  [[nodiscard]] std::size_t size() const { return m_size; }
+
+ private:
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+#ifndef LIBKRIGING_PARSER_HAS_MMAP
+  std::vector<char> m_buffer;
+#endif
+};
+
+class Reader {
+ public:
+  Reader(const char* data, const std::size_t size, const std::string& filename)
+      : m_data(data), m_size(size), m_filename(filename) {}
+
+  //! bytes left after the current position
+  [[nodiscard]] std::size_t remaining() const { return m_size - m_offset; }
+  //! next `size` bytes (and their padding)
+  const char* next(const std::size_t size) {
+    if (size > m_size - m_offset || align(size) > m_size - m_offset)
+      fail("truncated");
+    const char* p = m_data + m_offset;
+    m_offset += align(size);
+    return p;
+  }
+  template <typename T>
+  T read() {
+    T value;
+    std::memcpy(&value, next(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  [[noreturn]] void fail(const std::string& reason) const {
+    throw std::runtime_error(m_filename + " is not a valid compiled file: " + reason);
+  }
+
+ private:
+  const char* m_data;
+  std::size_t m_size;
+  std::size_t m_offset = 0;
+  const std::string& m_filename;
+};
+
+bool valid_registers(const Instruction& inst, const TapeHeader& header) {
+  auto scalar = [&](const std::uint32_t r) { return r < header.scalar_registers; };
+  auto vector = [&](const std::uint32_t r) { return r < header.vector_registers; };
+  const bool result = (is_vector_op(inst.op)) ? inst.result != Tape::input_register && vector(inst.result)
+                                               : scalar(inst.result);
+  switch (inst.op) {
+    case OpCode::Constant:
+      return result && inst.lhs < header.constants;
+    case OpCode::Add:
+    case OpCode::Sub:
+    case OpCode::Mul:
+    case OpCode::Div:
+      return result && scalar(inst.lhs) && scalar(inst.rhs);
+    case OpCode::Neg:
+    case OpCode::Exp:
+      return result && scalar(inst.lhs);
+    case OpCode::Dot:
+    case OpCode::SquaredDistance:
+    case OpCode::VectorAdd:
+    case OpCode::VectorSub:
+      return result && vector(inst.lhs) && vector(inst.rhs);
+    case OpCode::Norm:
+    case OpCode::Component:  // rhs sets the dimension of the tape, checked at evaluation
+    case OpCode::VectorNeg:
+      return result && vector(inst.lhs);
+    case OpCode::VectorZero:
+    case OpCode::VectorPartialOne:  // lhs sets the dimension of the tape, checked at evaluation
+    case OpCode::SecondInput:
+      return result;
+    case OpCode::ScalarVectorProduct:
+      return result && scalar(inst.lhs) && vector(inst.rhs);
+    case OpCode::VectorScalarDivide:
+      return result && vector(inst.lhs) && scalar(inst.rhs);
+  }
+  return false;  // unknown opcode
+}
+}  // namespace
+
+class TapeLoader {
+ public:
+  static void save(Writer& writer, const Tape& tape) {
+    writer.write(TapeHeader{static_cast<std::uint32_t>(tape.m_instructions.size()),
+                            static_cast<std::uint32_t>(tape.m_constants.size()), tape.m_scalar_registers,
+                            tape.m_vector_registers, tape.m_result, 0});
+    // instructions are copied field by field so that padding bytes are written as zeros
+    std::vector<Instruction> instructions(tape.m_instructions.size());
+    std::memset(static_cast<void*>(instructions.data()), 0, instructions.size() * sizeof(Instruction));
+    for (std::size_t k = 0; k < instructions.size(); ++k) {
+      const Instruction& inst = tape.m_instructions[k];
+      instructions[k].op = inst.op;
+      instructions[k].result = inst.result;
+      instructions[k].lhs = inst.lhs;
+      instructions[k].rhs = inst.rhs;
+    }
+    writer.write(instructions.data(), instructions.size() * sizeof(Instruction));
+    writer.write(tape.m_constants.data(), tape.m_constants.size() * sizeof(Number));
+  }
+
+  static Tape load(Reader& reader) {
+    const auto header = reader.read<TapeHeader>();
+    // counts are checked against the file before allocating anything
+    if (header.instructions > reader.remaining() / sizeof(Instruction)
+        || header.constants > reader.remaining() / sizeof(Number))
+      reader.fail("truncated");
+    Tape tape;
+    tape.m_instructions.resize(header.instructions);
+    std::memcpy(static_cast<void*>(tape.m_instructions.data()),
+                reader.next(header.instructions * sizeof(Instruction)), header.instructions * sizeof(Instruction));
+    tape.m_constants.resize(header.constants);
+    std::memcpy(tape.m_constants.data(), reader.next(header.constants * sizeof(Number)),
+                header.constants * sizeof(Number));
+    tape.m_scalar_registers = header.scalar_registers;
+    tape.m_vector_registers = header.vector_registers;
+    tape.m_result = header.result;
+
+    if (header.vector_registers == 0 || header.result >= header.scalar_registers)
+      reader.fail("invalid registers");
+    for (const Instruction& inst : tape.m_instructions) {
+      if (!valid_registers(inst, header))
+        reader.fail("invalid instruction");
+      tape.m_dimension = std::max(tape.m_dimension, required_dimension(inst));
+    }
+    return tape;
+  }
+};
+
+CompiledFunction compile_function(const std::string& expression, const IScalarFunction& f, const Index derivatives) {
+  CompiledFunction result{expression, compile(f), {}};
+  const ScalarFunctionPtr zero = zero_function();
+  const Tape zero_tape = compile(*zero);
+  for (const ScalarFunctionPtr& derivative : partial_derivatives(f, 0, derivatives, DiffOptions{true})) {
+    result.derivatives.push_back((derivative == zero) ? zero_tape : compile(*derivative));
+  }
+  return result;
+}
+
+void save_compiled(const std::string& filename, const std::vector<CompiledFunction>& functions) {
+  std::ofstream out(filename, std::ios::binary);
+  if (!out)
+    throw std::runtime_error("cannot write " + filename);
+  Writer writer(out);
+  FileHeader header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = format_version;
+  header.number_size = sizeof(Number);
+  header.instruction_size = sizeof(Instruction);
+  header.function_count = static_cast<std::uint32_t>(functions.size());
+  writer.write(header);
+  for (const CompiledFunction& function : functions) {
+    writer.write(static_cast<std::uint64_t>(function.expression.size()));
+    writer.write(function.expression.data(), function.expression.size());
+    writer.write(static_cast<std::uint64_t>(1 + function.derivatives.size()));
+    TapeLoader::save(writer, function.function);
+    for (const Tape& derivative : function.derivatives) {
+      TapeLoader::save(writer, derivative);
+    }
+  }
+  if (!out.flush())
+    throw std::runtime_error("cannot write " + filename);
+}
+
+std::vector<CompiledFunction> load_compiled(const std::string& filename) {
+  const MappedFile file(filename);
+  Reader reader(file.data(), file.size(), filename);
+  const auto header = reader.read<FileHeader>();
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+    reader.fail("bad magic");
+  if (header.version != format_version)
+    reader.fail("format version " + std::to_string(header.version) + " instead of "
+                + std::to_string(format_version));
+  if (header.number_size != sizeof(Number) || header.instruction_size != sizeof(Instruction))
+    reader.fail("written on a platform of another layout");
+
+  // a function takes two counts and a tape header at least
+  if (header.function_count > reader.remaining() / (2 * sizeof(std::uint64_t) + sizeof(TapeHeader)))
+    reader.fail("invalid function count");
+
+  std::vector<CompiledFunction> functions(header.function_count);
+  for (CompiledFunction& function : functions) {
+    const auto length = reader.read<std::uint64_t>();
+    if (length > reader.remaining())
+      reader.fail("truncated");
+    function.expression.assign(reader.next(length), length);
+    const auto tapes = reader.read<std::uint64_t>();
+    if (tapes == 0 || tapes > reader.remaining() / sizeof(TapeHeader))
+      reader.fail("invalid tape count");
+    function.function = TapeLoader::load(reader);
+    function.derivatives.reserve(tapes - 1);
+    for (std::uint64_t k = 1; k < tapes; ++k) {
+      function.derivatives.push_back(TapeLoader::load(reader));
+    }
+  }
+  return functions;
+}
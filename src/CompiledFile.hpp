@@ -0,0 +1,35 @@
+#ifndef LIBKRIGING_PARSER__COMPILEDFILE_HPP
+#define LIBKRIGING_PARSER__COMPILEDFILE_HPP
+
+#include <string>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "Tape.hpp"
+
+// Binary files of compiled functions: each function is stored with its expression and its partial derivatives,
+// as tapes. Loading maps the file and copies the instruction and constant arrays as they are (after checking
+// every count and register index), without parsing or building any tree. Component indices are not bounded by the
+// file: they set the dimension of the tape, checked by every evaluation.
+//
+// Layout (native byte order, every section aligned on 8 bytes):
+//   header:   magic "LKPTAPE", format version, sizeof(Number), sizeof(Instruction), function count
+//   function: expression length, expression characters, tape count (1 + number of derivatives)
+//   tape:     instruction count, constant count, scalar registers, vector registers, result,
+//             instructions, constants
+// A file written by another version of the format, or on a platform of another layout, is rejected.
+
+struct CompiledFunction {
+  std::string expression;
+  Tape function;
+  std::vector<Tape> derivatives;  // derivatives[i] = simplified d/dx_i
+};
+
+//! compiles f and its first `derivatives` partial derivatives
+CompiledFunction compile_function(const std::string& expression, const IScalarFunction& f, Index derivatives);
+
+void save_compiled(const std::string& filename, const std::vector<CompiledFunction>& functions);
+//! throws std::runtime_error if the file cannot be read or is not a valid compiled file
+std::vector<CompiledFunction> load_compiled(const std::string& filename);
+
+#endif  // LIBKRIGING_PARSER__COMPILEDFILE_HPP
@@ -0,0 +1,138 @@
+#include "ExpressionArena.hpp"
+
+#include <cstdint>
+#include <new>
+
+namespace {
+thread_local ExpressionArena* current_arena = nullptr;
+
+// every node is preceded by the arena it lives in (nullptr for the heap)
+constexpr std::size_t header_size = ExpressionArena::node_header_size;
+static_assert(sizeof(ExpressionArena*) <= header_size);
+
+ExpressionArena*& header(void* node) {
+  return *reinterpret_cast<ExpressionArena**>(static_cast<std::byte*>(node) - header_size);
+}
+
+// non-owning handle on a node kept alive by its arena
+template <typename T>
+std::shared_ptr<const T> borrow(const T* f) {
+  return std::shared_ptr<const T>(std::shared_ptr<const T>(), f);
+}
+}  // namespace
+
+ExpressionArena::Scope::Scope(ExpressionArena& arena) : m_previous(current_arena) {
+  current_arena = &arena;
+}
+
+ExpressionArena::Scope::~Scope() {
+  current_arena = m_previous;
+}
+
+ExpressionArena::ExpressionArena(const std::size_t initial_size)
+    : m_resource(*this, initial_size), m_nodes(&m_resource) {}
+
+ExpressionArena::~ExpressionArena() {
+  // arena memory is released by the region: destructors only drop the links to heap nodes
+  for (auto& [hash, node] : m_nodes) {
+    if (owner(*node) == this)
+      node->~IFunction();
+  }
+  m_nodes.clear();
+  m_external.clear();
+}
+
+void* ExpressionArena::CountingResource::do_allocate(const std::size_t bytes, const std::size_t alignment) {
+  m_arena.m_allocated_bytes += bytes;
+  return m_region.allocate(bytes, alignment);
+}
+
+ExpressionArena* ExpressionArena::current() {
+  return current_arena;
+}
+
+std::pmr::memory_resource* ExpressionArena::current_resource() {
+  return (current_arena) ? &current_arena->m_resource : std::pmr::get_default_resource();
+}
+
+ExpressionArena* ExpressionArena::owner(const IFunction& f) {
+  return header(const_cast<void*>(dynamic_cast<const void*>(&f)));
+}
+
+void* ExpressionArena::allocate_node(const std::size_t size) {
+  std::byte* p;
+  if (current_arena) {
+    p = static_cast<std::byte*>(current_arena->m_resource.allocate(header_size + size, header_size));
+    ++current_arena->m_node_count;
+  } else {
+    p = static_cast<std::byte*>(::operator new(header_size + size));
+  }
+  void* node = p + header_size;
+  header(node) = current_arena;
+  return node;
+}
+
+void ExpressionArena::deallocate_node(void* p) {
+  if (p && !header(p))
+    ::operator delete(static_cast<std::byte*>(p) - header_size);
+  // arena memory is released with the whole arena
+}
+
+const IFunction* ExpressionArena::find(const NodeKey& key, const std::size_t hash) const {
+  auto [it, last] = m_nodes.equal_range(hash);
+  for (; it != last; ++it) {
+    if (it->second->key() == key)
+      return it->second;
+  }
+  return nullptr;
+}
+
+template <typename T>
+std::shared_ptr<const T> ExpressionArena::intern_new(std::unique_ptr<T> f) {
+  if (!f)
+    return nullptr;
+  if (owner(*f) != this)  // built outside of this arena
+    return intern_shared(std::shared_ptr<const T>(std::move(f)));
+  const NodeKey key = f->key();
+  const std::size_t hash = key.hash();
+  if (const IFunction* node = find(key, hash))
+    return borrow(static_cast<const T*>(node));  // same key implies same dynamic type; f is dropped
+  const T* node = f.release();
+  node->m_interned = true;
+  m_nodes.emplace(hash, node);
+  return borrow(node);
+}
+
+template <typename T>
+std::shared_ptr<const T> ExpressionArena::intern_shared(std::shared_ptr<const T> f) {
+  if (!f)
+    return f;
+  if (owner(*f) == this) {
+    if (f->m_interned)
+      return f;
+    return intern_new(std::unique_ptr<T>(f->clone()));  // shallow copy owned by the arena
+  }
+  const NodeKey key = f->key();
+  const std::size_t hash = key.hash();
+  if (const IFunction* node = find(key, hash))
+    return borrow(static_cast<const T*>(node));
+  m_nodes.emplace(hash, f.get());
+  m_external.push_back(f);
+  return f;
+}
+
+ScalarFunctionPtr ExpressionArena::intern(std::unique_ptr<IScalarFunction> f) {
+  return intern_new(std::move(f));
+}
+
+ScalarFunctionPtr ExpressionArena::intern(ScalarFunctionPtr f) {
+  return intern_shared(std::move(f));
+}
+
+VectorFunctionPtr ExpressionArena::intern(std::unique_ptr<IVectorFunction> f) {
+  return intern_new(std::move(f));
+}
+
+VectorFunctionPtr ExpressionArena::intern(VectorFunctionPtr f) {
+  return intern_shared(std::move(f));
+}
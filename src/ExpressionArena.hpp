@@ -0,0 +1,93 @@
+#ifndef LIBKRIGING_PARSER__EXPRESSIONARENA_HPP
+#define LIBKRIGING_PARSER__EXPRESSIONARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "ASTNode.hpp"
+
+// Region allocator for expression nodes.
+// While an ExpressionArena::Scope is active on a thread, every node created by build_function, diff, simplify or
+// clone on that thread is carved out of one contiguous region, and hash-consed in a table local to the arena
+// (instead of the global one). Destroying the arena releases all of its nodes at once.
+//
+// Children are shared inside the arena without reference counting: the arena must outlive every function built
+// in it or derived from such a function (including heap functions derived outside the scope).
+// An arena is not thread-safe; use one arena per thread.
+
+class ExpressionArena {
+ public:
+  //! makes arena the current one on this thread until the end of the scope
+  class Scope {
+   public:
+    explicit Scope(ExpressionArena& arena);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    ExpressionArena* m_previous;
+  };
+
+ public:
+  explicit ExpressionArena(std::size_t initial_size = 4096);
+  ~ExpressionArena();
+  ExpressionArena(const ExpressionArena&) = delete;
+  ExpressionArena& operator=(const ExpressionArena&) = delete;
+
+  //! nodes allocated in the arena (including nodes merged by hash-consing)
+  [[nodiscard]] std::size_t node_count() const { return m_node_count; }
+  //! bytes requested from the region (nodes and their strings)
+  [[nodiscard]] std::size_t allocated_bytes() const { return m_allocated_bytes; }
+
+  //! arena of the active scope on this thread, nullptr if none
+  static ExpressionArena* current();
+  //! memory resource for node data: the current arena if any, the default resource otherwise
+  static std::pmr::memory_resource* current_resource();
+  //! arena holding f, nullptr for heap nodes
+  static ExpressionArena* owner(const IFunction& f);
+
+  // storage of IFunction nodes, each preceded by a header of node_header_size bytes
+  static constexpr std::size_t node_header_size = alignof(std::max_align_t);
+  static void* allocate_node(std::size_t size);
+  static void deallocate_node(void* p);
+
+  // hash-consing inside the arena (see intern() in ASTNode.hpp)
+  ScalarFunctionPtr intern(std::unique_ptr<IScalarFunction> f);
+  ScalarFunctionPtr intern(ScalarFunctionPtr f);
+  VectorFunctionPtr intern(std::unique_ptr<IVectorFunction> f);
+  VectorFunctionPtr intern(VectorFunctionPtr f);
+
+ private:
+  class CountingResource : public std::pmr::memory_resource {
+   public:
+    explicit CountingResource(ExpressionArena& arena, std::size_t initial_size)
+        : m_arena(arena), m_region(initial_size) {}
+
+   private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    [[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+
+    ExpressionArena& m_arena;
+    std::pmr::monotonic_buffer_resource m_region;
+  };
+
+  template <typename T>
+  std::shared_ptr<const T> intern_new(std::unique_ptr<T> f);
+  template <typename T>
+  std::shared_ptr<const T> intern_shared(std::shared_ptr<const T> f);
+  const IFunction* find(const NodeKey& key, std::size_t hash) const;
+
+ private:
+  CountingResource m_resource;
+  std::pmr::unordered_multimap<std::size_t, const IFunction*> m_nodes;  // interned nodes, destroyed with the arena
+  std::vector<std::shared_ptr<const IFunction>> m_external;              // heap nodes referenced by arena nodes
+  std::size_t m_node_count = 0;
+  std::size_t m_allocated_bytes = 0;
+};
+
+#endif  // LIBKRIGING_PARSER__EXPRESSIONARENA_HPP
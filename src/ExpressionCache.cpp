@@ -0,0 +1,110 @@
+#include "ExpressionCache.hpp"
+
+#include <cctype>
+#include <tao/pegtl/string_input.hpp>
+
+#include "grammar.hpp"
+
+namespace {
+bool is_word(const char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+// expression is parsed as written (error positions refer to it), key is its normalized form
+std::shared_ptr<const ExpressionCache::Entry> build_entry(const std::string& key,
+                                                          const std::string& expression,
+                                                          const std::size_t derivatives,
+                                                          const ExpressionCache::Entry* previous) {
+  auto entry = std::make_shared<ExpressionCache::Entry>();
+  entry->expression = key;
+  if (previous) {
+    entry->function = previous->function;
+    entry->derivatives = previous->derivatives;
+  } else {
+    tao::TAO_PEGTL_NAMESPACE::string_input in(expression, "cached expression");
+    entry->function = intern(parse_function(in));
+  }
+  if (entry->derivatives.size() < derivatives) {
+    const std::vector<ScalarFunctionPtr> added =
+        partial_derivatives(*entry->function, entry->derivatives.size(), derivatives, DiffOptions{true});
+    entry->derivatives.insert(entry->derivatives.end(), added.begin(), added.end());
+  }
+  return entry;
+}
+}  // namespace
+
+ExpressionCache::ExpressionCache(const std::size_t capacity) : m_capacity(capacity) {
+  if (m_capacity == 0)
+    throw std::invalid_argument("ExpressionCache capacity must be positive");
+}
+
+std::shared_ptr<const ExpressionCache::Entry> ExpressionCache::get(const std::string& expression,
+                                                                   const std::size_t derivatives) {
+  const std::string key = normalize(expression);
+  std::shared_ptr<const Entry> previous;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto found = m_index.find(key); found != m_index.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, found->second);
+      if (m_lru.front()->derivatives.size() >= derivatives) {
+        ++m_statistics.hits;
+        return m_lru.front();
+      }
+      previous = m_lru.front();  // missing derivatives: extend this entry
+    }
+    ++m_statistics.misses;
+  }
+
+  // built without holding the lock; concurrent misses on the same key may build it twice
+  std::shared_ptr<const Entry> entry = build_entry(key, expression, derivatives, previous.get());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (auto found = m_index.find(key); found != m_index.end()) {
+    if ((*found->second)->derivatives.size() < entry->derivatives.size())
+      *found->second = entry;
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    return entry;
+  }
+  m_lru.push_front(entry);
+  m_index.emplace(key, m_lru.begin());
+  while (m_lru.size() > m_capacity) {
+    m_index.erase(m_lru.back()->expression);
+    m_lru.pop_back();
+    ++m_statistics.evictions;
+  }
+  return entry;
+}
+
+auto ExpressionCache::statistics() const -> Statistics {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_statistics;
+}
+
+std::size_t ExpressionCache::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_lru.size();
+}
+
+void ExpressionCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_index.clear();
+  m_lru.clear();
+  m_statistics = Statistics{};
+}
+
+std::string ExpressionCache::normalize(const std::string& expression) {
+  std::string normalized;
+  normalized.reserve(expression.size());
+  bool blank = false;
+  for (const char c : expression) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      blank = true;
+      continue;
+    }
+    if (blank && !normalized.empty() && is_word(normalized.back()) && is_word(c))
+      normalized += ' ';
+    normalized += c;
+    blank = false;
+  }
+  return normalized;
+}
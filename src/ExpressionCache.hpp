@@ -0,0 +1,55 @@
+#ifndef LIBKRIGING_PARSER__EXPRESSIONCACHE_HPP
+#define LIBKRIGING_PARSER__EXPRESSIONCACHE_HPP
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ASTNode.hpp"
+
+// Thread-safe bounded LRU cache: normalized expression text -> built function and its partial derivatives.
+// Entries are immutable and shared: they remain valid after eviction for as long as they are held.
+
+class ExpressionCache {
+ public:
+  struct Entry {
+    std::string expression;  // normalized text
+    ScalarFunctionPtr function;
+    std::vector<ScalarFunctionPtr> derivatives;  // derivatives[i] = simplified d/dx_i, for i < requested count
+  };
+
+  struct Statistics {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+  };
+
+ public:
+  explicit ExpressionCache(std::size_t capacity);
+
+  //! cached entry for expression holding at least `derivatives` partial derivatives (built on a miss).
+  //! Parse errors are propagated (with positions in expression as given) and nothing is cached.
+  std::shared_ptr<const Entry> get(const std::string& expression, std::size_t derivatives = 0);
+
+  [[nodiscard]] Statistics statistics() const;
+  [[nodiscard]] std::size_t size() const;
+  [[nodiscard]] std::size_t capacity() const { return m_capacity; }
+  //! removes every entry and resets the statistics
+  void clear();
+
+  //! cache key: expression without blanks (blanks between two word characters are kept as one space)
+  static std::string normalize(const std::string& expression);
+
+ private:
+  using LRUList = std::list<std::shared_ptr<const Entry>>;  // most recently used first
+
+  const std::size_t m_capacity;
+  mutable std::mutex m_mutex;
+  LRUList m_lru;
+  std::unordered_map<std::string, LRUList::iterator> m_index;
+  Statistics m_statistics;
+};
+
+#endif  // LIBKRIGING_PARSER__EXPRESSIONCACHE_HPP
@@ -0,0 +1,76 @@
+#include "Hessian.hpp"
+
+#include <algorithm>
+
+namespace {
+//! coordinates below dimension listed by dependencies, from first on
+std::vector<Index> coordinates(const Dependencies& dependencies, const Index first, const Index dimension) {
+  std::vector<Index> result;
+  if (dependencies.all) {
+    for (Index i = first; i < dimension; ++i)
+      result.push_back(i);
+  } else {
+    auto begin = std::lower_bound(dependencies.indices.begin(), dependencies.indices.end(), first);
+    auto end = std::lower_bound(begin, dependencies.indices.end(), dimension);
+    result.assign(begin, end);
+  }
+  return result;
+}
+
+//! e_j for each j of columns, in the storage of directions (O(dimension) per column, only while evaluating a row)
+void seed(VectorBlock& directions, const Index dimension, const std::vector<Index>& columns) {
+  directions.dimension = dimension;
+  directions.count = columns.size();
+  directions.data.assign(dimension * columns.size(), Number{0});
+  for (Index p = 0; p < columns.size(); ++p) {
+    directions.component(columns[p])[p] = 1;
+  }
+}
+}  // namespace
+
+Hessian::Hessian(const IScalarFunction& f, const Index dimension) : m_dimension(dimension) {
+  std::vector<ScalarFunctionPtr> derivatives = partial_derivatives(f, 0, dimension, DiffOptions{true});
+  for (Index i = 0; i < dimension; ++i) {
+    ScalarFunctionPtr& derivative = derivatives[i];
+    const Dependencies derivative_variables = dependencies(*derivative);
+    if (derivative_variables.empty())
+      continue;  // constant first derivative: zero row
+
+    m_rows.push_back(Row{i, std::move(derivative), coordinates(derivative_variables, i, dimension)});
+  }
+}
+
+Index Hessian::nonzeros() const {
+  Index count = 0;
+  for (const Row& row : m_rows) {
+    count += row.columns.size();
+  }
+  return count;
+}
+
+auto Hessian::hessian(const Vector& x) const -> VectorBlock {
+  assert(x.size() == m_dimension);
+  VectorBlock result(m_dimension, m_dimension);
+  VectorBlock directions;  // seeds of the current row
+  for (const Row& row : m_rows) {
+    if (row.columns.empty())
+      continue;
+    seed(directions, m_dimension, row.columns);
+    const Tangents tangents = row.derivative->apply_tangents(x, directions);
+    for (Index p = 0; p < row.columns.size(); ++p) {
+      const Index j = row.columns[p];
+      result.component(row.index)[j] = tangents.derivatives[p];
+      result.component(j)[row.index] = tangents.derivatives[p];
+    }
+  }
+  return result;
+}
+
+auto Hessian::hvp(const Vector& x, const Vector& v) const -> Vector {
+  assert(x.size() == m_dimension && v.size() == m_dimension);
+  Vector result(m_dimension, Number{0});
+  for (const Row& row : m_rows) {
+    result[row.index] = row.derivative->apply_tangent(x, v).derivative;
+  }
+  return result;
+}
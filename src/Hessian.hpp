@@ -0,0 +1,39 @@
+#ifndef LIBKRIGING_PARSER__HESSIAN_HPP
+#define LIBKRIGING_PARSER__HESSIAN_HPP
+
+#include <vector>
+
+#include "ASTNode.hpp"
+
+// Second derivatives of a function in a fixed dimension.
+// First derivatives d_i f are built (and simplified) once by partial_derivatives, only along the coordinates f
+// depends on.
+// Row i of the Hessian is then the forward-mode derivative of d_i f along e_j, for the columns j >= i
+// d_i f depends on: all of these entries come from a single tangent pass over d_i f.
+// Entries outside of this structure are zero and never evaluated; the lower triangle is copied by symmetry.
+
+class Hessian {
+ public:
+  Hessian(const IScalarFunction& f, Index dimension);
+
+  [[nodiscard]] Index dimension() const { return m_dimension; }
+  //! number of structurally non zero entries of the upper triangle (diagonal included)
+  [[nodiscard]] Index nonzeros() const;
+
+  //! symmetric Hessian at x: component(i)[j] is the second derivative along x_i and x_j
+  [[nodiscard]] auto hessian(const Vector& x) const -> VectorBlock;
+  //! Hessian-vector product at x: one directional derivative of each non constant d_i f
+  [[nodiscard]] auto hvp(const Vector& x, const Vector& v) const -> Vector;
+
+ private:
+  struct Row {
+    Index index;                   // i
+    ScalarFunctionPtr derivative;  // d_i f, not constant
+    std::vector<Index> columns;    // j >= i such that d_i f depends on x_j
+  };
+
+  Index m_dimension;
+  std::vector<Row> m_rows;
+};
+
+#endif  // LIBKRIGING_PARSER__HESSIAN_HPP
@@ -0,0 +1,214 @@
+#include "IncrementalEvaluator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+//! same bits up to NaN payloads: +0 and -0 differ (1/x does), a NaN always counts as a change
+bool unchanged(const Number a, const Number b) {
+  return a == b && std::signbit(a) == std::signbit(b);
+}
+
+struct Read {  // register read by an instruction
+  bool vector;
+  std::uint32_t reg;
+};
+
+//! registers read by inst (at most two)
+std::vector<Read> reads(const Instruction& inst) {
+  switch (inst.op) {
+    case OpCode::Constant:
+    case OpCode::VectorZero:
+    case OpCode::VectorPartialOne:
+    case OpCode::SecondInput:
+      return {};
+    case OpCode::Add:
+    case OpCode::Sub:
+    case OpCode::Mul:
+    case OpCode::Div:
+      return {{false, inst.lhs}, {false, inst.rhs}};
+    case OpCode::Neg:
+    case OpCode::Exp:
+      return {{false, inst.lhs}};
+    case OpCode::Dot:
+    case OpCode::SquaredDistance:
+    case OpCode::VectorAdd:
+    case OpCode::VectorSub:
+      return {{true, inst.lhs}, {true, inst.rhs}};
+    case OpCode::Norm:
+    case OpCode::Component:
+    case OpCode::VectorNeg:
+      return {{true, inst.lhs}};
+    case OpCode::ScalarVectorProduct:
+      return {{false, inst.lhs}, {true, inst.rhs}};
+    case OpCode::VectorScalarDivide:
+      return {{true, inst.lhs}, {false, inst.rhs}};
+  }
+  return {};
+}
+
+//! instruction writing each register (registers are written once), -1 for x
+struct Producers {
+  explicit Producers(const Tape& tape)
+      : scalars(tape.scalar_registers(), none), vectors(tape.vector_registers(), none) {
+    const std::vector<Instruction>& instructions = tape.instructions();
+    for (std::size_t k = 0; k < instructions.size(); ++k) {
+      const Instruction& inst = instructions[k];
+      ((is_vector_op(inst.op)) ? vectors : scalars)[inst.result] = static_cast<std::uint32_t>(k);
+    }
+  }
+  [[nodiscard]] std::uint32_t of(const Read& read) const {
+    return ((read.vector) ? vectors : scalars)[read.reg];
+  }
+
+  static constexpr std::uint32_t none = static_cast<std::uint32_t>(-1);
+  std::vector<std::uint32_t> scalars;
+  std::vector<std::uint32_t> vectors;
+};
+}  // namespace
+
+IncrementalEvaluator::IncrementalEvaluator(const IScalarFunction& f) : m_tape(compile(f)) {
+  // consumers of each instruction (compressed rows: one entry per operand, O(instructions) in all)
+  const std::vector<Instruction>& instructions = m_tape.instructions();
+  const Producers producers(m_tape);
+  m_consumer_offsets.assign(instructions.size() + 1, 0);
+  for (const Instruction& inst : instructions) {
+    for (const Read& read : reads(inst)) {
+      if (const std::uint32_t producer = producers.of(read); producer != Producers::none)
+        ++m_consumer_offsets[producer + 1];
+    }
+  }
+  for (std::size_t k = 0; k < instructions.size(); ++k) {
+    m_consumer_offsets[k + 1] += m_consumer_offsets[k];
+  }
+  m_consumers.resize(m_consumer_offsets.back());
+  std::vector<std::uint32_t> filled(m_consumer_offsets.begin(), m_consumer_offsets.end() - 1);
+  for (std::size_t k = 0; k < instructions.size(); ++k) {
+    const Instruction& inst = instructions[k];
+    const auto instruction = static_cast<std::uint32_t>(k);
+    for (const Read& read : reads(inst)) {
+      if (const std::uint32_t producer = producers.of(read); producer != Producers::none) {
+        m_consumers[filled[producer]++] = instruction;
+      } else if (inst.op == OpCode::Component) {
+        m_components[inst.rhs].push_back(instruction);  // x_i
+      } else {
+        m_dense.push_back(instruction);  // x as a whole
+      }
+    }
+  }
+  m_dirty.assign(instructions.size(), false);
+}
+
+auto IncrementalEvaluator::dependencies(const std::size_t instruction) const -> Dependencies {
+  const std::vector<Instruction>& instructions = m_tape.instructions();
+  const Producers producers(m_tape);
+  Dependencies result;
+  std::vector<bool> visited(instructions.size(), false);
+  std::vector<std::uint32_t> stack{static_cast<std::uint32_t>(instruction)};
+  visited[instruction] = true;
+  while (!stack.empty() && !result.all) {
+    const Instruction& inst = instructions[stack.back()];
+    stack.pop_back();
+    for (const Read& read : reads(inst)) {
+      const std::uint32_t producer = producers.of(read);
+      if (producer == Producers::none) {
+        if (inst.op == OpCode::Component) {
+          result.indices.push_back(inst.rhs);
+        } else {
+          result.all = true;
+        }
+      } else if (!visited[producer]) {
+        visited[producer] = true;
+        stack.push_back(producer);
+      }
+    }
+  }
+  if (result.all) {
+    result.indices.clear();
+  } else {
+    std::sort(result.indices.begin(), result.indices.end());
+    result.indices.erase(std::unique(result.indices.begin(), result.indices.end()), result.indices.end());
+  }
+  return result;
+}
+
+auto IncrementalEvaluator::apply(const Vector& x) -> Number {
+  m_x = x;
+  m_applied = true;
+  m_value = m_tape.apply(m_x, m_workspace);
+  m_recomputed = m_tape.instructions().size();
+  return m_value;
+}
+
+void IncrementalEvaluator::check_index(const Index i) const {
+  if (i >= m_x.size())
+    throw std::out_of_range("IncrementalEvaluator: x_" + std::to_string(i) + " is out of the current point");
+}
+
+bool IncrementalEvaluator::set(const Index i, const Number value) {
+  if (unchanged(m_x[i], value))
+    return false;
+  m_x[i] = value;
+  if (auto found = m_components.find(i); found != m_components.end())
+    m_selected.insert(m_selected.end(), found->second.begin(), found->second.end());
+  return true;
+}
+
+void IncrementalEvaluator::check_applied() const {
+  if (!m_applied)
+    throw std::logic_error("IncrementalEvaluator: update before the first apply");
+}
+
+auto IncrementalEvaluator::evaluate(const bool changed) -> Number {
+  if (changed)
+    m_selected.insert(m_selected.end(), m_dense.begin(), m_dense.end());
+  // the instructions reading a changed coordinate, then everything reachable through consumers
+  std::size_t roots = 0;
+  for (const std::uint32_t k : m_selected) {
+    if (!m_dirty[k]) {
+      m_dirty[k] = true;
+      m_selected[roots++] = k;
+    }
+  }
+  m_selected.resize(roots);
+  for (std::size_t p = 0; p < m_selected.size(); ++p) {
+    const std::uint32_t k = m_selected[p];
+    for (std::uint32_t c = m_consumer_offsets[k]; c < m_consumer_offsets[k + 1]; ++c) {
+      if (const std::uint32_t consumer = m_consumers[c]; !m_dirty[consumer]) {
+        m_dirty[consumer] = true;
+        m_selected.push_back(consumer);
+      }
+    }
+  }
+  std::sort(m_selected.begin(), m_selected.end());
+
+  m_value = m_tape.apply_partial(m_x, m_workspace, m_selected);
+  m_recomputed = m_selected.size();
+  for (const std::uint32_t k : m_selected) {
+    m_dirty[k] = false;
+  }
+  m_selected.clear();
+  return m_value;
+}
+
+auto IncrementalEvaluator::update(const Index i, const Number value) -> Number {
+  check_applied();
+  check_index(i);
+  return evaluate(set(i, value));
+}
+
+auto IncrementalEvaluator::update(const std::vector<Index>& indices, const Vector& values) -> Number {
+  check_applied();
+  if (indices.size() != values.size())
+    throw std::invalid_argument("IncrementalEvaluator: as many values as indices are required");
+  for (const Index i : indices) {
+    check_index(i);  // before changing any coordinate: a failed update leaves the evaluator as it was
+  }
+  bool changed = false;
+  for (std::size_t k = 0; k < indices.size(); ++k) {
+    changed = set(indices[k], values[k]) || changed;
+  }
+  return evaluate(changed);
+}
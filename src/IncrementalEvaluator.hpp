@@ -0,0 +1,62 @@
+#ifndef LIBKRIGING_PARSER__INCREMENTALEVALUATOR_HPP
+#define LIBKRIGING_PARSER__INCREMENTALEVALUATOR_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "Tape.hpp"
+
+// Evaluation of a function at a point changing a few coordinates at a time (coordinate descent, Gibbs sampling).
+// The function is compiled once, with the consumers of each instruction of its tape (one node of the function):
+// O(instructions) in all. Registers of the last evaluation are kept, and an update only runs the instructions
+// reachable from a changed coordinate: those reading x_i through a component, those reading x as a vector, then
+// their consumers. Results are identical to a full evaluation (a coordinate changes unless its bits are kept:
+// setting -0 over +0 or a NaN over a NaN is a change).
+
+class IncrementalEvaluator {
+ public:
+  explicit IncrementalEvaluator(const IScalarFunction& f);
+
+  //! full evaluation; x becomes the current point
+  auto apply(const Vector& x) -> Number;
+  //! sets x_i = value in the current point, then evaluates incrementally (apply must have given the point)
+  auto update(Index i, Number value) -> Number;
+  //! sets x_indices[k] = values[k] in the current point, then evaluates incrementally
+  auto update(const std::vector<Index>& indices, const Vector& values) -> Number;
+
+  [[nodiscard]] const Vector& point() const { return m_x; }
+  [[nodiscard]] Number value() const { return m_value; }
+  [[nodiscard]] const Tape& tape() const { return m_tape; }
+  //! instructions (nodes) run by the last evaluation
+  [[nodiscard]] Index recomputed() const { return m_recomputed; }
+  //! coordinates an instruction depends on, found by walking back its operands (O(instructions), for inspection)
+  [[nodiscard]] auto dependencies(std::size_t instruction) const -> Dependencies;
+
+ private:
+  //! throws std::logic_error if there is no current point yet
+  void check_applied() const;
+  //! throws std::out_of_range if x_i is not a coordinate of the current point
+  void check_index(Index i) const;
+  //! sets x_i = value (i checked); if it changes, selects the instructions depending on x_i
+  bool set(Index i, Number value);
+  //! runs the selected instructions (and those depending on all coordinates if changed)
+  auto evaluate(bool changed) -> Number;
+
+ private:
+  Tape m_tape;
+  std::vector<std::uint32_t> m_consumer_offsets;  // consumers of k: m_consumers[offsets[k], offsets[k + 1])
+  std::vector<std::uint32_t> m_consumers;
+  std::vector<std::uint32_t> m_dense;                                  // instructions reading x as a vector
+  std::unordered_map<Index, std::vector<std::uint32_t>> m_components;  // instructions reading x_i
+  std::vector<bool> m_dirty;                                           // selected for the current update
+  Tape::Workspace m_workspace;
+  Vector m_x;
+  bool m_applied = false;
+  Number m_value = 0;
+  Index m_recomputed = 0;
+  std::vector<std::uint32_t> m_selected;  // instructions to run (capacity reused between updates)
+};
+
+#endif  // LIBKRIGING_PARSER__INCREMENTALEVALUATOR_HPP
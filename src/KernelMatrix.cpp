@@ -0,0 +1,79 @@
+#include "KernelMatrix.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+//! one contiguous vector per point of block
+std::vector<Vector> points_of(const VectorBlock& block) {
+  std::vector<Vector> points(block.count, Vector(block.dimension));
+  for (Index i = 0; i < block.dimension; ++i) {
+    const Number* component = block.component(i);
+    for (Index p = 0; p < block.count; ++p) {
+      points[p][i] = component[p];
+    }
+  }
+  return points;
+}
+}  // namespace
+
+KernelMatrix::KernelMatrix(const IScalarFunction& k, ThreadPool& pool, const Index tile)
+    : m_tape(::compile(k)), m_pool(pool), m_tile(tile) {
+  if (m_tile == 0)
+    throw std::invalid_argument("KernelMatrix tile must be positive");
+}
+
+VectorBlock KernelMatrix::build(const VectorBlock& x, const VectorBlock& y) const {
+  if (x.dimension != y.dimension)
+    throw std::invalid_argument("x and y points have different dimensions");
+  const std::vector<Vector> xs = points_of(x);
+  const std::vector<Vector> ys = points_of(y);
+  VectorBlock result(x.count, y.count);
+
+  const Index columns = (y.count + m_tile - 1) / m_tile;
+  const Index tiles = ((x.count + m_tile - 1) / m_tile) * columns;
+  m_pool.parallel_for(0, tiles, 1, [&](const Index begin, const Index end) {
+    Tape::Workspace workspace;
+    for (Index t = begin; t < end; ++t) {
+      const Index p0 = (t / columns) * m_tile, p1 = std::min(p0 + m_tile, x.count);
+      const Index q0 = (t % columns) * m_tile, q1 = std::min(q0 + m_tile, y.count);
+      for (Index p = p0; p < p1; ++p) {
+        Number* row = result.component(p);
+        for (Index q = q0; q < q1; ++q) {
+          row[q] = m_tape.apply(xs[p], ys[q], workspace);
+        }
+      }
+    }
+  });
+  return result;
+}
+
+VectorBlock KernelMatrix::build(const VectorBlock& x) const {
+  const std::vector<Vector> xs = points_of(x);
+  VectorBlock result(x.count, x.count);
+
+  const Index blocks = (x.count + m_tile - 1) / m_tile;
+  std::vector<std::pair<Index, Index>> tiles;  // (row block, column block) on and above the diagonal
+  tiles.reserve(blocks * (blocks + 1) / 2);
+  for (Index a = 0; a < blocks; ++a) {
+    for (Index b = a; b < blocks; ++b) {
+      tiles.emplace_back(a, b);
+    }
+  }
+  m_pool.parallel_for(0, tiles.size(), 1, [&](const Index begin, const Index end) {
+    Tape::Workspace workspace;
+    for (Index t = begin; t < end; ++t) {
+      const Index p0 = tiles[t].first * m_tile, p1 = std::min(p0 + m_tile, x.count);
+      const Index q0 = tiles[t].second * m_tile, q1 = std::min(q0 + m_tile, x.count);
+      for (Index p = p0; p < p1; ++p) {
+        Number* row = result.component(p);
+        for (Index q = std::max(q0, p); q < q1; ++q) {
+          row[q] = m_tape.apply(xs[p], xs[q], workspace);
+          result.component(q)[p] = row[q];  // the mirrored tile is never evaluated
+        }
+      }
+    }
+  });
+  return result;
+}
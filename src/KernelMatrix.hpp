@@ -0,0 +1,31 @@
+#ifndef LIBKRIGING_PARSER__KERNELMATRIX_HPP
+#define LIBKRIGING_PARSER__KERNELMATRIX_HPP
+
+#include "ASTNode.hpp"
+#include "Tape.hpp"
+#include "ThreadPool.hpp"
+
+// Covariance matrices: a kernel k(x, y) evaluated by its tape over all pairs of two point sets.
+// The matrix is split into square tiles of `tile` rows and columns, run in parallel on a ThreadPool with one
+// workspace per tile: the 2 * tile points of a tile stay in cache while its tile^2 entries are evaluated.
+// For a single point set (K(p, q) = k(x_p, x_q)), k is taken symmetric, as a covariance is: only the tiles on and
+// above the diagonal are evaluated, and each entry is written at (p, q) and (q, p).
+//
+// The result is a VectorBlock of dimension rows and count columns: component(p)[q] is K(p, q).
+
+class KernelMatrix {
+ public:
+  KernelMatrix(const IScalarFunction& k, ThreadPool& pool, Index tile = 64);
+
+  //! K(p, q) = k(x_p, y_q) for the points of x and y (blocks of the same dimension)
+  [[nodiscard]] VectorBlock build(const VectorBlock& x, const VectorBlock& y) const;
+  //! K(p, q) = k(x_p, x_q), for a symmetric k
+  [[nodiscard]] VectorBlock build(const VectorBlock& x) const;
+
+ private:
+  Tape m_tape;
+  ThreadPool& m_pool;
+  Index m_tile;
+};
+
+#endif  // LIBKRIGING_PARSER__KERNELMATRIX_HPP
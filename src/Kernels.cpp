@@ -0,0 +1,185 @@
+#include "Kernels.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "KernelsImpl.hpp"
+
+static_assert(std::is_same_v<Number, double>, "kernels are written for double precision");
+
+namespace {
+struct Scalar {
+  using type = double;
+  static constexpr std::size_t width = 1;
+  static type load(const double* p) { return *p; }
+  static void store(double* p, type a) { *p = a; }
+  static type set1(double s) { return s; }
+  static type zero() { return 0; }
+  static type add(type a, type b) { return a + b; }
+  static type sub(type a, type b) { return a - b; }
+  static type mul(type a, type b) { return a * b; }
+  static type div(type a, type b) { return a / b; }
+  static type fmadd(type a, type b, type c) { return a * b + c; }
+  static double hsum(type a) { return a; }
+};
+
+const kernels::detail::KernelTable& table_of(const kernels::InstructionSet isa) {
+  switch (isa) {
+#ifdef LIBKRIGING_PARSER_X86_KERNELS
+    case kernels::InstructionSet::SSE2:
+      return kernels::detail::sse2_kernels();
+    case kernels::InstructionSet::AVX2:
+      return kernels::detail::avx2_kernels();
+    case kernels::InstructionSet::AVX512:
+      return kernels::detail::avx512_kernels();
+#endif
+    default:
+      return kernels::detail::scalar_kernels();
+  }
+}
+
+kernels::InstructionSet best_instruction_set() {
+  for (auto isa : {kernels::InstructionSet::AVX512, kernels::InstructionSet::AVX2, kernels::InstructionSet::SSE2}) {
+    if (kernels::is_supported(isa))
+      return isa;
+  }
+  return kernels::InstructionSet::Scalar;
+}
+
+struct Dispatch {
+  std::atomic<kernels::InstructionSet> isa{best_instruction_set()};
+  std::atomic<const kernels::detail::KernelTable*> table{&table_of(isa)};
+  std::atomic<kernels::ReductionMode> mode{kernels::ReductionMode::Exact};
+};
+
+Dispatch& dispatch() {
+  static Dispatch instance;
+  return instance;
+}
+
+const kernels::detail::KernelTable& current() {
+  return *dispatch().table.load(std::memory_order_relaxed);
+}
+}  // namespace
+
+const kernels::detail::KernelTable& kernels::detail::scalar_kernels() {
+  return GenericKernels<Scalar>::table();
+}
+
+const char* kernels::instruction_set_name(const InstructionSet isa) {
+  switch (isa) {
+    case InstructionSet::Scalar:
+      return "scalar";
+    case InstructionSet::SSE2:
+      return "sse2";
+    case InstructionSet::AVX2:
+      return "avx2";
+    case InstructionSet::AVX512:
+      return "avx512";
+  }
+  return "?";
+}
+
+bool kernels::is_supported(const InstructionSet isa) {
+  switch (isa) {
+    case InstructionSet::Scalar:
+      return true;
+#ifdef LIBKRIGING_PARSER_X86_KERNELS
+    case InstructionSet::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case InstructionSet::AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case InstructionSet::AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+kernels::InstructionSet kernels::instruction_set() {
+  return dispatch().isa.load();
+}
+
+void kernels::set_instruction_set(const InstructionSet isa) {
+  if (!is_supported(isa))
+    throw std::invalid_argument(std::string{"instruction set "} + instruction_set_name(isa) + " is not supported");
+  dispatch().isa = isa;
+  dispatch().table = &table_of(isa);
+}
+
+kernels::ReductionMode kernels::reduction_mode() {
+  return dispatch().mode.load(std::memory_order_relaxed);
+}
+
+void kernels::set_reduction_mode(const ReductionMode mode) {
+  dispatch().mode = mode;
+}
+
+void kernels::add(Number* r, const Number* a, const Number* b, const std::size_t n) {
+  current().add(r, a, b, n);
+}
+
+void kernels::sub(Number* r, const Number* a, const Number* b, const std::size_t n) {
+  current().sub(r, a, b, n);
+}
+
+void kernels::multiply(Number* r, const Number* a, const Number* b, const std::size_t n) {
+  current().multiply(r, a, b, n);
+}
+
+void kernels::divide(Number* r, const Number* a, const Number* b, const std::size_t n) {
+  current().divide(r, a, b, n);
+}
+
+void kernels::negate(Number* r, const Number* a, const std::size_t n) {
+  current().negate(r, a, n);
+}
+
+void kernels::scale(Number* r, const Number* a, const Number s, const std::size_t n) {
+  current().scale(r, a, s, n);
+}
+
+void kernels::scale_divide(Number* r, const Number* a, const Number s, const std::size_t n) {
+  current().scale_divide(r, a, s, n);
+}
+
+void kernels::multiply_add(Number* r, const Number* a, const Number* b, const std::size_t n) {
+  current().multiply_add(r, a, b, n);
+}
+
+Number kernels::dot(const Number* a, const Number* b, const std::size_t n) {
+  if (reduction_mode() == ReductionMode::Reassociated)
+    return current().reassociated_dot(a, b, n);
+
+  Number result = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+Number kernels::squared_distance(const Number* a, const Number* b, const std::size_t n) {
+  if (reduction_mode() == ReductionMode::Reassociated)
+    return current().reassociated_squared_distance(a, b, n);
+
+  Number result = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const Number d = a[i] - b[i];
+    result += d * d;
+  }
+  return result;
+}
+
+Number kernels::dot_tolerance(const Number* a, const Number* b, const std::size_t n) {
+  const Number u = std::numeric_limits<Number>::epsilon() / 2;
+  const Number gamma = n * u / (1 - n * u);
+  Number sum = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    sum += std::abs(a[i] * b[i]);
+  }
+  return 2 * gamma * sum;
+}
@@ -0,0 +1,125 @@
+#ifndef LIBKRIGING_PARSER__KERNELS_HPP
+#define LIBKRIGING_PARSER__KERNELS_HPP
+
+#include <cstddef>
+#include <type_traits>
+
+#include "ASTNode.hpp"
+
+// Dense kernels used by vector nodes, batches and tapes.
+// The implementation is chosen at runtime from the instruction sets supported by the CPU
+// (AVX-512, AVX2, SSE2, or the portable scalar code).
+//
+// Element-wise kernels give exactly the same results whatever the instruction set.
+// Reductions (dot, squared_distance) depend on the reduction mode:
+//  - ReductionMode::Exact (default) sums sequentially, as a plain loop would: results are reproducible
+//    and can be compared with ==.
+//  - ReductionMode::Reassociated sums in several SIMD accumulators (using FMA when available).
+//    It runs at memory bandwidth for large vectors, but the result may differ from the exact one:
+//    |dot_reassociated - dot_exact| <= dot_tolerance(a, b, n) = 2 * gamma(n) * sum |a_i * b_i|
+//    with gamma(n) = n * u / (1 - n * u) and u = 2^-53 the unit roundoff.
+//    Compare such results with this tolerance instead of ==.
+
+namespace kernels {
+
+enum class InstructionSet { Scalar, SSE2, AVX2, AVX512 };
+enum class ReductionMode { Exact, Reassociated };
+
+const char* instruction_set_name(InstructionSet isa);
+bool is_supported(InstructionSet isa);
+InstructionSet instruction_set();
+//! force an instruction set (for testing and benchmarking); it must be supported
+void set_instruction_set(InstructionSet isa);
+
+ReductionMode reduction_mode();
+void set_reduction_mode(ReductionMode mode);
+
+// r may alias any input
+void add(Number* r, const Number* a, const Number* b, std::size_t n);       // r = a + b
+void sub(Number* r, const Number* a, const Number* b, std::size_t n);       // r = a - b
+void multiply(Number* r, const Number* a, const Number* b, std::size_t n);  // r = a * b
+void divide(Number* r, const Number* a, const Number* b, std::size_t n);    // r = a / b
+void negate(Number* r, const Number* a, std::size_t n);                     // r = -a
+void scale(Number* r, const Number* a, Number s, std::size_t n);            // r = a * s
+void scale_divide(Number* r, const Number* a, Number s, std::size_t n);     // r = a / s
+//! r += a * b, rounded after the product and after the sum (never fused)
+void multiply_add(Number* r, const Number* a, const Number* b, std::size_t n);
+
+//! sum of a_i * b_i according to reduction_mode()
+Number dot(const Number* a, const Number* b, std::size_t n);
+//! sum of (a_i - b_i)^2 according to reduction_mode(), without storing a - b
+Number squared_distance(const Number* a, const Number* b, std::size_t n);
+//! bound of the difference between Reassociated and Exact dot results
+Number dot_tolerance(const Number* a, const Number* b, std::size_t n);
+
+// Portable kernels of the other floating point types (float, long double), left to the compiler vectorization.
+// Reassociated reductions sum in 8 partial sums, which the compiler maps to SIMD registers.
+template <typename T>
+using if_other_floating_point = std::enable_if_t<std::is_floating_point_v<T> && !std::is_same_v<T, Number>>;
+
+template <typename T, typename = if_other_floating_point<T>>
+void add(T* r, const T* a, const T* b, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = a[i] + b[i];
+}
+template <typename T, typename = if_other_floating_point<T>>
+void sub(T* r, const T* a, const T* b, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = a[i] - b[i];
+}
+template <typename T, typename = if_other_floating_point<T>>
+void negate(T* r, const T* a, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = -a[i];
+}
+template <typename T, typename = if_other_floating_point<T>>
+void scale(T* r, const T* a, T s, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = a[i] * s;
+}
+template <typename T, typename = if_other_floating_point<T>>
+void scale_divide(T* r, const T* a, T s, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = a[i] / s;
+}
+
+//! sum of term(i) for i < n according to reduction_mode()
+template <typename T, typename Term>
+T reduce(const Term& term, std::size_t n) {
+  if (reduction_mode() == ReductionMode::Exact) {
+    T result = 0;
+    for (std::size_t i = 0; i < n; ++i)
+      result += term(i);
+    return result;
+  }
+  constexpr std::size_t width = 8;
+  T partial[width] = {};
+  std::size_t i = 0;
+  for (; i + width <= n; i += width) {
+    for (std::size_t k = 0; k < width; ++k)
+      partial[k] += term(i + k);
+  }
+  for (; i < n; ++i)
+    partial[0] += term(i);
+  T result = 0;
+  for (std::size_t k = 0; k < width; ++k)
+    result += partial[k];
+  return result;
+}
+template <typename T, typename = if_other_floating_point<T>>
+T dot(const T* a, const T* b, std::size_t n) {
+  return reduce<T>([=](const std::size_t i) { return a[i] * b[i]; }, n);
+}
+template <typename T, typename = if_other_floating_point<T>>
+T squared_distance(const T* a, const T* b, std::size_t n) {
+  return reduce<T>(
+      [=](const std::size_t i) {
+        const T d = a[i] - b[i];
+        return d * d;
+      },
+      n);
+}
+
+}  // namespace kernels
+
+#endif  // LIBKRIGING_PARSER__KERNELS_HPP
@@ -0,0 +1,27 @@
+#include <immintrin.h>
+
+#include "KernelsImpl.hpp"
+
+namespace {
+struct Avx2 {
+  using type = __m256d;
+  static constexpr std::size_t width = 4;
+  static type load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, type a) { _mm256_storeu_pd(p, a); }
+  static type set1(double s) { return _mm256_set1_pd(s); }
+  static type zero() { return _mm256_setzero_pd(); }
+  static type add(type a, type b) { return _mm256_add_pd(a, b); }
+  static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+  static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+  static type div(type a, type b) { return _mm256_div_pd(a, b); }
+  static type fmadd(type a, type b, type c) { return _mm256_fmadd_pd(a, b, c); }
+  static double hsum(type a) {
+    const __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  }
+};
+}  // namespace
+
+const kernels::detail::KernelTable& kernels::detail::avx2_kernels() {
+  return GenericKernels<Avx2>::table();
+}
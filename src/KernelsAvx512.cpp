@@ -0,0 +1,24 @@
+#include <immintrin.h>
+
+#include "KernelsImpl.hpp"
+
+namespace {
+struct Avx512 {
+  using type = __m512d;
+  static constexpr std::size_t width = 8;
+  static type load(const double* p) { return _mm512_loadu_pd(p); }
+  static void store(double* p, type a) { _mm512_storeu_pd(p, a); }
+  static type set1(double s) { return _mm512_set1_pd(s); }
+  static type zero() { return _mm512_setzero_pd(); }
+  static type add(type a, type b) { return _mm512_add_pd(a, b); }
+  static type sub(type a, type b) { return _mm512_sub_pd(a, b); }
+  static type mul(type a, type b) { return _mm512_mul_pd(a, b); }
+  static type div(type a, type b) { return _mm512_div_pd(a, b); }
+  static type fmadd(type a, type b, type c) { return _mm512_fmadd_pd(a, b, c); }
+  static double hsum(type a) { return _mm512_reduce_add_pd(a); }
+};
+}  // namespace
+
+const kernels::detail::KernelTable& kernels::detail::avx512_kernels() {
+  return GenericKernels<Avx512>::table();
+}
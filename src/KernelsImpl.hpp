@@ -0,0 +1,148 @@
+#ifndef LIBKRIGING_PARSER__KERNELSIMPL_HPP
+#define LIBKRIGING_PARSER__KERNELSIMPL_HPP
+
+// Generic SIMD kernels, instantiated once per instruction set in KernelsXXX.cpp.
+// Those translation units are compiled with instruction set specific flags: they must not include any
+// header defining inline functions shared with the rest of the library (like ASTNode.hpp or the STL
+// containers), otherwise the linker could keep a version using unsupported instructions.
+
+#include <cstddef>
+
+namespace kernels::detail {
+
+struct KernelTable {
+  void (*add)(double* r, const double* a, const double* b, std::size_t n);
+  void (*sub)(double* r, const double* a, const double* b, std::size_t n);
+  void (*multiply)(double* r, const double* a, const double* b, std::size_t n);
+  void (*divide)(double* r, const double* a, const double* b, std::size_t n);
+  void (*negate)(double* r, const double* a, std::size_t n);
+  void (*scale)(double* r, const double* a, double s, std::size_t n);
+  void (*scale_divide)(double* r, const double* a, double s, std::size_t n);
+  void (*multiply_add)(double* r, const double* a, const double* b, std::size_t n);
+  double (*reassociated_dot)(const double* a, const double* b, std::size_t n);
+  double (*reassociated_squared_distance)(const double* a, const double* b, std::size_t n);
+};
+
+const KernelTable& scalar_kernels();
+const KernelTable& sse2_kernels();
+const KernelTable& avx2_kernels();
+const KernelTable& avx512_kernels();
+
+// Simd must provide: type, width, load, store, set1, zero, add, sub, mul, div, fmadd (a*b+c), hsum
+template <typename Simd>
+struct GenericKernels {
+  static constexpr std::size_t W = Simd::width;
+
+  static void add(double* r, const double* a, const double* b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::add(Simd::load(a + i), Simd::load(b + i)));
+    for (; i < n; ++i)
+      r[i] = a[i] + b[i];
+  }
+  static void sub(double* r, const double* a, const double* b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::sub(Simd::load(a + i), Simd::load(b + i)));
+    for (; i < n; ++i)
+      r[i] = a[i] - b[i];
+  }
+  static void multiply(double* r, const double* a, const double* b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::mul(Simd::load(a + i), Simd::load(b + i)));
+    for (; i < n; ++i)
+      r[i] = a[i] * b[i];
+  }
+  static void divide(double* r, const double* a, const double* b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::div(Simd::load(a + i), Simd::load(b + i)));
+    for (; i < n; ++i)
+      r[i] = a[i] / b[i];
+  }
+  static void negate(double* r, const double* a, std::size_t n) {
+    const typename Simd::type m = Simd::set1(-1);
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::mul(Simd::load(a + i), m));
+    for (; i < n; ++i)
+      r[i] = a[i] * -1;
+  }
+  static void scale(double* r, const double* a, double s, std::size_t n) {
+    const typename Simd::type vs = Simd::set1(s);
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::mul(Simd::load(a + i), vs));
+    for (; i < n; ++i)
+      r[i] = a[i] * s;
+  }
+  static void scale_divide(double* r, const double* a, double s, std::size_t n) {
+    const typename Simd::type vs = Simd::set1(s);
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::div(Simd::load(a + i), vs));
+    for (; i < n; ++i)
+      r[i] = a[i] / s;
+  }
+  static void multiply_add(double* r, const double* a, const double* b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      Simd::store(r + i, Simd::add(Simd::load(r + i), Simd::mul(Simd::load(a + i), Simd::load(b + i))));
+    for (; i < n; ++i)
+      r[i] += a[i] * b[i];
+  }
+  static double reassociated_dot(const double* a, const double* b, std::size_t n) {
+    // four independent accumulators hide the latency of the additions
+    typename Simd::type s0 = Simd::zero(), s1 = Simd::zero(), s2 = Simd::zero(), s3 = Simd::zero();
+    std::size_t i = 0;
+    for (; i + 4 * W <= n; i += 4 * W) {
+      s0 = Simd::fmadd(Simd::load(a + i), Simd::load(b + i), s0);
+      s1 = Simd::fmadd(Simd::load(a + i + W), Simd::load(b + i + W), s1);
+      s2 = Simd::fmadd(Simd::load(a + i + 2 * W), Simd::load(b + i + 2 * W), s2);
+      s3 = Simd::fmadd(Simd::load(a + i + 3 * W), Simd::load(b + i + 3 * W), s3);
+    }
+    for (; i + W <= n; i += W)
+      s0 = Simd::fmadd(Simd::load(a + i), Simd::load(b + i), s0);
+    double result = Simd::hsum(Simd::add(Simd::add(s0, s1), Simd::add(s2, s3)));
+    for (; i < n; ++i)
+      result += a[i] * b[i];
+    return result;
+  }
+  static double reassociated_squared_distance(const double* a, const double* b, std::size_t n) {
+    typename Simd::type s0 = Simd::zero(), s1 = Simd::zero();
+    std::size_t i = 0;
+    for (; i + 2 * W <= n; i += 2 * W) {
+      const typename Simd::type d0 = Simd::sub(Simd::load(a + i), Simd::load(b + i));
+      const typename Simd::type d1 = Simd::sub(Simd::load(a + i + W), Simd::load(b + i + W));
+      s0 = Simd::fmadd(d0, d0, s0);
+      s1 = Simd::fmadd(d1, d1, s1);
+    }
+    for (; i + W <= n; i += W) {
+      const typename Simd::type d = Simd::sub(Simd::load(a + i), Simd::load(b + i));
+      s0 = Simd::fmadd(d, d, s0);
+    }
+    double result = Simd::hsum(Simd::add(s0, s1));
+    for (; i < n; ++i)
+      result += (a[i] - b[i]) * (a[i] - b[i]);
+    return result;
+  }
+
+  static const KernelTable& table() {
+    static const KernelTable table{&add,
+                                   &sub,
+                                   &multiply,
+                                   &divide,
+                                   &negate,
+                                   &scale,
+                                   &scale_divide,
+                                   &multiply_add,
+                                   &reassociated_dot,
+                                   &reassociated_squared_distance};
+    return table;
+  }
+};
+
+}  // namespace kernels::detail
+
+#endif  // LIBKRIGING_PARSER__KERNELSIMPL_HPP
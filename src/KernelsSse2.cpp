@@ -0,0 +1,24 @@
+#include <immintrin.h>
+
+#include "KernelsImpl.hpp"
+
+namespace {
+struct Sse2 {
+  using type = __m128d;
+  static constexpr std::size_t width = 2;
+  static type load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, type a) { _mm_storeu_pd(p, a); }
+  static type set1(double s) { return _mm_set1_pd(s); }
+  static type zero() { return _mm_setzero_pd(); }
+  static type add(type a, type b) { return _mm_add_pd(a, b); }
+  static type sub(type a, type b) { return _mm_sub_pd(a, b); }
+  static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+  static type div(type a, type b) { return _mm_div_pd(a, b); }
+  static type fmadd(type a, type b, type c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+  static double hsum(type a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+};
+}  // namespace
+
+const kernels::detail::KernelTable& kernels::detail::sse2_kernels() {
+  return GenericKernels<Sse2>::table();
+}
@@ -0,0 +1,39 @@
+#include "MixedPrecision.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+MixedPrecisionEvaluator::MixedPrecisionEvaluator(const IScalarFunction& f) : m_tape(::compile(f)) {}
+
+auto MixedPrecisionEvaluator::apply(const VectorBlock& points, const std::function<bool(Number)>& refine) const
+    -> Values {
+  // points are converted by chunks: the components of a chunk are read contiguously from the block
+  constexpr Index chunk = 64;
+  Values result{Vector(points.count), {}};
+  Tape::BasicWorkspace<float> workspace;
+  Tape::Workspace refine_workspace;
+  std::vector<std::vector<float>> xs(chunk, std::vector<float>(points.dimension));
+  Vector refined_x(points.dimension);
+  for (Index begin = 0; begin < points.count; begin += chunk) {
+    const Index end = std::min(begin + chunk, points.count);
+    for (Index i = 0; i < points.dimension; ++i) {
+      const Number* component = points.component(i);
+      for (Index p = begin; p < end; ++p) {
+        xs[p - begin][i] = static_cast<float>(component[p]);
+      }
+    }
+    for (Index p = begin; p < end; ++p) {
+      const Number value = m_tape.apply_as(xs[p - begin], workspace);
+      if (std::isfinite(value) && !refine(value)) {
+        result.values[p] = value;
+        continue;
+      }
+      for (Index i = 0; i < points.dimension; ++i) {
+        refined_x[i] = points.component(i)[p];
+      }
+      result.values[p] = m_tape.apply(refined_x, refine_workspace);
+      result.refined.push_back(p);
+    }
+  }
+  return result;
+}
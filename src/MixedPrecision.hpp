@@ -0,0 +1,30 @@
+#ifndef LIBKRIGING_PARSER__MIXEDPRECISION_HPP
+#define LIBKRIGING_PARSER__MIXEDPRECISION_HPP
+
+#include <functional>
+
+#include "ASTNode.hpp"
+#include "Tape.hpp"
+
+// Mixed precision evaluation of one function on a set of points, for screening passes:
+// every point is evaluated in float (Tape::apply_as<float>), then the values selected by a predicate on the float
+// value, and those which are not finite in float, are evaluated again in double.
+
+class MixedPrecisionEvaluator {
+ public:
+  struct Values {
+    Vector values;               // double value of the refined points, float value of the others
+    std::vector<Index> refined;  // points evaluated in double, increasing
+  };
+
+ public:
+  explicit MixedPrecisionEvaluator(const IScalarFunction& f);
+
+  //! values of the points of block; refine(v) selects the float values v to recompute in double
+  [[nodiscard]] Values apply(const VectorBlock& points, const std::function<bool(Number)>& refine) const;
+
+ private:
+  Tape m_tape;
+};
+
+#endif  // LIBKRIGING_PARSER__MIXEDPRECISION_HPP
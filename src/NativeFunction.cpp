@@ -0,0 +1,384 @@
+#include "NativeFunction.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if __has_include(<dlfcn.h>)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LIBKRIGING_PARSER_HAS_DLOPEN
+#endif
+
+namespace {
+// same rounding as the interpreter: no contraction into FMA, no reassociation
+const char* const compiler_flags = "-std=c++17 -O2 -ffp-contract=off -fPIC -shared -w";
+
+std::string scalar(const std::uint32_t r) {
+  return "s" + std::to_string(r);
+}
+
+std::string vector(const std::uint32_t r) {
+  return (r == Tape::input_register) ? std::string{"x"} : "v" + std::to_string(r);
+}
+
+std::string scalar_adjoint(const std::uint32_t r) {
+  return "ds" + std::to_string(r);
+}
+
+std::string vector_adjoint(const std::uint32_t r) {
+  return (r == Tape::input_register) ? std::string{"g"} : "dv" + std::to_string(r);
+}
+
+std::string literal(const Number value) {
+  if (std::isnan(value))
+    return "NAN";
+  if (std::isinf(value))
+    return (value > 0) ? "HUGE_VAL" : "-HUGE_VAL";
+  std::ostringstream oss;
+  oss << std::hexfloat << value;  // exact
+  return oss.str();
+}
+
+std::string loop(const std::string& statement) {
+  return "  for (std::size_t i = 0; i < n; ++i) " + statement + ";\n";
+}
+
+// declarations of vector registers and forward sweep
+void forward(std::ostream& out, const Tape& tape) {
+  for (std::uint32_t r = 1; r < tape.vector_registers(); ++r) {
+    out << "  double* const " << vector(r) << " = work + " << (r - 1) << " * n;\n";
+  }
+  const std::vector<Instruction>& instructions = tape.instructions();
+  for (const Instruction& inst : instructions) {
+    const std::string s = scalar(inst.result), v = vector(inst.result);
+    switch (inst.op) {
+      case OpCode::Constant:
+        out << "  double " << s << " = " << literal(tape.constants()[inst.lhs]) << ";\n";
+        break;
+      case OpCode::Add:
+        out << "  double " << s << " = " << scalar(inst.lhs) << " + " << scalar(inst.rhs) << ";\n";
+        break;
+      case OpCode::Sub:
+        out << "  double " << s << " = " << scalar(inst.lhs) << " - " << scalar(inst.rhs) << ";\n";
+        break;
+      case OpCode::Mul:
+        out << "  double " << s << " = " << scalar(inst.lhs) << " * " << scalar(inst.rhs) << ";\n";
+        break;
+      case OpCode::Div:
+        out << "  double " << s << " = " << scalar(inst.lhs) << " / " << scalar(inst.rhs) << ";\n";
+        break;
+      case OpCode::Neg:
+        out << "  double " << s << " = -" << scalar(inst.lhs) << ";\n";
+        break;
+      case OpCode::Exp:
+        out << "  double " << s << " = std::exp(" << scalar(inst.lhs) << ");\n";
+        break;
+      case OpCode::Dot:
+      case OpCode::Norm: {
+        const std::string a = vector(inst.lhs), b = (inst.op == OpCode::Norm) ? a : vector(inst.rhs);
+        out << "  double " << s << " = 0;\n" << loop(s + " += " + a + "[i] * " + b + "[i]");
+      } break;
+      case OpCode::SquaredDistance: {
+        const std::string d = "(" + vector(inst.lhs) + "[i] - " + vector(inst.rhs) + "[i])";
+        out << "  double " << s << " = 0;\n" << loop(s + " += " + d + " * " + d);
+      } break;
+      case OpCode::Component:
+        out << "  double " << s << " = " << vector(inst.lhs) << "[" << inst.rhs << "];\n";
+        break;
+      case OpCode::VectorZero:
+        out << loop(v + "[i] = 0");
+        break;
+      case OpCode::VectorPartialOne:
+        out << loop(v + "[i] = 0") << "  " << v << "[" << inst.lhs << "] = 1;\n";
+        break;
+      case OpCode::VectorAdd:
+        out << loop(v + "[i] = " + vector(inst.lhs) + "[i] + " + vector(inst.rhs) + "[i]");
+        break;
+      case OpCode::VectorSub:
+        out << loop(v + "[i] = " + vector(inst.lhs) + "[i] - " + vector(inst.rhs) + "[i]");
+        break;
+      case OpCode::VectorNeg:
+        out << loop(v + "[i] = -" + vector(inst.lhs) + "[i]");
+        break;
+      case OpCode::ScalarVectorProduct:
+        out << loop(v + "[i] = " + vector(inst.rhs) + "[i] * " + scalar(inst.lhs));
+        break;
+      case OpCode::VectorScalarDivide:
+        out << loop(v + "[i] = " + vector(inst.lhs) + "[i] / " + scalar(inst.rhs));
+        break;
+      case OpCode::SecondInput:  // generated functions take x alone
+        throw NotImplementedException(__PRETTY_FUNCTION__, " for functions of y");
+    }
+  }
+}
+
+// adjoint sweep, as in Tape::gradient
+void backward(std::ostream& out, const Tape& tape) {
+  const std::uint32_t vectors = tape.vector_registers();
+  for (std::uint32_t r = 1; r < vectors; ++r) {
+    out << "  double* const " << vector_adjoint(r) << " = work + " << (vectors - 1 + r - 1) << " * n;\n";
+  }
+  out << "  for (std::size_t i = 0; i < " << (vectors - 1) << " * n; ++i) work[" << (vectors - 1) << " * n + i] = 0;\n";
+  out << loop("g[i] = 0");
+  for (std::uint32_t r = 0; r < tape.scalar_registers(); ++r) {
+    out << "  double " << scalar_adjoint(r) << " = " << ((r == tape.result()) ? 1 : 0) << ";\n";
+  }
+
+  auto accumulate = [&out](const std::string& r, const std::string& a, const std::string& s) {
+    out << loop(r + "[i] += " + a + "[i] * " + s);
+  };
+  // t = dot(a, b), summed sequentially
+  auto dot = [&out](const std::string& a, const std::string& b) {
+    out << "    double t = 0;\n    for (std::size_t i = 0; i < n; ++i) t += " << a << "[i] * " << b << "[i];\n";
+  };
+
+  const std::vector<Instruction>& instructions = tape.instructions();
+  for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+    const Instruction& inst = *it;
+    const std::string ds = scalar_adjoint(inst.result), dv = vector_adjoint(inst.result);
+    const std::string ds_lhs = scalar_adjoint(inst.lhs), ds_rhs = scalar_adjoint(inst.rhs);
+    const std::string dv_lhs = vector_adjoint(inst.lhs), dv_rhs = vector_adjoint(inst.rhs);
+    switch (inst.op) {
+      case OpCode::Constant:
+      case OpCode::VectorZero:
+      case OpCode::VectorPartialOne:
+      case OpCode::SecondInput:
+        break;
+      case OpCode::Add:
+        out << "  " << ds_lhs << " += " << ds << ";\n  " << ds_rhs << " += " << ds << ";\n";
+        break;
+      case OpCode::Sub:
+        out << "  " << ds_lhs << " += " << ds << ";\n  " << ds_rhs << " -= " << ds << ";\n";
+        break;
+      case OpCode::Mul:
+        out << "  " << ds_lhs << " += " << ds << " * " << scalar(inst.rhs) << ";\n";
+        out << "  " << ds_rhs << " += " << ds << " * " << scalar(inst.lhs) << ";\n";
+        break;
+      case OpCode::Div:
+        out << "  " << ds_lhs << " += " << ds << " / " << scalar(inst.rhs) << ";\n";
+        out << "  " << ds_rhs << " -= " << ds << " * " << scalar(inst.result) << " / " << scalar(inst.rhs) << ";\n";
+        break;
+      case OpCode::Neg:
+        out << "  " << ds_lhs << " -= " << ds << ";\n";
+        break;
+      case OpCode::Exp:
+        out << "  " << ds_lhs << " += " << ds << " * " << scalar(inst.result) << ";\n";
+        break;
+      case OpCode::Dot:
+        accumulate(dv_lhs, vector(inst.rhs), ds);
+        accumulate(dv_rhs, vector(inst.lhs), ds);
+        break;
+      case OpCode::Norm:
+        accumulate(dv_lhs, vector(inst.lhs), "(2 * " + ds + ")");
+        break;
+      case OpCode::SquaredDistance: {
+        const std::string d = "(" + vector(inst.lhs) + "[i] - " + vector(inst.rhs) + "[i]) * (2 * " + ds + ")";
+        out << loop(dv_lhs + "[i] += " + d) << loop(dv_rhs + "[i] -= " + d);
+      } break;
+      case OpCode::Component:
+        out << "  " << dv_lhs << "[" << inst.rhs << "] += " << ds << ";\n";
+        break;
+      case OpCode::VectorAdd:
+        out << loop(dv_lhs + "[i] = " + dv_lhs + "[i] + " + dv + "[i]");
+        out << loop(dv_rhs + "[i] = " + dv_rhs + "[i] + " + dv + "[i]");
+        break;
+      case OpCode::VectorSub:
+        out << loop(dv_lhs + "[i] = " + dv_lhs + "[i] + " + dv + "[i]");
+        out << loop(dv_rhs + "[i] = " + dv_rhs + "[i] - " + dv + "[i]");
+        break;
+      case OpCode::VectorNeg:
+        out << loop(dv_lhs + "[i] = " + dv_lhs + "[i] - " + dv + "[i]");
+        break;
+      case OpCode::ScalarVectorProduct:
+        out << "  {\n";
+        dot(dv, vector(inst.rhs));
+        out << "    " << ds_lhs << " += t;\n  }\n";
+        accumulate(dv_rhs, dv, scalar(inst.lhs));
+        break;
+      case OpCode::VectorScalarDivide:
+        out << "  {\n";
+        dot(dv, vector(inst.result));
+        out << "    " << ds_rhs << " -= t / " << scalar(inst.rhs) << ";\n  }\n";
+        out << "  {\n    const double inverse = 1 / " << scalar(inst.rhs) << ";\n  ";
+        accumulate(dv_lhs, dv, "inverse");
+        out << "  }\n";
+        break;
+    }
+  }
+}
+
+std::uint64_t fnv1a(const std::string& text) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : text) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+std::string shell_quote(const std::string& text) {
+  std::string quoted = "'";
+  for (const char c : text) {
+    quoted += (c == '\'') ? std::string{"'\\''"} : std::string(1, c);
+  }
+  return quoted + "'";
+}
+
+#ifdef LIBKRIGING_PARSER_HAS_DLOPEN
+// per-user cache: $XDG_CACHE_HOME, else ~/.cache; empty when neither is known
+std::filesystem::path default_cache_directory() {
+  const char* cache = std::getenv("XDG_CACHE_HOME");
+  if (cache && *cache == '/')
+    return std::filesystem::path(cache) / "libkriging-parser-native";
+  const char* home = std::getenv("HOME");
+  if (home && *home == '/')
+    return std::filesystem::path(home) / ".cache" / "libkriging-parser-native";
+  return {};
+}
+
+// owned by us, of the expected type (symbolic links are not followed) and writable by nobody else:
+// no other user can place or replace what is loaded
+bool is_private(const std::filesystem::path& path, const bool directory) {
+  struct stat status {};
+  if (::lstat(path.c_str(), &status) != 0)
+    return false;
+  const bool type = (directory) ? S_ISDIR(status.st_mode) : S_ISREG(status.st_mode);
+  return type && status.st_uid == ::geteuid() && (status.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+std::string read_file(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream content;
+  content << in.rdbuf();
+  return content.str();
+}
+#endif
+}  // namespace
+
+std::string NativeFunction::source(const Tape& tape) {
+  std::ostringstream out;
+  out << "// generated by libKriging parser\n#include <cmath>\n#include <cstddef>\n\n";
+  out << "extern \"C\" double lkp_value(const double* x, const std::size_t n, double* work) {\n";
+  forward(out, tape);
+  out << "  return " << scalar(tape.result()) << ";\n}\n\n";
+  out << "extern \"C\" void lkp_gradient(const double* x, const std::size_t n, double* work, double* g) {\n";
+  forward(out, tape);
+  backward(out, tape);
+  out << "}\n";
+  return out.str();
+}
+
+NativeFunction::NativeFunction(const IScalarFunction& f, const NativeOptions& options) : m_tape(::compile(f)) {
+#ifdef LIBKRIGING_PARSER_HAS_DLOPEN
+  namespace fs = std::filesystem;
+  std::string compiler = options.compiler;
+  if (compiler.empty()) {
+    const char* cxx = std::getenv("CXX");
+    compiler = (cxx && *cxx) ? cxx : "c++";
+  }
+  const std::string code = source(m_tape);
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << fnv1a(compiler + '\n' + compiler_flags + '\n' + code);
+
+  std::error_code error;
+  const fs::path directory = (options.cache_directory.empty()) ? default_cache_directory()
+                                                               : fs::path(options.cache_directory);
+  if (directory.empty()) {
+    m_diagnostic = "no cache directory (neither XDG_CACHE_HOME nor HOME is set)";
+    return;
+  }
+  fs::create_directories(directory.parent_path(), error);
+  ::mkdir(directory.c_str(), 0700);  // may already exist
+  if (!is_private(directory, true)) {
+    m_diagnostic = "unsafe cache directory " + directory.string()
+                   + " (it must be a directory owned by the user and writable by nobody else)";
+    return;
+  }
+  const fs::path library = directory / (name.str() + ".so");
+  const fs::path stored_source = directory / (name.str() + ".cpp");  // compared before loading the library
+
+  if (!is_private(library, false) || !is_private(stored_source, false) || read_file(stored_source) != code) {
+    // missing, modified or a hash collision: (re)build it.
+    // Private file names, then atomic renames: concurrent builds of the same function are harmless
+    static std::atomic<unsigned> counter{0};
+    const std::string unique = name.str() + "." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+    const fs::path source_file = directory / (unique + ".cpp");
+    const fs::path built = directory / (unique + ".so");
+    const fs::path log = directory / (unique + ".log");
+    std::ofstream(source_file) << code;
+    const std::string command = compiler + " " + compiler_flags + " -o " + shell_quote(built.string()) + " "
+                                + shell_quote(source_file.string()) + " > " + shell_quote(log.string()) + " 2>&1";
+    const int status = std::system(command.c_str());
+    if (status == 0 && fs::exists(built)) {
+      fs::permissions(source_file, fs::perms::owner_read | fs::perms::owner_write, error);
+      fs::permissions(built, fs::perms::owner_all, error);
+      fs::rename(source_file, stored_source, error);
+      fs::rename(built, library, error);
+    } else {
+      std::ifstream in(log);
+      std::ostringstream messages;
+      messages << in.rdbuf();
+      m_diagnostic = "compilation failed (" + command + "): " + messages.str();
+    }
+    fs::remove(source_file, error);
+    fs::remove(built, error);
+    fs::remove(log, error);
+    if (!m_diagnostic.empty())
+      return;
+  }
+
+  void* handle = ::dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    m_diagnostic = std::string{"cannot load "} + library.string() + ": " + ::dlerror();
+    return;
+  }
+  m_library = std::shared_ptr<void>(handle, ::dlclose);
+  m_value = reinterpret_cast<ValueFunction>(::dlsym(handle, "lkp_value"));
+  m_gradient = reinterpret_cast<GradientFunction>(::dlsym(handle, "lkp_gradient"));
+  if (!m_value || !m_gradient) {
+    m_value = nullptr;
+    m_gradient = nullptr;
+    m_library.reset();
+    m_diagnostic = "invalid library " + library.string();
+    return;
+  }
+  m_diagnostic = library.string();
+#else
+  (void)options;
+  m_diagnostic = "native code is not supported on this platform";
+#endif
+}
+
+auto NativeFunction::apply(const Vector& x) const -> Number {
+  Tape::Workspace workspace;
+  return apply(x, workspace);
+}
+
+auto NativeFunction::apply(const Vector& x, Tape::Workspace& workspace) const -> Number {
+  if (!m_value)
+    return m_tape.apply(x, workspace);
+  m_tape.check_dimension(x.size());
+  workspace.vectors.resize((m_tape.vector_registers() - 1) * x.size());
+  return m_value(x.data(), x.size(), workspace.vectors.data());
+}
+
+auto NativeFunction::gradient(const Vector& x) const -> Vector {
+  Tape::Workspace workspace;
+  return gradient(x, workspace);
+}
+
+auto NativeFunction::gradient(const Vector& x, Tape::Workspace& workspace) const -> Vector {
+  if (!m_gradient)
+    return m_tape.gradient(x, workspace);
+  m_tape.check_dimension(x.size());
+  workspace.vectors.resize(2 * (m_tape.vector_registers() - 1) * x.size());
+  Vector g(x.size());
+  m_gradient(x.data(), x.size(), workspace.vectors.data(), g.data());
+  return g;
+}
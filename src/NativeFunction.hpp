@@ -0,0 +1,54 @@
+#ifndef LIBKRIGING_PARSER__NATIVEFUNCTION_HPP
+#define LIBKRIGING_PARSER__NATIVEFUNCTION_HPP
+
+#include <memory>
+#include <string>
+
+#include "ASTNode.hpp"
+#include "Tape.hpp"
+
+// Native code for long-lived functions.
+// The tape of a function is translated into a self-contained C++ source (value, and gradient by the same adjoint
+// sweep as Tape::gradient), built as a shared library by the system compiler and loaded with dlopen.
+// Libraries are cached on disk, keyed by a hash of the generated source and of the compiler command,
+// so that a function is compiled once per user. The source is kept next to its library and compared before loading
+// it (hash collisions are rebuilt), and the cache directory and its files must be owned by the user and writable by
+// nobody else: a library placed there by another user is never loaded.
+// Without a working compiler (or on platforms without dlopen) the function falls back to the tape interpreter.
+// Results are the same in both modes, dot products being summed as with ReductionMode::Exact.
+
+struct NativeOptions {
+  std::string compiler;         // empty: $CXX, or c++
+  std::string cache_directory;  // empty: $XDG_CACHE_HOME/libkriging-parser-native, or ~/.cache/libkriging-parser-native
+};
+
+class NativeFunction {
+ public:
+  explicit NativeFunction(const IScalarFunction& f, const NativeOptions& options = {});
+
+  [[nodiscard]] auto apply(const Vector& x) const -> Number;
+  [[nodiscard]] auto apply(const Vector& x, Tape::Workspace& workspace) const -> Number;
+  [[nodiscard]] auto gradient(const Vector& x) const -> Vector;
+  [[nodiscard]] auto gradient(const Vector& x, Tape::Workspace& workspace) const -> Vector;
+
+  //! true if evaluation runs native code, false if it uses the interpreter
+  [[nodiscard]] bool is_native() const { return m_value != nullptr; }
+  //! shared library in use, or why the interpreter is used
+  [[nodiscard]] const std::string& diagnostic() const { return m_diagnostic; }
+  [[nodiscard]] const Tape& tape() const { return m_tape; }
+
+  //! C++ source generated for a tape
+  static std::string source(const Tape& tape);
+
+ private:
+  using ValueFunction = double (*)(const double* x, std::size_t n, double* work);
+  using GradientFunction = void (*)(const double* x, std::size_t n, double* work, double* g);
+
+  Tape m_tape;
+  std::shared_ptr<void> m_library;
+  ValueFunction m_value = nullptr;
+  GradientFunction m_gradient = nullptr;
+  std::string m_diagnostic;
+};
+
+#endif  // LIBKRIGING_PARSER__NATIVEFUNCTION_HPP
@@ -0,0 +1,157 @@
+#include "PointStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LIBKRIGING_PARSER_HAS_MMAP
+#endif
+
+struct BinaryPointFile::File {
+#ifdef LIBKRIGING_PARSER_HAS_MMAP
+  int descriptor = -1;
+  const Number* data = nullptr;
+  std::size_t size = 0;      // bytes
+  std::size_t released = 0;  // bytes of pages given back
+
+  ~File() {
+    if (data)
+      ::munmap(const_cast<Number*>(data), size);
+    if (descriptor >= 0)
+      ::close(descriptor);
+  }
+#else
+  std::ifstream in;
+#endif
+};
+
+BinaryPointFile::BinaryPointFile(const std::string& filename, const Index dimension)
+    : m_file(std::make_unique<File>()), m_dimension(dimension) {
+  if (dimension == 0)
+    throw std::invalid_argument("point dimension must be positive");
+  std::size_t size;
+#ifdef LIBKRIGING_PARSER_HAS_MMAP
+  m_file->descriptor = ::open(filename.c_str(), O_RDONLY);
+  struct stat status {};
+  if (m_file->descriptor < 0 || ::fstat(m_file->descriptor, &status) != 0)
+    throw std::runtime_error("cannot open " + filename);
+  size = static_cast<std::size_t>(status.st_size);
+  if (size > 0) {
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, m_file->descriptor, 0);
+    if (data == MAP_FAILED)
+      throw std::runtime_error("cannot map " + filename);
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    m_file->data = static_cast<const Number*>(data);
+    m_file->size = size;
+  }
+#else
+  m_file->in.open(filename, std::ios::binary | std::ios::ate);
+  if (!m_file->in)
+    throw std::runtime_error("cannot open " + filename);
+  size = static_cast<std::size_t>(m_file->in.tellg());
+  m_file->in.seekg(0);
+#endif
+  if (size % (dimension * sizeof(Number)) != 0)
+    throw std::runtime_error(filename + " does not hold points of dimension " + std::to_string(dimension));
+  m_count = size / (dimension * sizeof(Number));
+}
+
+BinaryPointFile::~BinaryPointFile() = default;
+
+VectorBlock BinaryPointFile::read(const Index max_count) {
+  const Index count = std::min(max_count, m_count - m_next);
+  VectorBlock block(m_dimension, count);
+#ifdef LIBKRIGING_PARSER_HAS_MMAP
+  const Number* points = m_file->data + m_next * m_dimension;
+#else
+  Vector buffer(count * m_dimension);
+  m_file->in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(Number));
+  const Number* points = buffer.data();
+#endif
+  for (Index p = 0; p < count; ++p) {
+    for (Index i = 0; i < m_dimension; ++i) {
+      block.component(i)[p] = points[p * m_dimension + i];
+    }
+  }
+#ifdef LIBKRIGING_PARSER_HAS_MMAP
+  if (count > 0) {
+    // read pages are not needed anymore: keep the resident set bounded
+    const std::size_t page = ::sysconf(_SC_PAGESIZE);
+    const std::size_t end = ((m_next + count) * m_dimension * sizeof(Number)) / page * page;
+    if (end > m_file->released) {
+      auto* begin = reinterpret_cast<char*>(const_cast<Number*>(m_file->data)) + m_file->released;
+      ::madvise(begin, end - m_file->released, MADV_DONTNEED);
+      m_file->released = end;
+    }
+  }
+#endif
+  m_next += count;
+  return block;
+}
+
+VectorBlock CsvPointReader::read(const Index max_count) {
+  Vector points;  // point after point
+  std::string line;
+  while (points.size() < max_count * m_dimension && std::getline(m_in, line)) {
+    ++m_line;
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    auto error = [this] {
+      return std::runtime_error("line " + std::to_string(m_line) + ": expected " + std::to_string(m_dimension)
+                                + " comma separated numbers");
+    };
+    const char* p = line.c_str();
+    for (Index i = 0; i < m_dimension; ++i) {
+      char* end;
+      points.push_back(std::strtod(p, &end));
+      if (end == p)
+        throw error();
+      p = end + std::strspn(end, " \t");
+      if (i + 1 < m_dimension && *p++ != ',')
+        throw error();
+    }
+    if (std::strspn(p, " \t\r") != std::strlen(p))
+      throw error();
+  }
+  const Index count = points.size() / m_dimension;
+  VectorBlock block(m_dimension, count);
+  for (Index p = 0; p < count; ++p) {
+    for (Index i = 0; i < m_dimension; ++i) {
+      block.component(i)[p] = points[p * m_dimension + i];
+    }
+  }
+  return block;
+}
+
+void ResultWriter::write(const Vector& values, const VectorBlock& gradients) {
+  assert(gradients.count == 0 || gradients.count == values.size());
+  const Index dimension = (gradients.count > 0) ? gradients.dimension : 0;
+  if (m_format == StreamFormat::Binary) {
+    Vector row(1 + dimension);
+    for (Index p = 0; p < values.size(); ++p) {
+      row[0] = values[p];
+      for (Index i = 0; i < dimension; ++i) {
+        row[1 + i] = gradients.component(i)[p];
+      }
+      m_out.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(Number));
+    }
+  } else {
+    const auto precision = m_out.precision(17);
+    for (Index p = 0; p < values.size(); ++p) {
+      m_out << values[p];
+      for (Index i = 0; i < dimension; ++i) {
+        m_out << ',' << gradients.component(i)[p];
+      }
+      m_out << '\n';
+    }
+    m_out.precision(precision);
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef LIBKRIGING_PARSER__POINTSTREAM_HPP
+#define LIBKRIGING_PARSER__POINTSTREAM_HPP
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "ASTNode.hpp"
+
+// Streams of points read block by block, and of results written block by block:
+// memory use is bounded by the block size, whatever the size of the data.
+//
+// Binary format: native doubles, point after point (the `dimension` components of point 0, then point 1, ...).
+// Results are written the same way: the value of each point, followed by its gradient if requested.
+// CSV format: one point (or result) per line, comma separated.
+
+class PointSource {
+ public:
+  virtual ~PointSource() = default;
+  //! next block of at most max_count points (count is 0 at the end of the stream)
+  virtual VectorBlock read(Index max_count) = 0;
+};
+
+//! points of a raw binary file, memory mapped when the platform allows it (read block by block otherwise)
+class BinaryPointFile : public PointSource {
+ public:
+  BinaryPointFile(const std::string& filename, Index dimension);
+  ~BinaryPointFile() override;
+  BinaryPointFile(const BinaryPointFile&) = delete;
+  BinaryPointFile& operator=(const BinaryPointFile&) = delete;
+
+  [[nodiscard]] Index count() const { return m_count; }
+  VectorBlock read(Index max_count) override;
+
+ private:
+  struct File;
+  std::unique_ptr<File> m_file;
+  Index m_dimension;
+  Index m_count = 0;
+  Index m_next = 0;
+};
+
+//! points of a CSV stream (blank lines are skipped)
+class CsvPointReader : public PointSource {
+ public:
+  CsvPointReader(std::istream& in, Index dimension) : m_in(in), m_dimension(dimension) {}
+
+  VectorBlock read(Index max_count) override;
+
+ private:
+  std::istream& m_in;
+  Index m_dimension;
+  Index m_line = 0;
+};
+
+enum class StreamFormat { Csv, Binary };
+
+//! writes one value per point, each followed by its gradient when gradients are given
+class ResultWriter {
+ public:
+  ResultWriter(std::ostream& out, StreamFormat format) : m_out(out), m_format(format) {}
+
+  //! gradients: empty block, or one gradient per value
+  void write(const Vector& values, const VectorBlock& gradients);
+
+ private:
+  std::ostream& m_out;
+  StreamFormat m_format;
+};
+
+#endif  // LIBKRIGING_PARSER__POINTSTREAM_HPP
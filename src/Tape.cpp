@@ -0,0 +1,436 @@
+#include "Tape.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <sstream>
+
+#include "Kernels.hpp"
+
+bool is_vector_op(const OpCode op) {
+  return op >= OpCode::VectorZero && op != OpCode::SquaredDistance;
+}
+
+Index required_dimension(const Instruction& inst) {
+  switch (inst.op) {
+    case OpCode::Component:
+      return Index{inst.rhs} + 1;
+    case OpCode::VectorPartialOne:
+      return Index{inst.lhs} + 1;
+    default:
+      return 0;
+  }
+}
+
+const char* opcode_name(const OpCode op) {
+  switch (op) {
+    case OpCode::Constant:
+      return "const";
+    case OpCode::Add:
+      return "add";
+    case OpCode::Sub:
+      return "sub";
+    case OpCode::Mul:
+      return "mul";
+    case OpCode::Div:
+      return "div";
+    case OpCode::Neg:
+      return "neg";
+    case OpCode::Exp:
+      return "exp";
+    case OpCode::Dot:
+      return "dot";
+    case OpCode::Norm:
+      return "norm2";
+    case OpCode::Component:
+      return "component";
+    case OpCode::VectorZero:
+      return "vzero";
+    case OpCode::VectorPartialOne:
+      return "vone";
+    case OpCode::VectorAdd:
+      return "vadd";
+    case OpCode::VectorSub:
+      return "vsub";
+    case OpCode::VectorNeg:
+      return "vneg";
+    case OpCode::ScalarVectorProduct:
+      return "svmul";
+    case OpCode::VectorScalarDivide:
+      return "vsdiv";
+    case OpCode::SecondInput:
+      return "y";
+    case OpCode::SquaredDistance:
+      return "sqdist";
+  }
+  return "?";
+}
+
+namespace {
+// registers of one evaluation in the floating point type T; vector register 0 is x
+template <typename T>
+struct Registers {
+  T* s;
+  T* storage;
+  const T* x;
+  const T* y;  // nullptr for functions of x alone
+  std::size_t n;
+
+  [[nodiscard]] T* v(const std::uint32_t r) const { return storage + (r - 1) * n; }
+  [[nodiscard]] const T* cv(const std::uint32_t r) const { return (r == Tape::input_register) ? x : v(r); }
+};
+
+// kernels:: overloads are the SIMD ones for Number and the portable ones for the other types
+template <typename T>
+inline void execute(const Instruction& inst, const Registers<T>& registers, const Vector& constants) {
+  T* const s = registers.s;
+  const std::size_t n = registers.n;
+  auto v = [&](const std::uint32_t r) { return registers.v(r); };
+  auto cv = [&](const std::uint32_t r) { return registers.cv(r); };
+
+  switch (inst.op) {
+    case OpCode::Constant:
+      s[inst.result] = static_cast<T>(constants[inst.lhs]);
+      break;
+    case OpCode::Add:
+      s[inst.result] = s[inst.lhs] + s[inst.rhs];
+      break;
+    case OpCode::Sub:
+      s[inst.result] = s[inst.lhs] - s[inst.rhs];
+      break;
+    case OpCode::Mul:
+      s[inst.result] = s[inst.lhs] * s[inst.rhs];
+      break;
+    case OpCode::Div:
+      s[inst.result] = s[inst.lhs] / s[inst.rhs];
+      break;
+    case OpCode::Neg:
+      s[inst.result] = -s[inst.lhs];
+      break;
+    case OpCode::Exp:
+      s[inst.result] = std::exp(s[inst.lhs]);
+      break;
+    case OpCode::Dot:
+    case OpCode::Norm: {
+      const T* a = cv(inst.lhs);
+      s[inst.result] = kernels::dot(a, (inst.op == OpCode::Norm) ? a : cv(inst.rhs), n);
+    } break;
+    case OpCode::SquaredDistance:
+      s[inst.result] = kernels::squared_distance(cv(inst.lhs), cv(inst.rhs), n);
+      break;
+    case OpCode::Component:
+      assert(inst.rhs < n);
+      s[inst.result] = cv(inst.lhs)[inst.rhs];
+      break;
+    case OpCode::VectorZero: {
+      T* r = v(inst.result);
+      for (std::size_t i = 0; i < n; ++i) {
+        r[i] = 0;
+      }
+    } break;
+    case OpCode::VectorPartialOne: {
+      T* r = v(inst.result);
+      for (std::size_t i = 0; i < n; ++i) {
+        r[i] = 0;
+      }
+      r[inst.lhs] = 1;
+    } break;
+    case OpCode::VectorAdd:
+      kernels::add(v(inst.result), cv(inst.lhs), cv(inst.rhs), n);
+      break;
+    case OpCode::VectorSub:
+      kernels::sub(v(inst.result), cv(inst.lhs), cv(inst.rhs), n);
+      break;
+    case OpCode::VectorNeg:
+      kernels::negate(v(inst.result), cv(inst.lhs), n);
+      break;
+    case OpCode::ScalarVectorProduct:
+      kernels::scale(v(inst.result), cv(inst.rhs), s[inst.lhs], n);
+      break;
+    case OpCode::VectorScalarDivide:
+      kernels::scale_divide(v(inst.result), cv(inst.lhs), s[inst.rhs], n);
+      break;
+    case OpCode::SecondInput:
+      if (!registers.y)
+        throw std::invalid_argument("function of y evaluated without a second point");
+      std::copy(registers.y, registers.y + n, v(inst.result));
+      break;
+  }
+}
+}  // namespace
+
+void Tape::check_dimension(const std::size_t n) const {
+  if (n < m_dimension)
+    throw std::invalid_argument("points of dimension " + std::to_string(n) + " given to a function of dimension "
+                                + std::to_string(m_dimension));
+}
+
+auto Tape::apply(const Vector& x) const -> Number {
+  Workspace workspace;
+  return apply(x, workspace);
+}
+
+auto Tape::apply(const Vector& x, Workspace& workspace) const -> Number {
+  return run<Number>(x.data(), nullptr, x.size(), workspace.scalars, workspace.vectors);
+}
+
+template <typename T>
+auto Tape::apply_as(const std::vector<T>& x) const -> T {
+  BasicWorkspace<T> workspace;
+  return apply_as(x, workspace);
+}
+
+template <typename T>
+auto Tape::apply_as(const std::vector<T>& x, BasicWorkspace<T>& workspace) const -> T {
+  return run<T>(x.data(), nullptr, x.size(), workspace.scalars, workspace.vectors);
+}
+
+template auto Tape::apply_as(const std::vector<float>& x) const -> float;
+template auto Tape::apply_as(const std::vector<double>& x) const -> double;
+template auto Tape::apply_as(const std::vector<long double>& x) const -> long double;
+template auto Tape::apply_as(const std::vector<float>& x, BasicWorkspace<float>& workspace) const -> float;
+template auto Tape::apply_as(const std::vector<double>& x, BasicWorkspace<double>& workspace) const -> double;
+template auto Tape::apply_as(const std::vector<long double>& x, BasicWorkspace<long double>& workspace) const
+    -> long double;
+
+auto Tape::apply(const Vector& x, const Vector& y) const -> Number {
+  Workspace workspace;
+  return apply(x, y, workspace);
+}
+
+auto Tape::apply(const Vector& x, const Vector& y, Workspace& workspace) const -> Number {
+  if (y.size() != x.size())
+    throw std::invalid_argument("x and y have different dimensions");
+  return run(x.data(), y.data(), x.size(), workspace.scalars, workspace.vectors);
+}
+
+template <typename T>
+auto Tape::run(const T* x, const T* y, const std::size_t n, std::vector<T>& scalars, std::vector<T>& vectors) const
+    -> T {
+  check_dimension(n);
+  scalars.resize(m_scalar_registers);
+  vectors.resize((m_vector_registers - 1) * n);
+
+  const Registers<T> registers{scalars.data(), vectors.data(), x, y, n};
+  for (const Instruction& inst : m_instructions) {
+    execute(inst, registers, m_constants);
+  }
+  return scalars[m_result];
+}
+
+auto Tape::apply_partial(const Vector& x, Workspace& workspace, const std::vector<std::uint32_t>& instructions) const
+    -> Number {
+  const std::size_t n = x.size();
+  check_dimension(n);
+  assert(workspace.scalars.size() == m_scalar_registers && workspace.vectors.size() == (m_vector_registers - 1) * n);
+  const Registers<Number> registers{workspace.scalars.data(), workspace.vectors.data(), x.data(), nullptr, n};
+  for (const std::uint32_t k : instructions) {
+    execute(m_instructions[k], registers, m_constants);
+  }
+  return workspace.scalars[m_result];
+}
+
+auto Tape::gradient(const Vector& x) const -> Vector {
+  Workspace workspace;
+  return gradient(x, workspace);
+}
+
+auto Tape::gradient(const Vector& x, Workspace& workspace) const -> Vector {
+  const std::size_t n = x.size();
+  (void)apply(x, workspace);  // forward values of every register are kept
+  workspace.scalar_adjoints.assign(m_scalar_registers, 0);
+  workspace.vector_adjoints.assign(m_vector_registers * n, 0);
+
+  const Number* const s = workspace.scalars.data();
+  const Number* const storage = workspace.vectors.data();
+  auto cv = [&](const std::uint32_t r) -> const Number* { return (r == input_register) ? x.data() : storage + (r - 1) * n; };
+  Number* const ds = workspace.scalar_adjoints.data();
+  auto dv = [&](const std::uint32_t r) -> Number* { return workspace.vector_adjoints.data() + r * n; };
+  // r += a * s
+  auto accumulate = [n](Number* r, const Number* a, const Number s) {
+    for (std::size_t i = 0; i < n; ++i)
+      r[i] += a[i] * s;
+  };
+
+  ds[m_result] = 1;
+  for (auto it = m_instructions.rbegin(); it != m_instructions.rend(); ++it) {
+    const Instruction& inst = *it;
+    switch (inst.op) {
+      case OpCode::Constant:
+      case OpCode::VectorZero:
+      case OpCode::VectorPartialOne:
+      case OpCode::SecondInput:
+        break;
+      case OpCode::Add:
+        ds[inst.lhs] += ds[inst.result];
+        ds[inst.rhs] += ds[inst.result];
+        break;
+      case OpCode::Sub:
+        ds[inst.lhs] += ds[inst.result];
+        ds[inst.rhs] -= ds[inst.result];
+        break;
+      case OpCode::Mul:
+        ds[inst.lhs] += ds[inst.result] * s[inst.rhs];
+        ds[inst.rhs] += ds[inst.result] * s[inst.lhs];
+        break;
+      case OpCode::Div:
+        ds[inst.lhs] += ds[inst.result] / s[inst.rhs];
+        ds[inst.rhs] -= ds[inst.result] * s[inst.result] / s[inst.rhs];
+        break;
+      case OpCode::Neg:
+        ds[inst.lhs] -= ds[inst.result];
+        break;
+      case OpCode::Exp:
+        ds[inst.lhs] += ds[inst.result] * s[inst.result];
+        break;
+      case OpCode::Dot:
+        accumulate(dv(inst.lhs), cv(inst.rhs), ds[inst.result]);
+        accumulate(dv(inst.rhs), cv(inst.lhs), ds[inst.result]);
+        break;
+      case OpCode::Norm:
+        accumulate(dv(inst.lhs), cv(inst.lhs), 2 * ds[inst.result]);
+        break;
+      case OpCode::SquaredDistance: {
+        const Number* a = cv(inst.lhs);
+        const Number* b = cv(inst.rhs);
+        Number* da = dv(inst.lhs);
+        Number* db = dv(inst.rhs);
+        const Number g = 2 * ds[inst.result];
+        for (std::size_t i = 0; i < n; ++i) {
+          const Number d = (a[i] - b[i]) * g;
+          da[i] += d;
+          db[i] -= d;
+        }
+      } break;
+      case OpCode::Component:
+        dv(inst.lhs)[inst.rhs] += ds[inst.result];
+        break;
+      case OpCode::VectorAdd:
+        kernels::add(dv(inst.lhs), dv(inst.lhs), dv(inst.result), n);
+        kernels::add(dv(inst.rhs), dv(inst.rhs), dv(inst.result), n);
+        break;
+      case OpCode::VectorSub:
+        kernels::add(dv(inst.lhs), dv(inst.lhs), dv(inst.result), n);
+        kernels::sub(dv(inst.rhs), dv(inst.rhs), dv(inst.result), n);
+        break;
+      case OpCode::VectorNeg:
+        kernels::sub(dv(inst.lhs), dv(inst.lhs), dv(inst.result), n);
+        break;
+      case OpCode::ScalarVectorProduct:
+        ds[inst.lhs] += kernels::dot(dv(inst.result), cv(inst.rhs), n);
+        accumulate(dv(inst.rhs), dv(inst.result), s[inst.lhs]);
+        break;
+      case OpCode::VectorScalarDivide:
+        ds[inst.rhs] -= kernels::dot(dv(inst.result), cv(inst.result), n) / s[inst.rhs];
+        accumulate(dv(inst.lhs), dv(inst.result), 1 / s[inst.rhs]);
+        break;
+    }
+  }
+  return Vector(dv(input_register), dv(input_register) + n);
+}
+
+std::string Tape::string() const {
+  std::ostringstream oss;
+  auto reg = [](const bool vectorial, const std::uint32_t r) {
+    return (vectorial) ? ((r == input_register) ? std::string{"x"} : "v" + std::to_string(r))
+                       : "s" + std::to_string(r);
+  };
+  for (const Instruction& inst : m_instructions) {
+    oss << reg(is_vector_op(inst.op), inst.result) << " = " << opcode_name(inst.op);
+    switch (inst.op) {
+      case OpCode::Constant:
+        oss << " " << m_constants[inst.lhs];
+        break;
+      case OpCode::Add:
+      case OpCode::Sub:
+      case OpCode::Mul:
+      case OpCode::Div:
+        oss << " " << reg(false, inst.lhs) << " " << reg(false, inst.rhs);
+        break;
+      case OpCode::Neg:
+      case OpCode::Exp:
+        oss << " " << reg(false, inst.lhs);
+        break;
+      case OpCode::Dot:
+      case OpCode::SquaredDistance:
+      case OpCode::VectorAdd:
+      case OpCode::VectorSub:
+        oss << " " << reg(true, inst.lhs) << " " << reg(true, inst.rhs);
+        break;
+      case OpCode::Norm:
+      case OpCode::VectorNeg:
+        oss << " " << reg(true, inst.lhs);
+        break;
+      case OpCode::Component:
+        oss << " " << reg(true, inst.lhs) << " [" << inst.rhs << "]";
+        break;
+      case OpCode::VectorZero:
+      case OpCode::SecondInput:
+        break;
+      case OpCode::VectorPartialOne:
+        oss << " [" << inst.lhs << "]";
+        break;
+      case OpCode::ScalarVectorProduct:
+        oss << " " << reg(false, inst.lhs) << " " << reg(true, inst.rhs);
+        break;
+      case OpCode::VectorScalarDivide:
+        oss << " " << reg(true, inst.lhs) << " " << reg(false, inst.rhs);
+        break;
+    }
+    oss << '\n';
+  }
+  oss << "return " << reg(false, m_result) << '\n';
+  return oss.str();
+}
+
+auto TapeBuilder::constant(const Number value) -> Index {
+  const auto index = static_cast<std::uint32_t>(m_tape.m_constants.size());
+  m_tape.m_constants.push_back(value);
+  return scalar(OpCode::Constant, index);
+}
+
+auto TapeBuilder::scalar(const OpCode op, const Index lhs, const Index rhs) -> Index {
+  assert(!is_vector_op(op));
+  const std::uint32_t result = m_tape.m_scalar_registers++;
+  m_tape.m_instructions.push_back(
+      Instruction{op, result, static_cast<std::uint32_t>(lhs), static_cast<std::uint32_t>(rhs)});
+  m_tape.m_dimension = std::max(m_tape.m_dimension, required_dimension(m_tape.m_instructions.back()));
+  return result;
+}
+
+auto TapeBuilder::vector(const OpCode op, const Index lhs, const Index rhs) -> Index {
+  assert(is_vector_op(op));
+  const std::uint32_t result = m_tape.m_vector_registers++;
+  m_tape.m_instructions.push_back(
+      Instruction{op, result, static_cast<std::uint32_t>(lhs), static_cast<std::uint32_t>(rhs)});
+  m_tape.m_dimension = std::max(m_tape.m_dimension, required_dimension(m_tape.m_instructions.back()));
+  return result;
+}
+
+auto TapeBuilder::second_input() -> Index {
+  if (!m_second_input)
+    m_second_input = vector(OpCode::SecondInput);
+  return *m_second_input;
+}
+
+auto TapeBuilder::compiled(const IFunction& f) const -> std::optional<Index> {
+  if (const auto found = m_registers.find(&f); found != m_registers.end())
+    return found->second;
+  return std::nullopt;
+}
+
+auto TapeBuilder::remember(const IFunction& f, const Index result) -> Index {
+  m_registers.emplace(&f, result);
+  return result;
+}
+
+auto TapeBuilder::finish(const Index result) -> Tape {
+  m_tape.m_result = static_cast<std::uint32_t>(result);
+  return std::move(m_tape);
+}
+
+Tape compile(const IScalarFunction& f) {
+  TapeBuilder builder;
+  const Index result = f.compile(builder);
+  return builder.finish(result);
+}
@@ -0,0 +1,150 @@
+#ifndef LIBKRIGING_PARSER__TAPE_HPP
+#define LIBKRIGING_PARSER__TAPE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ASTNode.hpp"
+
+// Flat form of an IScalarFunction: a contiguous array of instructions over two register files
+// (scalar registers and vector registers) evaluated by a single interpreter loop.
+// Vector register 0 is always the input point x (never copied).
+// Functions of two points (x, y), as covariance kernels, load y once into a register of their own.
+// A tape reading x_i (or building e_i) needs points of dimension i + 1 at least: evaluations check it.
+
+enum class OpCode : std::uint8_t {
+  // scalar results
+  Constant,  // s[result] = constants[lhs]
+  Add,       // s[result] = s[lhs] + s[rhs]
+  Sub,       // s[result] = s[lhs] - s[rhs]
+  Mul,       // s[result] = s[lhs] * s[rhs]
+  Div,       // s[result] = s[lhs] / s[rhs]
+  Neg,       // s[result] = -s[lhs]
+  Exp,       // s[result] = exp(s[lhs])
+  Dot,       // s[result] = dot(v[lhs], v[rhs])
+  Norm,      // s[result] = dot(v[lhs], v[lhs])
+  Component, // s[result] = v[lhs][rhs]
+  // vector results
+  VectorZero,           // v[result] = 0
+  VectorPartialOne,     // v[result] = e_lhs
+  VectorAdd,            // v[result] = v[lhs] + v[rhs]
+  VectorSub,            // v[result] = v[lhs] - v[rhs]
+  VectorNeg,            // v[result] = -v[lhs]
+  ScalarVectorProduct,  // v[result] = s[lhs] * v[rhs]
+  VectorScalarDivide,   // v[result] = v[lhs] / s[rhs]
+  SecondInput,          // v[result] = y
+  // scalar result, numbered after the vector operations to keep the opcodes of saved tapes
+  SquaredDistance  // s[result] = dot(v[lhs] - v[rhs], v[lhs] - v[rhs]), without storing the difference
+};
+
+struct Instruction {
+  OpCode op;
+  std::uint32_t result;
+  std::uint32_t lhs;
+  std::uint32_t rhs;
+};
+
+bool is_vector_op(OpCode op);
+const char* opcode_name(OpCode op);
+//! smallest dimension of the points inst can be evaluated at (0 for any)
+Index required_dimension(const Instruction& inst);
+
+class Tape {
+ public:
+  //! scratch registers; reuse it between calls to avoid any allocation once sized
+  struct Workspace {
+    Vector scalars;
+    Vector vectors;
+    Vector scalar_adjoints;
+    Vector vector_adjoints;
+  };
+
+  //! registers of an evaluation in another floating point type (see apply_as)
+  template <typename T>
+  struct BasicWorkspace {
+    std::vector<T> scalars;
+    std::vector<T> vectors;
+  };
+
+  static constexpr std::uint32_t input_register = 0;
+
+ public:
+  [[nodiscard]] auto apply(const Vector& x) const -> Number;
+  [[nodiscard]] auto apply(const Vector& x, Workspace& workspace) const -> Number;
+  //! value computed in the floating point type T (float, double or long double): the instructions are shared,
+  //! constants (parsed as Number) are converted to T and every register holds a T. apply_as<Number> is apply.
+  template <typename T>
+  [[nodiscard]] auto apply_as(const std::vector<T>& x) const -> T;
+  template <typename T>
+  [[nodiscard]] auto apply_as(const std::vector<T>& x, BasicWorkspace<T>& workspace) const -> T;
+  //! value of a function of x and y (points of the same dimension); apply(x) throws for such functions
+  [[nodiscard]] auto apply(const Vector& x, const Vector& y) const -> Number;
+  [[nodiscard]] auto apply(const Vector& x, const Vector& y, Workspace& workspace) const -> Number;
+  //! evaluates only the given instructions (increasing indices); the other registers are kept as left in workspace
+  //! by the previous evaluation, which must have been made in the same dimension
+  [[nodiscard]] auto apply_partial(const Vector& x,
+                                   Workspace& workspace,
+                                   const std::vector<std::uint32_t>& instructions) const -> Number;
+  //! reverse mode: one forward sweep then one adjoint sweep over the instructions
+  [[nodiscard]] auto gradient(const Vector& x) const -> Vector;
+  [[nodiscard]] auto gradient(const Vector& x, Workspace& workspace) const -> Vector;
+
+  [[nodiscard]] const std::vector<Instruction>& instructions() const { return m_instructions; }
+  [[nodiscard]] const Vector& constants() const { return m_constants; }
+  [[nodiscard]] std::uint32_t scalar_registers() const { return m_scalar_registers; }
+  [[nodiscard]] std::uint32_t vector_registers() const { return m_vector_registers; }
+  [[nodiscard]] std::uint32_t result() const { return m_result; }
+  //! smallest dimension of the points the tape can be evaluated at
+  [[nodiscard]] Index dimension() const { return m_dimension; }
+  //! throws std::invalid_argument if points of dimension n are too small for the tape
+  void check_dimension(std::size_t n) const;
+
+  //! human readable listing, one instruction per line
+  [[nodiscard]] std::string string() const;
+
+ private:
+  template <typename T>
+  auto run(const T* x, const T* y, std::size_t n, std::vector<T>& scalars, std::vector<T>& vectors) const -> T;
+
+ private:
+  friend class TapeBuilder;
+  friend class TapeLoader;  // CompiledFile.cpp
+
+  std::vector<Instruction> m_instructions;
+  Vector m_constants;
+  std::uint32_t m_scalar_registers = 0;
+  std::uint32_t m_vector_registers = 1;  // input register
+  std::uint32_t m_result = 0;
+  Index m_dimension = 0;
+};
+
+class TapeBuilder {
+ public:
+  auto constant(Number value) -> Index;
+  auto scalar(OpCode op, Index lhs, Index rhs = 0) -> Index;
+  auto vector(OpCode op, Index lhs = 0, Index rhs = 0) -> Index;
+  auto input() const -> Index { return Tape::input_register; }
+  //! register holding y, loaded by the first call
+  auto second_input() -> Index;
+
+  //! register already holding the value of node f, if compiled by this builder
+  auto compiled(const IFunction& f) const -> std::optional<Index>;
+  //! records that register holds the value of node f; returns register
+  auto remember(const IFunction& f, Index result) -> Index;
+
+  auto finish(Index result) -> Tape;
+
+ private:
+  Tape m_tape;
+  std::optional<Index> m_second_input;
+  // nodes are interned: the same address is the same subexpression (scalar and vector registers never collide,
+  // a node being either scalar or vectorial)
+  std::unordered_map<const IFunction*, Index> m_registers;
+};
+
+Tape compile(const IScalarFunction& f);
+
+#endif  // LIBKRIGING_PARSER__TAPE_HPP
@@ -0,0 +1,130 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+// pool and queue of the current thread, if it belongs to a pool
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local std::size_t current_queue = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(const std::size_t concurrency) {
+  const std::size_t threads = std::max<std::size_t>(concurrency, 1);
+  for (std::size_t i = 0; i < threads; ++i) {
+    m_queues.push_back(std::make_unique<Queue>());
+  }
+  for (std::size_t i = 1; i < threads; ++i) {
+    m_threads.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (std::thread& thread : m_threads) {
+    thread.join();
+  }
+}
+
+std::size_t ThreadPool::self() const {
+  return (current_pool == this) ? current_queue : 0;
+}
+
+void ThreadPool::push(Task task) {
+  Queue& queue = *m_queues[self()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_queued;
+  }
+  m_wake.notify_one();
+}
+
+bool ThreadPool::run_one() {
+  const std::size_t own = self();
+  Task task;
+  for (std::size_t k = 0; k < m_queues.size() && !task; ++k) {
+    Queue& queue = *m_queues[(own + k) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    if (k == 0) {  // own queue: newest task
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {  // steal the oldest task
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+  if (!task)
+    return false;
+  --m_queued;
+  task();
+  return true;
+}
+
+void ThreadPool::work(const std::size_t self) {
+  current_pool = this;
+  current_queue = self;
+  while (true) {
+    if (run_one())
+      continue;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+    if (m_stop)
+      return;
+  }
+}
+
+void ThreadPool::parallel_for(const Index begin,
+                              const Index end,
+                              const Index grain,
+                              const std::function<void(Index, Index)>& body) {
+  if (begin >= end)
+    return;
+  struct State {
+    std::atomic<Index> remaining;
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<State>();
+  state->remaining = end - begin;
+  const Index chunk = std::max<Index>(grain, 1);
+
+  // runs [b, e) and gives away its second halves (to be stolen) until it fits in a chunk.
+  // Pending tasks own the splitter: it stays alive while a thief is still returning from it.
+  using Splitter = std::function<void(Index, Index)>;
+  auto split = std::make_shared<Splitter>();
+  *split = [this, weak = std::weak_ptr<Splitter>(split), state, chunk, &body](Index b, Index e) {
+    while (e - b > chunk) {
+      const Index middle = b + (e - b) / 2;
+      push([splitter = weak.lock(), middle, e] { (*splitter)(middle, e); });
+      e = middle;
+    }
+    try {
+      if (!state->failed)
+        body(b, e);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->failed.exchange(true))
+        state->error = std::current_exception();
+    }
+    state->remaining -= e - b;
+  };
+  (*split)(begin, end);
+
+  while (state->remaining > 0) {
+    if (!run_one())
+      std::this_thread::yield();
+  }
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
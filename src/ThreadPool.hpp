@@ -0,0 +1,58 @@
+#ifndef LIBKRIGING_PARSER__THREADPOOL_HPP
+#define LIBKRIGING_PARSER__THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ASTNode.hpp"
+
+// Work-stealing thread pool.
+// Each thread owns a deque of tasks: it pushes and pops at the back (depth first, cache friendly)
+// while idle threads steal from the front of the others (the largest pieces of work).
+// parallel_for splits its range recursively, so the work spreads by stealing and adapts to uneven costs.
+// The thread calling parallel_for takes part in the work until its range is done: a pool of concurrency c runs
+// c threads in total, c - 1 of them owned by the pool. Nested parallel_for calls are allowed.
+
+class ThreadPool {
+ public:
+  //! concurrency: number of threads evaluating together, including the caller (at least 1)
+  explicit ThreadPool(std::size_t concurrency = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  [[nodiscard]] std::size_t concurrency() const { return m_queues.size(); }
+
+  //! calls body(chunk_begin, chunk_end) on disjoint chunks of at most grain indices covering [begin, end).
+  //! The first exception thrown by body is rethrown once every chunk has finished.
+  void parallel_for(Index begin, Index end, Index grain, const std::function<void(Index, Index)>& body);
+
+ private:
+  using Task = std::function<void()>;
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void push(Task task);
+  //! runs one task, from the queue of this thread or stolen; false if there was none
+  bool run_one();
+  void work(std::size_t self);
+  std::size_t self() const;
+
+ private:
+  std::vector<std::unique_ptr<Queue>> m_queues;  // queue 0 is shared by the threads outside of the pool
+  std::vector<std::thread> m_threads;
+  std::atomic<std::size_t> m_queued{0};
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stop = false;
+};
+
+#endif  // LIBKRIGING_PARSER__THREADPOOL_HPP
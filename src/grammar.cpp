@@ -4,6 +4,8 @@
 
 #include "grammar.hpp"
 
+#include <string_view>
+#include <type_traits>
 #include <tao/pegtl.hpp>
 #include <tao/pegtl/analyze.hpp>
 #include <tao/pegtl/contrib/parse_tree.hpp>
@@ -152,13 +154,157 @@ using selector = parse_tree::selector<
     collapse_function_name::
         on<nullary_a2s_function, unary_s2s_function, unary_v2s_function, unary_v2v_function, binary_v2s_function>>;
 
+// direct construction of functions (no parse tree): actions push values and operators into a FunctionBuilder,
+// the control opens a frame at the start of the rules below and reduces or drops it when they end.
+// Actions are not undone when the parser backtracks: any rule that may fail after one of its parts succeeded
+// is a frame.
+template <typename Rule, typename... Rules>
+constexpr bool is_one_of = (std::is_same_v<Rule, Rules> || ...);
+
+template <typename Rule>
+constexpr bool is_fold_frame = is_one_of<Rule, scalar_term, vector_term, scalar_expression, vector_expression>;
+template <typename Rule>
+constexpr bool is_call_frame = is_one_of<Rule,
+                                         nullary_a2s_function,
+                                         unary_s2s_function,
+                                         unary_v2s_function,
+                                         unary_v2v_function,
+                                         binary_v2s_function>;
+template <typename Rule>
+constexpr bool is_frame = is_fold_frame<Rule> || is_call_frame<Rule>
+                          || is_one_of<Rule,
+                                       scalar_bracketed,
+                                       vector_bracketed,
+                                       indexed_vector_variable,
+                                       seq<scalar_factor, multiply>,
+                                       seq<sor<multiply, divide>, scalar_factor>>;
+
+template <typename Rule>
+struct build_control : normal<Rule> {
+  template <typename Input>
+  static void start(const Input& /*unused*/, FunctionBuilder& builder) {
+    if constexpr (is_frame<Rule>)
+      builder.open();
+  }
+  template <typename Input>
+  static void success(const Input& /*unused*/, FunctionBuilder& builder) {
+    if constexpr (is_fold_frame<Rule>)
+      builder.fold();
+    else if constexpr (is_call_frame<Rule>)
+      builder.call();
+    else if constexpr (is_frame<Rule>)
+      builder.close();
+  }
+  template <typename Input>
+  static void failure(const Input& /*unused*/, FunctionBuilder& builder) {
+    if constexpr (is_frame<Rule>)
+      builder.drop();
+  }
+};
+
+template <typename Input>
+std::string_view matched(const Input& in) {
+  return {in.begin(), in.size()};
+}
+
+template <FunctionBuilder::Operator op>
+struct push_operator {
+  static void apply0(FunctionBuilder& builder) { builder.operation(op); }
+};
+
+struct push_name {
+  template <typename Input>
+  static void apply(const Input& in, FunctionBuilder& builder) {
+    builder.name(matched(in));
+  }
+};
+
+template <typename Rule>
+struct build_action : nothing<Rule> {};
+
+template <>
+struct build_action<scalar_variable> {
+  template <typename Input>
+  static void apply(const Input& in, FunctionBuilder& builder) {
+    builder.scalar_value(matched(in));
+  }
+};
+template <>
+struct build_action<scalar_constant> : build_action<scalar_variable> {};
+template <>
+struct build_action<number> {
+  template <typename Input>
+  static void apply(const Input& in, FunctionBuilder& builder) {
+    builder.number(matched(in));
+  }
+};
+template <>
+struct build_action<vector_variable> {
+  template <typename Input>
+  static void apply(const Input& in, FunctionBuilder& builder) {
+    builder.vector_value(matched(in));
+  }
+};
+template <>
+struct build_action<index> {
+  template <typename Input>
+  static void apply(const Input& in, FunctionBuilder& builder) {
+    builder.index(matched(in));
+  }
+};
+
+template <>
+struct build_action<nullary_a2s_function_name> : push_name {};
+template <>
+struct build_action<unary_s2s_function_name> : push_name {};
+template <>
+struct build_action<unary_v2s_function_name> : push_name {};
+template <>
+struct build_action<unary_v2v_function_name> : push_name {};
+template <>
+struct build_action<binary_v2s_function_name> : push_name {};
+
+template <>
+struct build_action<plus> : push_operator<FunctionBuilder::Operator::Add> {};
+template <>
+struct build_action<minus> : push_operator<FunctionBuilder::Operator::Sub> {};
+template <>
+struct build_action<multiply> : push_operator<FunctionBuilder::Operator::Multiply> {};
+template <>
+struct build_action<divide> : push_operator<FunctionBuilder::Operator::Divide> {};
+template <>
+struct build_action<prefix_plus> : push_operator<FunctionBuilder::Operator::PrefixPlus> {};
+template <>
+struct build_action<prefix_minus> : push_operator<FunctionBuilder::Operator::PrefixMinus> {};
+
 }  // namespace language
 
+namespace {
+// the grammar is static: analyze it once per process
+bool valid_grammar() {
+  static const bool valid = [] {
+    if (analyze<language::grammar>() != 0) {
+      std::cerr << "there are problems in grammar" << std::endl;
+      return false;
+    }
+    return true;
+  }();
+  return valid;
+}
+}  // namespace
+
 std::unique_ptr<ASTNode> parse(string_input<>& in) {
-  if (analyze<language::grammar>() != 0) {
-    std::cerr << "there are problems in grammar" << std::endl;
+  if (!valid_grammar())
     return {};
-  }
 
   return parse_tree::parse<language::grammar, ASTNode, language::selector>(in);
 }
+
+std::unique_ptr<IScalarFunction> parse_function(string_input<>& in) {
+  if (!valid_grammar())
+    return {};
+
+  FunctionBuilder builder;
+  tao::TAO_PEGTL_NAMESPACE::parse<language::grammar, language::build_action, language::build_control>(in, builder);
+  return builder.result();
+}
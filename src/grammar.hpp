@@ -10,4 +10,8 @@
 
 std::unique_ptr<ASTNode> parse(tao::TAO_PEGTL_NAMESPACE::string_input<>& in);
 
+//! same function as build_function(*parse(in)), built by the parser actions without intermediate parse tree.
+//! Throws the same parse_error on invalid input.
+std::unique_ptr<IScalarFunction> parse_function(tao::TAO_PEGTL_NAMESPACE::string_input<>& in);
+
 #endif  // LIBKRIGING_PARSER__GRAMMAR_HPP
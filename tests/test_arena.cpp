@@ -0,0 +1,93 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/AllocationCounter.hpp"
+#include "../src/ExpressionArena.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+TEST_CASE("Arena functions behave as heap functions", "[arena]") {
+  const std::string expression = GENERATE(as<std::string>{}, "exp(-0.5*dot(x,x))", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "x_0*x_1/(1+x_0)", "-exp(-norm2(x-2*x/dot(x,x)))");
+  const Vector x{0.5, -1, 2};
+
+  auto heap = build(expression);
+  auto heap_d = heap->diff(1, DiffOptions{true});
+
+  ExpressionArena arena;
+  {
+    ExpressionArena::Scope scope(arena);
+    auto f = build(expression);
+    auto d = f->diff(1, DiffOptions{true});
+    REQUIRE(ExpressionArena::owner(*f) == &arena);
+    REQUIRE(ExpressionArena::owner(*d) == &arena);
+    REQUIRE(f->string() == heap->string());
+    REQUIRE(d->string() == heap_d->string());
+    REQUIRE(f->apply(x) == heap->apply(x));
+    REQUIRE(d->apply(x) == heap_d->apply(x));
+    REQUIRE(dag_size(*d) == dag_size(*heap_d));
+    REQUIRE(arena.node_count() > 0);
+    REQUIRE(arena.allocated_bytes() >= arena.node_count() * sizeof(void*));
+  }
+  REQUIRE(ExpressionArena::current() == nullptr);
+}
+
+TEST_CASE("Heap derivatives of arena functions", "[arena]") {
+  ExpressionArena arena;
+  std::unique_ptr<IScalarFunction> f;
+  {
+    ExpressionArena::Scope scope(arena);
+    f = build("x_0*exp(x_1)");
+  }
+  auto d = f->diff(0);
+  REQUIRE(ExpressionArena::owner(*d) == nullptr);
+  REQUIRE(d->string() == build("x_0*exp(x_1)")->diff(0)->string());
+  REQUIRE(d->apply({2, 0}) == 1);
+}
+
+TEST_CASE("Heap nodes used by an arena are released with it", "[arena]") {
+  const std::size_t live = interned_count();
+  {
+    ScalarFunctionPtr heap = intern(build("exp(x_0)"));
+    ExpressionArena arena;
+    {
+      ExpressionArena::Scope scope(arena);
+      auto f = std::make_unique<ScalarFunctionPtr>(intern(build("x_1*exp(x_0)")));
+      (void)f;
+      REQUIRE(intern(heap) == heap);  // imported as is
+    }
+    REQUIRE(interned_count() > live);
+  }
+  REQUIRE(interned_count() == live);
+}
+
+TEST_CASE("Arena saves allocations", "[arena]") {
+  string_input in("dot(pi*x,x/e)*exp(-norm2(x)/x_1)", "from content");
+  auto tree = parse(in);  // refers to the input
+
+  const AllocationCounter heap;
+  {
+    ScalarFunctionPtr f = build_function(*tree);
+    for (Index i = 0; i < 3; ++i)
+      f = f->diff(i);
+  }
+  const std::size_t heap_allocations = heap.count().allocations;
+
+  const AllocationCounter in_arena;
+  {
+    ExpressionArena arena(1 << 16);
+    ExpressionArena::Scope scope(arena);
+    ScalarFunctionPtr f = build_function(*tree);
+    for (Index i = 0; i < 3; ++i)
+      f = f->diff(i);
+  }
+  const std::size_t arena_allocations = in_arena.count().allocations;
+
+  INFO("heap: " << heap_allocations << ", arena: " << arena_allocations);
+  REQUIRE(arena_allocations * 4 < heap_allocations);
+}
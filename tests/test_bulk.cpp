@@ -0,0 +1,52 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <sstream>
+#include "../src/BulkLoader.hpp"
+
+TEST_CASE("Catalogue records", "[bulk]") {
+  std::istringstream in("exp(2)\n\n# comment = 1\n k = exp(-0.5*dot(x-y,x-y)) \nexp(--2)\r\n");
+  const std::vector<CatalogueRecord> records = read_catalogue(in);
+  REQUIRE(records.size() == 3);
+  REQUIRE(records[0].line == 1);
+  REQUIRE(records[0].name.empty());
+  REQUIRE(records[0].expression == "exp(2)");
+  REQUIRE(records[1].line == 4);
+  REQUIRE(records[1].name == "k");
+  REQUIRE(records[1].expression == "exp(-0.5*dot(x-y,x-y))");
+  REQUIRE(records[2].line == 5);
+  REQUIRE(records[2].expression == "exp(--2)");
+}
+
+TEST_CASE("Catalogues are loaded in parallel and in order", "[bulk]") {
+  std::vector<CatalogueRecord> records;
+  for (Index k = 0; k < 1000; ++k) {
+    records.push_back({k + 1, "", (k % 100 == 7) ? "exp(--2)" : "exp(-0.5*dot(x,x))*" + std::to_string(k)});
+  }
+  const std::size_t concurrency = GENERATE(1, 4);
+  ThreadPool pool(concurrency);
+  const BulkLoad load = load_catalogue(records, pool, "catalogue");
+
+  REQUIRE(load.functions.size() == records.size());
+  REQUIRE(load.failures() == 10);
+  for (Index k = 0; k < records.size(); ++k) {
+    const LoadedFunction& loaded = load.functions[k];
+    if (k % 100 == 7) {
+      REQUIRE(!loaded.function);
+      // same report as main: position, expression and caret
+      REQUIRE(loaded.error.rfind("catalogue:" + std::to_string(k + 1) + ":1:", 0) == 0);
+      const std::string lines = loaded.error.substr(loaded.error.find('\n'));
+      REQUIRE(lines.rfind("\nexp(--2)\n", 0) == 0);
+      REQUIRE(lines.back() == '^');
+    } else {
+      REQUIRE(loaded.function->string() == records[k].expression);
+    }
+  }
+  REQUIRE(load.throughput() > 0);
+  REQUIRE(load.latency(0) <= load.latency(0.5));
+  REQUIRE(load.latency(0.5) <= load.latency(0.99));
+  REQUIRE(load.latency(0.99) <= load.latency(1));
+}
@@ -0,0 +1,112 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <thread>
+#include <tao/pegtl/string_input.hpp>
+#include "../src/ExpressionCache.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+TEST_CASE("Normalize expression text", "[cache]") {
+  REQUIRE(ExpressionCache::normalize(" exp( -0.5 * dot(x, x) )\t") == "exp(-0.5*dot(x,x))");
+  REQUIRE(ExpressionCache::normalize("x_0+x_1") == "x_0+x_1");
+  REQUIRE(ExpressionCache::normalize("1 2") == "1 2");  // still invalid once normalized
+}
+
+TEST_CASE("Cache hits, misses and evictions", "[cache]") {
+  ExpressionCache cache(2);
+  const Vector x{1, 2, 3};
+
+  auto f = cache.get("exp(-0.5 * dot(x,x))");
+  REQUIRE(f->function->apply(x) == exp(-0.5 * 14));
+  REQUIRE(f->derivatives.empty());
+  REQUIRE(cache.get("exp(-0.5*dot(x,x))") == f);
+  REQUIRE(cache.statistics().hits == 1);
+  REQUIRE(cache.statistics().misses == 1);
+
+  SECTION("derivatives are added on demand") {
+    auto df = cache.get("exp(-0.5*dot(x,x))", 3);
+    REQUIRE(df != f);
+    REQUIRE(df->function == f->function);
+    REQUIRE(df->derivatives.size() == 3);
+    for (std::size_t i = 0; i < 3; ++i) {
+      REQUIRE(df->derivatives[i]->apply(x) == Approx(-x[i] * exp(-0.5 * 14)));
+    }
+    REQUIRE(cache.get("exp(-0.5*dot(x,x))", 2) == df);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.statistics().misses == 2);
+  }
+
+  SECTION("least recently used entry is evicted") {
+    cache.get("x_1");
+    cache.get("exp(-0.5*dot(x,x))");  // now x_1 is the least recently used
+    cache.get("x_2");
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.statistics().evictions == 1);
+    REQUIRE(cache.get("exp(-0.5*dot(x,x))") == f);
+    const auto misses = cache.statistics().misses;
+    cache.get("x_1");
+    REQUIRE(cache.statistics().misses == misses + 1);
+    REQUIRE(f->function->apply(x) == exp(-0.5 * 14));  // evicted entries stay valid
+  }
+
+  SECTION("parse errors are not cached") {
+    REQUIRE_THROWS_AS(cache.get("2*(x_0"), parse_error);
+    REQUIRE(cache.size() == 1);
+  }
+
+  SECTION("parse errors refer to the expression as written") {
+    const std::string expression = "2 * ( x_0";
+    std::size_t expected = 0;  // byte of the error when parsed directly
+    try {
+      string_input in(expression, "cached expression");
+      (void)parse_function(in);
+    } catch (const parse_error& e) {
+      expected = e.positions.front().byte;
+    }
+    REQUIRE(expected > 0);
+    try {
+      cache.get(expression);
+      FAIL("parse error expected");
+    } catch (const parse_error& e) {
+      REQUIRE(e.positions.front().byte == expected);
+    }
+  }
+
+  SECTION("clear removes entries and statistics") {
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.statistics().hits == 0);
+    REQUIRE(cache.statistics().misses == 0);
+    REQUIRE(cache.get("exp(-0.5*dot(x,x))") != f);
+  }
+}
+
+TEST_CASE("Cache is shared between threads", "[cache]") {
+  ExpressionCache cache(4);
+  const std::vector<std::string> expressions{"x_0", "x_0*x_1", "dot(x,x)", "norm2(x)", "exp(x_2)", "2/exp(x_0)"};
+  const Vector x{1, 2, 3};
+
+  std::vector<std::thread> threads;
+  std::vector<Number> sums(4, 0);
+  for (std::size_t t = 0; t < sums.size(); ++t) {
+    threads.emplace_back([&, t] {
+      for (int r = 0; r < 240; ++r) {  // each thread uses every expression 40 times
+        const auto entry = cache.get(expressions[(t + r) % expressions.size()], 1);
+        sums[t] += entry->function->apply(x) + entry->derivatives[0]->apply(x);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  const auto statistics = cache.statistics();
+  REQUIRE(statistics.hits + statistics.misses == 960);
+  REQUIRE(cache.size() <= 4);
+  for (std::size_t t = 1; t < sums.size(); ++t) {
+    REQUIRE(sums[t] == Approx(sums[0]));
+  }
+}
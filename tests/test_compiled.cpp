@@ -0,0 +1,102 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "../src/CompiledFile.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE("Compiled files round trip", "[compiled]") {
+  const std::vector<std::string> expressions = {"2", "x_0*x_1-x_2/3", "exp(-0.5*dot(x,x))",
+                                                "dot(pi*x,x/e)*exp(-norm2(x)/x_1)", "exp(-dot(x-2*x,-x)/x_2/e)",
+                                                "norm2(x/x_0-x_2*x)/(1+x_1)"};
+  const std::vector<Vector> points = {{1, 2, 3}, {0.5, -1, 2}, {-3, 0.25, 1e-3}};
+  const std::string filename = "test_compiled_functions.lkp";
+
+  std::vector<CompiledFunction> compiled;
+  for (const std::string& expression : expressions) {
+    compiled.push_back(compile_function(expression, *build(expression), 3));
+  }
+  save_compiled(filename, compiled);
+  const std::vector<CompiledFunction> loaded = load_compiled(filename);
+  std::remove(filename.c_str());
+
+  REQUIRE(loaded.size() == expressions.size());
+  for (std::size_t k = 0; k < expressions.size(); ++k) {
+    const auto f = build(expressions[k]);
+    INFO("loaded " << expressions[k]);
+    REQUIRE(loaded[k].expression == expressions[k]);
+    REQUIRE(loaded[k].function.string() == compiled[k].function.string());
+    REQUIRE(loaded[k].derivatives.size() == 3);
+    const Tape tape = compile(*f);
+    for (const Vector& x : points) {
+      REQUIRE(loaded[k].function.apply(x) == tape.apply(x));
+      REQUIRE(loaded[k].function.apply(x) == Approx(f->apply(x)));
+      REQUIRE(loaded[k].function.gradient(x) == tape.gradient(x));
+      for (Index i = 0; i < 3; ++i) {
+        const auto derivative = f->diff(i, DiffOptions{true});
+        REQUIRE(loaded[k].derivatives[i].apply(x) == compile(*derivative).apply(x));
+        REQUIRE(loaded[k].derivatives[i].apply(x) == Approx(derivative->apply(x)));
+      }
+    }
+  }
+}
+
+TEST_CASE("Invalid compiled files are rejected", "[compiled]") {
+  const std::string filename = "test_compiled_invalid.lkp";
+  save_compiled(filename, {compile_function("x_0*x_1", *build("x_0*x_1"), 2)});
+  std::string content;
+  {
+    std::ifstream in(filename, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto rewrite = [&](const std::string& data) { std::ofstream(filename, std::ios::binary) << data; };
+
+  SECTION("truncated") {
+    rewrite(content.substr(0, content.size() - 8));
+    REQUIRE_THROWS_AS(load_compiled(filename), std::runtime_error);
+  }
+  SECTION("other format version") {
+    std::string modified = content;
+    modified[8] = 2;
+    rewrite(modified);
+    REQUIRE_THROWS_AS(load_compiled(filename), std::runtime_error);
+  }
+  SECTION("oversized counts") {
+    // header (24 bytes), expression length and characters (16), tape count (8), then the first tape header
+    for (const std::size_t offset : {48, 52}) {  // instruction count, constant count
+      std::string modified = content;
+      modified.replace(offset, 4, "\xff\xff\xff\x7f");
+      rewrite(modified);
+      REQUIRE_THROWS_AS(load_compiled(filename), std::runtime_error);
+      rewrite(modified.substr(0, 72));  // truncated after the first tape header
+      REQUIRE_THROWS_AS(load_compiled(filename), std::runtime_error);
+    }
+  }
+  SECTION("register out of range") {
+    std::string modified = content;
+    modified[modified.size() - 9] = 127;  // last instruction of the last tape (it has no constant)
+    rewrite(modified);
+    REQUIRE_THROWS_AS(load_compiled(filename), std::runtime_error);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("Compiled functions check the dimension of the points", "[compiled]") {
+  const std::string filename = "test_compiled_dimension.lkp";
+  save_compiled(filename, {compile_function("x_0*x_4", *build("x_0*x_4"), 5)});
+  const std::vector<CompiledFunction> loaded = load_compiled(filename);
+  std::remove(filename.c_str());
+
+  REQUIRE(loaded[0].function.dimension() == 5);
+  REQUIRE(loaded[0].function.apply({1, 2, 3, 4, 5}) == 5);
+  REQUIRE_THROWS_AS(loaded[0].function.apply({1, 2}), std::invalid_argument);
+  REQUIRE_THROWS_AS(loaded[0].function.gradient({1, 2}), std::invalid_argument);
+  REQUIRE_THROWS_AS(loaded[0].derivatives[0].apply({1, 2}), std::invalid_argument);  // x_4
+  REQUIRE(loaded[0].derivatives[4].apply({3, 2}) == 3);                                // x_0
+}
@@ -0,0 +1,84 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include "../src/KernelMatrix.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+namespace {
+VectorBlock points(const Index dimension, const Index count, const Number shift) {
+  VectorBlock block(dimension, count);
+  for (std::size_t k = 0; k < block.data.size(); ++k) {
+    block.data[k] = std::sin(0.37 * k + shift) * 2;
+  }
+  return block;
+}
+}  // namespace
+
+TEST_CASE("Functions of x and y", "[covariance]") {
+  const Vector x{1, 2, 3};
+  const Vector y{-1, 0.5, 2};
+
+  SECTION("echo and evaluation") {
+    const auto k = build("exp(-0.5*dot(x-y,x-y))+x_0*y_1");
+    REQUIRE(k->string() == "exp(-0.5*dot(x-y,x-y))+x_0*y_1");
+    REQUIRE(k->apply(x, y) == Approx(exp(-0.5 * (4 + 2.25 + 1)) + 1 * 0.5));
+    REQUIRE(compile(*k).apply(x, y) == k->apply(x, y));
+    const Tape& tape = k->tape();
+    REQUIRE(k->apply(y, x) == tape.apply(y, x));
+    REQUIRE(&k->tape() == &tape);  // compiled once
+    REQUIRE_THROWS_AS(k->apply(x), NotImplementedException);
+    REQUIRE_THROWS_AS(compile(*k).apply(x), std::invalid_argument);
+    REQUIRE_THROWS_AS(compile(*k).apply(x, Vector{1, 2}), std::invalid_argument);
+  }
+
+  SECTION("y is constant for diff") {
+    const auto k = build("dot(x,y)*y_2");
+    REQUIRE(dependencies(*k).all);
+    REQUIRE(dependencies(*build("y_0*norm2(y)")).empty());
+    REQUIRE(k->diff(1, DiffOptions{true})->string() == "y_1*y_2");
+    REQUIRE(build("y_0*norm2(y)")->diff(0)->string() == "0");
+  }
+}
+
+TEST_CASE("Kernel matrices match pairwise evaluation", "[covariance]") {
+  const auto k = build("exp(-0.5*norm2(x-y)/2)*(1+dot(x,y)/10)");
+  const Tape tape = compile(*k);
+  const VectorBlock x = points(3, 37, 0);
+  const VectorBlock y = points(3, 23, 1);
+  const std::size_t concurrency = GENERATE(1, 4);
+  const Index tile = GENERATE(1, 8, 64);
+  ThreadPool pool(concurrency);
+  const KernelMatrix builder(*k, pool, tile);
+
+  SECTION("two point sets") {
+    const VectorBlock matrix = builder.build(x, y);
+    REQUIRE(matrix.dimension == x.count);
+    REQUIRE(matrix.count == y.count);
+    for (Index p = 0; p < x.count; ++p) {
+      for (Index q = 0; q < y.count; ++q) {
+        REQUIRE(matrix.component(p)[q] == tape.apply(x.point(p), y.point(q)));
+      }
+    }
+  }
+
+  SECTION("one point set: symmetric") {
+    const VectorBlock matrix = builder.build(x);
+    REQUIRE(matrix.dimension == x.count);
+    REQUIRE(matrix.count == x.count);
+    for (Index p = 0; p < x.count; ++p) {
+      for (Index q = p; q < x.count; ++q) {
+        REQUIRE(matrix.component(p)[q] == tape.apply(x.point(p), x.point(q)));
+        REQUIRE(matrix.component(q)[p] == matrix.component(p)[q]);
+      }
+    }
+  }
+
+  SECTION("errors") {
+    REQUIRE_THROWS_AS(builder.build(x, points(2, 5, 0)), std::invalid_argument);
+    REQUIRE_THROWS_AS(KernelMatrix(*k, pool, 0), std::invalid_argument);
+  }
+}
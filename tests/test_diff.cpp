@@ -4,8 +4,12 @@
 // doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
 // More example in https://github.com/catchorg/Catch2/tree/master/examples
 
+#include <cmath>
+#include <limits>
 #include <tao/pegtl/string_input.hpp>
+#include "../src/Tape.hpp"
 #include "../src/grammar.hpp"
+#include "test_helpers.hpp"
 using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
 
 TEST_CASE("Derivate expression, echo and eval", "[diff][echo]") {
@@ -30,15 +34,15 @@ TEST_CASE("Derivate expression, echo and eval", "[diff][echo]") {
       record{"2*x_0", "2*1+0*x_0", 2},
       record{"x_0*x_1", "x_0*0+1*x_1", x[1]},
       record{"(-x_0)*(+x_0)", "(-x_0)*1+(-1)*(+x_0)", -2 * x[0]},
-      record{"+x_0+2+e", "1+0+0", 1},
-      record{"-x_0-2-pi", "-1-0-0", -1},
-      record{"(x_0+x_1)*(x_0-x_1)", "(x_0+x_1)*(1-0)+(1+0)*(x_0-x_1)", 2 * x[0]},
-      record{"x_0*x_0+x_1*x_1", "x_0*1+1*x_0+x_1*0+0*x_1", 2 * x[diff_index]},
+      record{"+x_0+2+e", "1", 1},
+      record{"-x_0-2-pi", "-1", -1},
+      record{"(x_0+x_1)*(x_0-x_1)", "(x_0+x_1)*1+1*(x_0-x_1)", 2 * x[0]},
+      record{"x_0*x_0+x_1*x_1", "x_0*1+1*x_0", 2 * x[diff_index]},
       record{"dot(x,x)", "dot(<x_0=1>,x)+dot(x,<x_0=1>)", 2 * x[diff_index]},
       record{"norm2(x)", "2*dot(<x_0=1>,x)", 2 * x[diff_index]},
       record{
           "norm2(x)*norm2(-x)", "norm2(x)*2*dot(-<x_0=1>,-x)+2*dot(<x_0=1>,x)*norm2(-x)", 4 * norm2(x) * x[diff_index]},
-      record{"dot(-x,+x)", "dot(-<x_0=1>,x)+dot(-x,<x_0=1>)", -2},
+      record{"dot(-x,+x)", "dot(-<x_0=1>,+x)+dot(-x,<x_0=1>)", -2},
       record{"dot(x-x,x+x)", "dot(<x_0=1>-<x_0=1>,x+x)+dot(x-x,<x_0=1>+<x_0=1>)", 0},
       record{"2/exp(x_0)", "(exp(x_0)*0-exp(x_0)*1*2)/(exp(x_0)*exp(x_0))", -2 * exp(-x[0])},
       record{"dot(pi*x,x/e)", "dot(pi*<x_0=1>+0*x,x/e)+dot(pi*x,(e*<x_0=1>-0*x)/(e*e))", 2 * pi * x[0] / e},
@@ -56,7 +60,7 @@ TEST_CASE("Derivate expression, echo and eval", "[diff][echo]") {
     try {
       const auto root = parse(in);
       std::unique_ptr<IScalarFunction> f = build_function(*root);
-      std::unique_ptr<IScalarFunction> df = f->diff(diff_index);
+      ScalarFunctionPtr df = f->diff(diff_index);
       INFO("diff_0 of " << expression << " should be " << expected_diff);
       REQUIRE(df->string() == expected_diff);
       INFO("eval of diff_0 of " << expression << " should be " << expected_diff_value);
@@ -89,8 +93,7 @@ TEST_CASE("Multi derivative expression, echo and eval", "[diff][echo]") {
           record{"dot(x,x)",  // special for testing <x_i=0> internal expression
                  "dot(<x_0=1>,x)+dot(x,<x_0=1>)",
                  "dot(<x_i=0>,x)+dot(<x_0=1>,<x_0=1>)+dot(<x_0=1>,<x_0=1>)+dot(x,<x_i=0>)",
-                 "dot(<x_i=0>,x)+dot(<x_i=0>,<x_0=1>)+dot(<x_i=0>,<x_0=1>)+dot(<x_0=1>,<x_i=0>)+dot(<x_i=0>,<x_0=1>)+"
-                 "dot(<x_0=1>,<x_i=0>)+dot(<x_0=1>,<x_i=0>)+dot(x,<x_i=0>)",
+                 "dot(<x_i=0>,x)+dot(<x_i=0>,<x_0=1>)+dot(<x_0=1>,<x_i=0>)+dot(x,<x_i=0>)",
                  0},
           record{"0", "0", "0", "0", 0}
           //
@@ -101,13 +104,13 @@ TEST_CASE("Multi derivative expression, echo and eval", "[diff][echo]") {
     try {
       const auto root = parse(in);
       std::unique_ptr<IScalarFunction> f = build_function(*root);
-      std::unique_ptr<IScalarFunction> df = f->diff(diff_index);
+      ScalarFunctionPtr df = f->diff(diff_index);
       INFO("diff_0 of " << expression << " should be " << expected_diff);
       REQUIRE(df->string() == expected_diff);
-      std::unique_ptr<IScalarFunction> ddf = df->diff(diff_index);
+      ScalarFunctionPtr ddf = df->diff(diff_index);
       INFO("diff_0_0 of " << expression << " should be " << expected_diff_diff);
       REQUIRE(ddf->string() == expected_diff_diff);
-      std::unique_ptr<IScalarFunction> dddf = ddf->diff(diff_index);
+      ScalarFunctionPtr dddf = ddf->diff(diff_index);
       INFO("diff_0_0_0 of " << expression << " should be " << expected_diff_diff_diff);
       REQUIRE(dddf->string() == expected_diff_diff_diff);
       INFO("eval of diff_0_0 of " << expression << " should be " << expected_diff_diff_diff_value);
@@ -121,3 +124,204 @@ TEST_CASE("Multi derivative expression, echo and eval", "[diff][echo]") {
     }
   }
 }
+
+
+TEST_CASE("Reverse mode gradient matches symbolic derivatives", "[diff][gradient]") {
+  const Vector x{1, 2, 3};
+
+  auto expression = GENERATE("2", "x_1", "x_0*x_1", "(-x_0)*(+x_0)", "(x_0+x_1)*(x_0-x_2)", "dot(x,x)", "norm2(x)",
+                             "norm2(x)*norm2(-x)", "dot(-x,+x)", "dot(x-x,x+x)", "2/exp(x_0)", "dot(pi*x,x/e)",
+                             "exp(-0.5 * dot(x,x))", "dot(x_1*x,x/x_2)", "norm2(x/x_0-x_2*x)/(1+x_1)",
+                             "exp(-norm2(x-2*x/dot(x,x)))");
+
+  SECTION(expression) {
+    string_input in(expression, "valid input expression");
+    const auto root = parse(in);
+    std::unique_ptr<IScalarFunction> f = build_function(*root);
+    const Vector gradient = f->gradient(x);
+    REQUIRE(gradient.size() == x.size());
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      INFO("diff_" << i << " of " << expression);
+      REQUIRE(gradient[i] == Approx(f->diff(i)->apply(x)).margin(1e-14));
+    }
+    const Tape& tape = f->tape();
+    REQUIRE(f->gradient({3, 2, 1}) == tape.gradient({3, 2, 1}));
+    REQUIRE(&f->tape() == &tape);  // compiled once
+  }
+}
+
+TEST_CASE("Forward mode tangents match gradient", "[diff][tangent]") {
+  const Vector x{1, 2, 3};
+  const std::vector<Vector> directions{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0.5, -1, 2}};
+
+  auto expression = GENERATE("2", "pi", "x_1", "(-x_0)*(+x_0)", "(x_0+x_1)*(x_0-x_2)", "+x_0+2+e", "dot(x,x)",
+                             "norm2(x)*norm2(-x)", "dot(x-x,x+x)", "2/exp(x_0)", "dot(pi*x,x/e)",
+                             "exp(-0.5 * dot(x,x))", "dot(x_1*x,x/x_2)", "norm2(x/x_0-x_2*x)/(1+x_1)",
+                             "exp(-norm2(x-2*x/dot(x,x)))");
+
+  SECTION(expression) {
+    string_input in(expression, "valid input expression");
+    const auto root = parse(in);
+    std::unique_ptr<IScalarFunction> f = build_function(*root);
+    const Number value = f->apply(x);
+    const Vector gradient = f->gradient(x);
+
+    const Tangents tangents = f->apply_tangents(x, VectorBlock::from_points(directions));
+    REQUIRE(tangents.value == value);
+    REQUIRE(tangents.derivatives.size() == directions.size());
+    for (std::size_t p = 0; p < directions.size(); ++p) {
+      const Vector& v = directions[p];
+      const Number expected = gradient[0] * v[0] + gradient[1] * v[1] + gradient[2] * v[2];
+      INFO("derivative of " << expression << " along direction " << p);
+      const Tangent tangent = f->apply_tangent(x, v);
+      REQUIRE(tangent.value == value);
+      REQUIRE(tangent.derivative == Approx(expected).margin(1e-14));
+      REQUIRE(tangents.derivatives[p] == Approx(tangent.derivative).margin(1e-14));
+    }
+  }
+}
+
+
+TEST_CASE("Derivatives share structurally identical subexpressions", "[diff][dag]") {
+  SECTION("identical expressions are built from the same nodes") {
+    const auto f = build("dot(x,x/e)*exp(x_0)");
+    const auto g = build("dot(x,x/e)*exp(x_0)");
+    REQUIRE(f.get() != g.get());
+    REQUIRE(f->key() == g->key());
+  }
+
+  SECTION("repeated differentiation does not duplicate operands") {
+    const auto f = build("2/exp(x_0)+dot(x_1*x,x/x_2)");
+    ScalarFunctionPtr df = f->diff(0);
+    for (std::size_t order = 2; order <= 3; ++order) {
+      df = df->diff(order - 1);
+      INFO("derivative of order " << order);
+      REQUIRE(dag_size(*df) < tree_size(*df));
+    }
+    REQUIRE(tree_size(*f) == dag_size(*f) + 4);  // x is used 5 times
+  }
+}
+
+
+TEST_CASE("Simplify derivatives", "[diff][simplify]") {
+  using record = std::tuple<char const*, char const*>;
+  const Vector x{1, 2, 3};
+  const std::size_t diff_index = 0;
+
+  auto [expression, expected_simplified_diff] = GENERATE(table<char const*, const char*>({
+      // set of (expression, expected simplified derivative)
+      record{"2", "0"},
+      record{"x_1", "0"},
+      record{"2*x_0", "2"},
+      record{"x_0*x_1", "x_1"},
+      record{"(-x_0)*(+x_0)", "-x_0-x_0"},
+      record{"-x_0-2-pi", "-1"},
+      record{"(x_0+x_1)*(x_0-x_1)", "x_0+x_1+x_0-x_1"},
+      record{"dot(x,x)", "x_0+x_0"},
+      record{"norm2(x)", "2*x_0"},
+      record{"norm2(x)*norm2(-x)", "norm2(x)*2*x_0+2*x_0*norm2(x)"},
+      record{"dot(-x,+x)", "-x_0-x_0"},
+      record{"dot(x-x,x+x)", "0"},
+      record{"2/exp(x_0)", "-(exp(x_0)*2)/(exp(x_0)*exp(x_0))"},
+      record{"dot(pi*x,x/e)", "dot(pi*<x_0=1>,x/e)+dot(pi*x,(e*<x_0=1>)/(e*e))"},
+      record{"exp(x_0)", "exp(x_0)"},
+      record{"exp(-0.5 * dot(x,x))", "-exp(-0.5*dot(x,x))*0.5*(x_0+x_0)"},
+      record{"3*2*x_0-x_1/4", "6"}
+      //
+  }));
+
+  SECTION(expression) {
+    string_input in(expression, "valid input expression");
+    const auto root = parse(in);
+    std::unique_ptr<IScalarFunction> f = build_function(*root);
+    ScalarFunctionPtr df = f->diff(diff_index);
+    ScalarFunctionPtr sdf = f->diff(diff_index, DiffOptions{true});
+    INFO("simplified diff_0 of " << expression << " should be " << expected_simplified_diff);
+    REQUIRE(sdf->string() == expected_simplified_diff);
+    REQUIRE(df->simplify()->string() == expected_simplified_diff);
+    REQUIRE(dag_size(*sdf) <= dag_size(*df));
+    REQUIRE(sdf->apply(x) == Approx(df->apply(x)));
+    REQUIRE(sdf->diff(1, DiffOptions{true})->apply(x) == Approx(df->diff(1)->apply(x)));
+  }
+}
+
+TEST_CASE("Simplify assumes finite operands", "[diff][simplify]") {
+  const Number inf = std::numeric_limits<Number>::infinity();
+  const Vector x{inf, 2};
+
+  for (const char* expression : {"0*x_0", "x_0-x_0", "x_0*x_1-x_0*x_1"}) {
+    INFO(expression);
+    const auto f = build(expression);
+    const auto simplified = f->simplify();
+    REQUIRE(simplified->string() == "0");
+    REQUIRE(std::isnan(f->apply(x)));
+    REQUIRE(simplified->apply(x) == 0);
+  }
+  REQUIRE(std::isnan(build("0/x_0")->apply({0, 2})));
+  REQUIRE(build("0/x_0")->simplify()->apply({0, 2}) == 0);
+}
+
+TEST_CASE("Derivatives along independent coordinates are zero at once", "[diff][dependencies]") {
+  SECTION("dependency masks") {
+    REQUIRE(build("2*pi")->dependency_mask().empty());
+    REQUIRE(build("x_0*x_1")->may_depend_on(1));
+    REQUIRE(!build("x_0*x_1")->may_depend_on(2));
+    REQUIRE(!build("x_0*x_1")->may_depend_on(64));  // same bit as x_0, out of range
+    REQUIRE(build("exp(x_2)+dot(x,x)")->may_depend_on(1000));
+    REQUIRE(build("exp(x_2)+dot(x,x)")->diff(1000)->string() == "dot(<x_1000=1>,x)+dot(x,<x_1000=1>)");
+  }
+
+  SECTION("sparse sum") {
+    const Index dimension = 10000;
+    std::string expression = "x_0*x_0";
+    for (Index k = 10; k < dimension; k += 10)
+      expression += "+x_" + std::to_string(k) + "*x_" + std::to_string(k);
+    const auto f = build(expression);
+
+    const Dependencies variables = dependencies(*f);
+    REQUIRE(variables.indices.size() == dimension / 10);
+    for (Index i = 0; i < dimension; ++i) {
+      const auto d = f->diff(i);
+      INFO("diff_" << i);
+      if (variables.contains(i)) {
+        REQUIRE(d->string() == "x_" + std::to_string(i) + "*1+1*x_" + std::to_string(i));
+      } else {
+        REQUIRE(d == zero_function());  // shared, not a new constant
+      }
+    }
+    REQUIRE(zero_function() == zero_function());
+
+    const std::vector<ScalarFunctionPtr> gradient = partial_derivatives(*f, 0, dimension);
+    REQUIRE(gradient.size() == dimension);
+    for (Index i = 0; i < dimension; ++i) {
+      INFO("partial derivative " << i);
+      REQUIRE(gradient[i] == f->diff(i));  // interned: the same node
+    }
+  }
+
+  SECTION("partial derivatives of sums and differences") {
+    const std::string expression = GENERATE(as<std::string>{}, "2-x_0", "x_0*x_1-x_2/3", "x_2-x_0-x_1+exp(x_0)",
+                                            "exp(-0.5*dot(x,x))+x_1-x_1*x_2", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)");
+    const auto f = build(expression);
+    const Vector x{0.5, -1, 2, 0.25};
+    for (const bool simplify : {false, true}) {
+      const std::vector<ScalarFunctionPtr> gradient = partial_derivatives(*f, 1, 4, DiffOptions{simplify});
+      REQUIRE(gradient.size() == 3);
+      for (Index i = 1; i < 4; ++i) {
+        INFO(expression << ", partial derivative " << i << (simplify ? " simplified" : ""));
+        const ScalarFunctionPtr d = f->diff(i, DiffOptions{simplify});
+        REQUIRE(gradient[i - 1]->string() == d->string());
+        REQUIRE(gradient[i - 1]->apply(x) == d->apply(x));
+      }
+    }
+  }
+
+  SECTION("terms sharing a bit of the dependency mask") {
+    // x_84 and x_20 fall on the same bit: the derivative of x_84*x_84 along x_20 is the shared zero all the same
+    const auto f = build("x_0*x_0+x_84*x_84+x_20*x_20");
+    REQUIRE(f->diff(20)->string() == "x_20*1+1*x_20");
+    REQUIRE(partial_derivatives(*f, 20, 21)[0] == f->diff(20));
+    REQUIRE(build("x_84*x_84-x_20*x_20")->diff(20)->string() == "0-x_20*1+1*x_20");
+    REQUIRE(build("x_20*x_20-x_84*x_84")->diff(20)->string() == "x_20*1+1*x_20");
+  }
+}
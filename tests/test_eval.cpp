@@ -8,7 +8,10 @@
 // doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
 // More example in https://github.com/catchorg/Catch2/tree/master/examples
 
+#include <filesystem>
 #include <tao/pegtl/string_input.hpp>
+#include "../src/NativeFunction.hpp"
+#include "../src/Tape.hpp"
 #include "../src/grammar.hpp"
 using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
 
@@ -55,3 +58,93 @@ TEST_CASE("Evaluate expression", "[eval]") {
   }
 }
 
+
+TEST_CASE("Evaluate expression on a block of points", "[eval][batch]") {
+  const std::vector<Vector> points{{1, 2, 3}, {-1, 0.5, 2}, {0, 0, 0}, {3, -2, 1e-3}, {0.25, 8, -4}};
+  const VectorBlock block = VectorBlock::from_points(points);
+
+  auto expression = GENERATE("2",
+                             "2-(2./6+2)*4",
+                             "-(+2)",
+                             "pi*e",
+                             "dot(x,x)",
+                             "norm2(x)",
+                             "norm2(x+x)",
+                             "dot(x-x,x+x*2)",
+                             "dot(-x,+x)",
+                             "x_0*x_1-x_2/3",
+                             "exp(-dot(x-2*x,-x)/(x_2+5)/e)",
+                             "dot(pi*x,x/e)");
+
+  SECTION(expression) {
+    string_input in(expression, "valid input expression");
+    const auto root = parse(in);
+    std::unique_ptr<IScalarFunction> f = build_function(*root);
+    ScalarFunctionPtr df = f->diff(0);
+    const Vector values = f->apply_batch(block);
+    const Vector diff_values = df->apply_batch(block);
+    REQUIRE(values.size() == points.size());
+    REQUIRE(diff_values.size() == points.size());
+    for (std::size_t p = 0; p < points.size(); ++p) {
+      INFO("evaluation of " << expression << " at point " << p);
+      REQUIRE(block.point(p) == points[p]);
+      REQUIRE(values[p] == f->apply(points[p]));
+      REQUIRE(diff_values[p] == df->apply(points[p]));
+    }
+  }
+}
+
+TEST_CASE("Structured vector values", "[eval][sparse]") {
+  const Vector x{1, -2, 3, 4};
+  const VectorValue dense = VectorValue::view(x.data(), x.size());
+  const VectorValue e1 = VectorValue::one_hot(4, 1);
+  const VectorValue zero = VectorValue::zero(4);
+
+  REQUIRE(VectorValue::dot(e1, dense) == -2);
+  REQUIRE(VectorValue::dot(zero, dense) == 0);
+  REQUIRE(VectorValue::add(e1, zero).kind() == VectorValue::Kind::Sparse);
+  REQUIRE(VectorValue::add(e1, VectorValue::one_hot(4, 3)).stored() == 2);
+  REQUIRE(VectorValue::sub(e1, e1).dense() == Vector{0, 0, 0, 0});
+  REQUIRE(VectorValue::scale(3, e1)[1] == 3);
+  REQUIRE(VectorValue::scale_divide(e1, 2).dense() == Vector{0, 0.5, 0, 0});
+  REQUIRE(VectorValue::sub(e1, dense).dense() == Vector{-1, 3, -3, -4});
+  REQUIRE(VectorValue::add(dense, VectorValue::negate(e1)).dense() == Vector{1, -3, 3, 4});
+  REQUIRE(VectorValue::dot(VectorValue::add(e1, zero), VectorValue::one_hot(4, 1)) == 1);
+
+  SECTION("symbolic gradient of norm2 in large dimension") {
+    string_input in("exp(-0.5*norm2(x))", "from content");
+    auto f = build_function(*parse(in));
+    const Vector y(10000, 0.01);
+    for (Index i : {Index{0}, Index{4242}, Index{9999}}) {
+      auto d = f->diff(i);
+      REQUIRE(d->apply(y) == Approx(-0.01 * f->apply(y)));
+    }
+  }
+}
+
+TEST_CASE("Every evaluation path gives the same non-finite values", "[eval][sparse]") {
+  const Number inf = std::numeric_limits<Number>::infinity();
+  const Number nan = std::numeric_limits<Number>::quiet_NaN();
+  auto same = [](const Number a, const Number b) { return (std::isnan(a) && std::isnan(b)) || a == Approx(b); };
+  const std::string expression = GENERATE(as<std::string>{}, "dot(x,x)", "exp(-0.5*dot(x,x))", "norm2(x)*x_0",
+                                          "dot(x/x_0,x)", "x_1*dot(x,x)", "norm2(x_2*x-x)");
+  string_input in(expression, "from content");
+  const auto f = build_function(*parse(in));
+  NativeOptions options;
+  options.cache_directory = (std::filesystem::temp_directory_path() / "libkriging-parser-test-native").string();
+
+  for (Index i = 0; i < 3; ++i) {
+    const auto d = f->diff(i);  // structural zeros (one-hot and zero vectors) meet the non-finite entries
+    const Tape tape = compile(*d);
+    const NativeFunction native(*d, options);
+    for (const Vector& x : {Vector{1, inf, 2}, Vector{1, nan, 2}, Vector{0, 1, 2}, Vector{-inf, 1, 0}}) {
+      const Number value = d->apply(x);
+      INFO("d/dx_" << i << " of " << expression << " at x_1 = " << x[1] << " is " << value);
+      Workspace workspace;
+      REQUIRE(same(d->apply(x, workspace), value));
+      REQUIRE(same(d->apply_batch(VectorBlock::from_points({x}))[0], value));
+      REQUIRE(same(tape.apply(x), value));
+      REQUIRE(same(native.apply(x), value));
+    }
+  }
+}
@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include "../src/KernelMatrix.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE("Kernel shapes are fused into single nodes", "[fusion]") {
+  using record = std::tuple<char const*, char const*, std::size_t>;
+
+  auto [expression, fused, size] = GENERATE(table<char const*, char const*, std::size_t>({
+      // set of (expression, fused form, its dag_size)
+      record{"exp(-0.5*dot(x-y,x-y))", "exp(-0.5*dot(x-y,x-y))", 4},
+      record{"2*exp(-norm2(x-y)/2)", "2*exp(-0.5*dot(x-y,x-y))", 4},
+      record{"exp(-norm2(x))", "exp(-dot(x,x))", 3},
+      record{"dot(x,y)/4", "0.25*dot(x,y)", 3},
+      record{"-norm2(x)", "-dot(x,x)", 2},
+      record{"norm2(2*x-2*y)", "4*dot(x-y,x-y)", 3},
+      record{"exp(x_0)+dot(x,y)", "exp(x_0)+dot(x,y)", 6},
+      record{"dot(x,2*x-x/e)", "dot(x,2*x-x/e)", 7},
+  }));
+
+  SECTION(expression) {
+    const auto f = build(expression)->fuse();
+    REQUIRE(f->string() == std::string{fused});
+    REQUIRE(dag_size(*f) == size);
+    // already fused
+    REQUIRE(intern(f->fuse()) == intern(f->clone()));
+  }
+}
+
+TEST_CASE("Fused functions match the original ones", "[fusion]") {
+  const Vector x{0.3, -1.2, 0.7};
+  VectorBlock directions(3, 2);
+  for (std::size_t k = 0; k < directions.data.size(); ++k) {
+    directions.data[k] = 0.1 * k - 0.2;
+  }
+  const VectorBlock points = VectorBlock::from_points({x, {1, 2, 3}, {-1, 0.5, 2}});
+
+  auto expression = GENERATE("exp(-0.5*dot(x,x))", "norm2(x)", "2*exp(-norm2(x)/2)", "-dot(x,x)/4+x_1",
+                             "exp(-norm2(x/3))*3", "dot(-x,x)", "exp(dot(x,x)*pi)", "norm2(x-x)+dot(x,x-x)");
+
+  SECTION(expression) {
+    const auto f = build(expression);
+    const auto fused = f->fuse();
+    REQUIRE(fused->apply(x) == Approx(f->apply(x)));
+    REQUIRE(compile(*fused).apply(x) == fused->apply(x));
+
+    const Vector gradient = compile(*f).gradient(x);
+    const Vector fused_gradient = compile(*fused).gradient(x);
+    for (Index i = 0; i < x.size(); ++i) {
+      REQUIRE(fused->diff(i)->apply(x) == Approx(f->diff(i)->apply(x)));
+      REQUIRE(fused_gradient[i] == Approx(gradient[i]));
+      REQUIRE(fused->diff(i)->diff(1)->apply(x) == Approx(f->diff(i)->diff(1)->apply(x)));
+    }
+
+    const Vector batch = f->apply_batch(points);
+    const Vector fused_batch = fused->apply_batch(points);
+    for (Index p = 0; p < points.count; ++p) {
+      REQUIRE(fused_batch[p] == Approx(batch[p]));
+    }
+
+    const Tangent tangent = f->apply_tangent(x, directions.point(1));
+    const Tangent fused_tangent = fused->apply_tangent(x, directions.point(1));
+    REQUIRE(fused_tangent.value == Approx(tangent.value));
+    REQUIRE(fused_tangent.derivative == Approx(tangent.derivative));
+    const Tangents tangents = f->apply_tangents(x, directions);
+    const Tangents fused_tangents = fused->apply_tangents(x, directions);
+    REQUIRE(fused_tangents.value == Approx(tangents.value));
+    for (Index p = 0; p < directions.count; ++p) {
+      REQUIRE(fused_tangents.derivatives[p] == Approx(tangents.derivatives[p]));
+    }
+  }
+}
+
+TEST_CASE("Fused kernels of x and y", "[fusion]") {
+  const Vector x{1, 2, 3};
+  const Vector y{-1, 0.5, 2};
+
+  SECTION("one pass over the coordinates") {
+    const auto k = build("exp(-0.5*dot(x-y,x-y))")->fuse();
+    const Tape tape = compile(*k);
+    REQUIRE(tape.string() == "v1 = y\ns0 = sqdist x v1\ns1 = const -0.5\ns2 = mul s1 s0\ns3 = exp s2\nreturn s3\n");
+    REQUIRE(tape.apply(x, y) == Approx(exp(-0.5 * (4 + 2.25 + 1))));
+    REQUIRE_THROWS_AS(k->apply(x), NotImplementedException);
+  }
+
+  SECTION("derivatives stay fused") {
+    const auto k = build("exp(-0.5*dot(x-y,x-y))")->fuse();
+    REQUIRE(k->diff(0)->string() == "exp(-0.5*dot(x-y,x-y))*(-(x_0-y_0))");
+    REQUIRE(build("norm2(x-y)/4")->fuse()->diff(2)->string() == "0.5*(x_2-y_2)");
+    REQUIRE(build("dot(x,y)")->fuse()->diff(1)->string() == "y_1");
+    REQUIRE(build("dot(y,y)")->fuse()->diff(1)->string() == "0");
+
+    // the derivative shares the kernel node and adds O(1) nodes, whatever the dimension
+    const auto derivative = k->diff(1000);
+    REQUIRE(dag_size(*derivative) == dag_size(*k) + 5);
+  }
+
+  SECTION("same values as the original kernels") {
+    auto expression = GENERATE("exp(-norm2(x-y)/2)*(1+dot(x,y)/10)", "dot(x-y,x)", "dot(y,x-y)*2", "norm2(y-x)",
+                               "-dot(2*x,y/3)");
+    const auto k = build(expression);
+    const auto fused = k->fuse();
+    REQUIRE(compile(*fused).apply(x, y) == Approx(compile(*k).apply(x, y)));
+    for (Index i = 0; i < x.size(); ++i) {
+      REQUIRE(compile(*fused->diff(i)).apply(x, y) == Approx(compile(*k->diff(i)).apply(x, y)));
+    }
+  }
+
+  SECTION("kernel matrices") {
+    const auto k = build("exp(-norm2(x-y)/2)");
+    const auto fused = k->fuse();
+    ThreadPool pool(2);
+    const VectorBlock points = VectorBlock::from_points({x, y, {0, 0, 1}, {2, -1, 0.5}});
+    const VectorBlock matrix = KernelMatrix(*k, pool, 2).build(points);
+    const VectorBlock fused_matrix = KernelMatrix(*fused, pool, 2).build(points);
+    for (std::size_t e = 0; e < matrix.data.size(); ++e) {
+      REQUIRE(fused_matrix.data[e] == Approx(matrix.data[e]));
+    }
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef LIBKRIGING_PARSER__TEST_HELPERS_HPP
+#define LIBKRIGING_PARSER__TEST_HELPERS_HPP
+
+#include <memory>
+#include <string>
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/grammar.hpp"
+
+//! function of a valid expression, through its parse tree
+inline std::unique_ptr<IScalarFunction> build(const std::string& expression) {
+  tao::TAO_PEGTL_NAMESPACE::string_input<> in(expression, "from content");
+  return build_function(*parse(in));
+}
+
+#endif  // LIBKRIGING_PARSER__TEST_HELPERS_HPP
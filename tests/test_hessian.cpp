@@ -0,0 +1,50 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include "../src/Hessian.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE("Hessian matches nested derivatives", "[hessian]") {
+  const Vector x{1, 2, 3};
+  const Vector v{0.5, -1, 2};
+
+  auto expression = GENERATE(as<std::string>{}, "2", "x_1", "x_0*x_1", "(-x_0)*(+x_0)", "(x_0+x_1)*(x_0-x_2)",
+                             "dot(x,x)", "norm2(x)", "norm2(x)*norm2(-x)", "dot(-x,+x)", "dot(x-x,x+x)", "2/exp(x_0)",
+                             "dot(pi*x,x/e)", "exp(-0.5 * dot(x,x))", "dot(x_1*x,x/x_2)",
+                             "norm2(x/x_0-x_2*x)/(1+x_1)", "exp(-norm2(x-2*x/dot(x,x)))");
+
+  SECTION(expression) {
+    const auto f = build(expression);
+    const Hessian hessian(*f, x.size());
+    const VectorBlock h = hessian.hessian(x);
+    const Vector hv = hessian.hvp(x, v);
+    REQUIRE(h.dimension == x.size());
+    REQUIRE(h.count == x.size());
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      Number expected_hv = 0;
+      for (std::size_t j = 0; j < x.size(); ++j) {
+        const Number expected = f->diff(i)->diff(j)->apply(x);
+        INFO("diff_" << i << "_" << j << " of " << expression);
+        REQUIRE(h.component(i)[j] == Approx(expected).margin(1e-12));
+        expected_hv += expected * v[j];
+      }
+      INFO("hvp_" << i << " of " << expression);
+      REQUIRE(hv[i] == Approx(expected_hv).margin(1e-12));
+    }
+  }
+}
+
+TEST_CASE("Hessian only evaluates structural non zeros", "[hessian]") {
+  REQUIRE(Hessian(*build("2+x_1"), 3).nonzeros() == 0);
+  REQUIRE(Hessian(*build("x_0*x_1"), 3).nonzeros() == 1);
+  REQUIRE(Hessian(*build("x_0*x_1+exp(x_2)"), 3).nonzeros() == 2);
+  REQUIRE(Hessian(*build("dot(x,x)"), 4).nonzeros() == 4);  // d_i is 2*x_i once simplified
+  REQUIRE(Hessian(*build("exp(-0.5*dot(x,x))"), 4).nonzeros() == 10);
+
+  const VectorBlock h = Hessian(*build("x_0*x_1"), 3).hessian({1, 2, 3});
+  REQUIRE(h.data == Vector{0, 1, 0, 1, 0, 0, 0, 0, 0});
+}
@@ -0,0 +1,103 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "../src/IncrementalEvaluator.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE("Incremental evaluation matches full evaluation", "[incremental]") {
+  const std::string expression = GENERATE(as<std::string>{}, "x_0*x_1+exp(x_2)-x_3/2", "exp(-0.5*dot(x,x))",
+                                          "dot(pi*x,x/e)*exp(-norm2(x)/x_1)", "x_0*x_1/(1+x_2)+exp(-norm2(x))*x_3");
+  const auto f = build(expression);
+  IncrementalEvaluator evaluator(*f);
+  Vector x{0.5, -1, 2, 0.25};
+  REQUIRE(evaluator.apply(x) == evaluator.tape().apply(x));
+  REQUIRE(evaluator.recomputed() == evaluator.tape().instructions().size());
+
+  for (int step = 0; step < 50; ++step) {
+    const Index i = (7 * step) % x.size();
+    x[i] = std::sin(step + 1.);
+    INFO(expression << " after setting x_" << i);
+    REQUIRE(evaluator.update(i, x[i]) == evaluator.tape().apply(x));
+    REQUIRE(evaluator.value() == Approx(f->apply(x)));
+    REQUIRE(evaluator.recomputed() <= evaluator.tape().instructions().size());
+  }
+  x[0] += 1;
+  x[3] -= 1;
+  REQUIRE(evaluator.update({0, 3}, {x[0], x[3]}) == evaluator.tape().apply(x));
+  REQUIRE(evaluator.point() == x);
+}
+
+TEST_CASE("Incremental evaluation only recomputes dependent nodes", "[incremental]") {
+  const auto f = build("x_0*x_1+exp(x_2)");  // x_0, x_1, mul, x_2, exp, add
+  IncrementalEvaluator evaluator(*f);
+  evaluator.apply({1, 2, 3});
+  REQUIRE(evaluator.recomputed() == 6);
+
+  evaluator.update(2, 0.5);
+  REQUIRE(evaluator.recomputed() == 3);  // x_2, exp, add
+  REQUIRE(evaluator.value() == 2 + std::exp(0.5));
+  evaluator.update(1, 3);
+  REQUIRE(evaluator.recomputed() == 3);  // x_1, mul, add
+  evaluator.update(1, 3);
+  REQUIRE(evaluator.recomputed() == 0);  // unchanged
+  REQUIRE(evaluator.value() == 3 + std::exp(0.5));
+
+  const auto g = build("exp(-0.5*dot(x,x))+x_1");
+  IncrementalEvaluator dense(*g);
+  dense.apply({1, 2, 3});
+  dense.update(0, 2);
+  REQUIRE(dense.recomputed() < dense.tape().instructions().size());  // constants and x_1 are kept
+  REQUIRE(dense.dependencies(dense.tape().instructions().size() - 1).all);
+  REQUIRE(evaluator.dependencies(evaluator.tape().instructions().size() - 1).indices == std::vector<Index>{0, 1, 2});
+}
+
+TEST_CASE("Incremental evaluation sees every change of bits", "[incremental]") {
+  const auto f = build("1/x_0+x_1");
+  IncrementalEvaluator evaluator(*f);
+  evaluator.apply({0., 1});
+  REQUIRE(evaluator.value() == std::numeric_limits<Number>::infinity());
+
+  SECTION("signed zeros") {
+    REQUIRE(evaluator.update(0, -0.) == -std::numeric_limits<Number>::infinity());
+    REQUIRE(evaluator.update(0, 0.) == std::numeric_limits<Number>::infinity());
+    evaluator.update(0, 0.);
+    REQUIRE(evaluator.recomputed() == 0);
+  }
+  SECTION("NaN") {
+    evaluator.update(1, std::nan(""));
+    REQUIRE(std::isnan(evaluator.value()));
+    evaluator.update(1, std::nan(""));
+    REQUIRE(evaluator.recomputed() > 0);
+    REQUIRE(std::isnan(evaluator.value()));
+  }
+}
+
+TEST_CASE("Incremental updates need a current point", "[incremental]") {
+  const auto f = build("x_0*x_1");
+  IncrementalEvaluator evaluator(*f);
+  REQUIRE_THROWS_AS(evaluator.update(0, 1), std::logic_error);
+  REQUIRE_THROWS_AS(evaluator.update({0}, {1}), std::logic_error);
+  evaluator.apply({1, 2});
+  REQUIRE_THROWS_AS(evaluator.update(2, 1), std::out_of_range);
+  REQUIRE_THROWS_AS(evaluator.update({0, 1}, {1}), std::invalid_argument);
+  REQUIRE(evaluator.update(0, 3) == 6);
+}
+
+TEST_CASE("Failed incremental updates leave the evaluator unchanged", "[incremental]") {
+  const auto f = build("x_0*dot(x,x)");
+  IncrementalEvaluator evaluator(*f);
+  Vector x{1, 2, 3};
+  evaluator.apply(x);
+  REQUIRE_THROWS_AS(evaluator.update({0, 3}, {5, 1}), std::out_of_range);  // x_3 is out of the point
+  REQUIRE(evaluator.point() == x);
+  REQUIRE(evaluator.update(1, 2) == evaluator.tape().apply(x));  // unchanged coordinate: nothing pending is replayed
+  x[0] = 5;
+  REQUIRE(evaluator.update({0}, {5}) == evaluator.tape().apply(x));
+}
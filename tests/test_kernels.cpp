@@ -0,0 +1,121 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <random>
+#include <tao/pegtl/string_input.hpp>
+#include "../src/Kernels.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+namespace {
+Vector random_vector(std::mt19937& gen, std::size_t n) {
+  std::uniform_real_distribution<Number> dist(-10, 10);
+  Vector v(n);
+  for (auto& vi : v)
+    vi = dist(gen);
+  return v;
+}
+}  // namespace
+
+TEST_CASE("SIMD kernels match scalar loops", "[kernels]") {
+  const auto isa = GENERATE(kernels::InstructionSet::Scalar,
+                            kernels::InstructionSet::SSE2,
+                            kernels::InstructionSet::AVX2,
+                            kernels::InstructionSet::AVX512);
+  if (!kernels::is_supported(isa))
+    return;
+  const auto default_isa = kernels::instruction_set();
+  kernels::set_instruction_set(isa);
+
+  const std::size_t n = GENERATE(0, 1, 3, 7, 8, 17, 33, 1000);
+  std::mt19937 gen(n);
+  const Vector a = random_vector(gen, n + 1);
+  const Vector b = random_vector(gen, n + 1);
+  const Number s = 1.5 + gen() % 7;
+
+  SECTION(std::string{kernels::instruction_set_name(isa)} + " n=" + std::to_string(n)) {
+    // unaligned input and output (offset by one)
+    const Number* pa = a.data() + 1;
+    const Number* pb = b.data() + 1;
+    Vector r(n + 1);
+    Number* pr = r.data() + 1;
+
+    kernels::add(pr, pa, pb, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == pa[i] + pb[i]);
+    kernels::sub(pr, pa, pb, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == pa[i] - pb[i]);
+    kernels::multiply(pr, pa, pb, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == pa[i] * pb[i]);
+    kernels::divide(pr, pa, pb, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == pa[i] / pb[i]);
+    kernels::negate(pr, pa, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == -pa[i]);
+    kernels::scale(pr, pa, s, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == pa[i] * s);
+    kernels::scale_divide(pr, pa, s, n);
+    for (std::size_t i = 0; i < n; ++i)
+      REQUIRE(pr[i] == pa[i] / s);
+
+    Vector acc = b;
+    kernels::multiply_add(acc.data() + 1, pa, pb, n);
+    for (std::size_t i = 0; i < n; ++i) {
+      const Number product = pa[i] * pb[i];
+      REQUIRE(acc[i + 1] == pb[i] + product);
+    }
+
+    Number exact = 0;
+    for (std::size_t i = 0; i < n; ++i)
+      exact += pa[i] * pb[i];
+    REQUIRE(kernels::reduction_mode() == kernels::ReductionMode::Exact);
+    REQUIRE(kernels::dot(pa, pb, n) == exact);
+
+    kernels::set_reduction_mode(kernels::ReductionMode::Reassociated);
+    const Number reassociated = kernels::dot(pa, pb, n);
+    kernels::set_reduction_mode(kernels::ReductionMode::Exact);
+    REQUIRE(std::abs(reassociated - exact) <= kernels::dot_tolerance(pa, pb, n));
+
+    Vector difference(n);
+    kernels::sub(difference.data(), pa, pb, n);
+    const Number distance = kernels::dot(difference.data(), difference.data(), n);
+    REQUIRE(kernels::squared_distance(pa, pb, n) == distance);
+    kernels::set_reduction_mode(kernels::ReductionMode::Reassociated);
+    const Number reassociated_distance = kernels::squared_distance(pa, pb, n);
+    kernels::set_reduction_mode(kernels::ReductionMode::Exact);
+    REQUIRE(std::abs(reassociated_distance - distance)
+            <= kernels::dot_tolerance(difference.data(), difference.data(), n));
+  }
+
+  kernels::set_instruction_set(default_isa);
+}
+
+TEST_CASE("Reassociated reductions stay within tolerance", "[kernels]") {
+  const std::size_t n = 10000;
+  std::mt19937 gen(42);
+  const Vector x = random_vector(gen, n);
+
+  auto expression = GENERATE("dot(x,x)", "norm2(x)", "norm2(x-2*x/3)", "dot(x,x/e)+x_7");
+
+  SECTION(expression) {
+    string_input in(expression, "valid input expression");
+    const auto root = parse(in);
+    std::unique_ptr<IScalarFunction> f = build_function(*root);
+    const Number exact = f->apply(x);
+
+    kernels::set_reduction_mode(kernels::ReductionMode::Reassociated);
+    const Number reassociated = f->apply(x);
+    kernels::set_reduction_mode(kernels::ReductionMode::Exact);
+
+    REQUIRE(f->apply(x) == exact);
+    // x.x is the dominant term of each expression
+    REQUIRE(std::abs(reassociated - exact) <= 2 * kernels::dot_tolerance(x.data(), x.data(), n));
+  }
+}
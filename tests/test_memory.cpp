@@ -0,0 +1,63 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <thread>
+#include "../src/AllocationCounter.hpp"
+#include "../src/ExpressionArena.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE("Memory footprint counts shared nodes once", "[memory]") {
+  const auto f = build("x_0*x_1");
+  const MemoryFootprint footprint = memory_footprint(*f);
+  REQUIRE(footprint.nodes == 4);  // x is shared by x_0 and x_1
+  REQUIRE(footprint.depth == 3);
+  REQUIRE(footprint.heap_allocations == 4);
+  REQUIRE(footprint.bytes >= 4 * ExpressionArena::node_header_size + f->memory_size());
+  REQUIRE(footprint.nodes_by_class.at("IndexedVectorIdentity") == 2);
+  REQUIRE(footprint.nodes_by_class.at("VectorIdentity") == 1);
+  REQUIRE(footprint.nodes_by_class.at("ScalarScalarProduct") == 1);
+
+  const auto g = build("dot(pi*x,x/e)*exp(-norm2(x)/x_1)");
+  for (Index order = 0; order < 3; ++order) {
+    const auto dg = g->diff(order);
+    const MemoryFootprint d = memory_footprint(*dg);
+    REQUIRE(d.nodes == dag_size(*dg));
+    REQUIRE(d.depth <= d.nodes);
+    std::size_t by_class = 0;
+    for (const auto& [name, count] : d.nodes_by_class) {
+      by_class += count;
+    }
+    REQUIRE(by_class == d.nodes);
+  }
+}
+
+TEST_CASE("Memory footprint of arena functions", "[memory][arena]") {
+  const std::string expression = "exp(-0.5*dot(x,x))/(1+x_0*x_1)";
+  const MemoryFootprint heap = memory_footprint(*build(expression));
+
+  ExpressionArena arena;
+  ExpressionArena::Scope scope(arena);
+  const MemoryFootprint footprint = memory_footprint(*build(expression));
+  REQUIRE(footprint.heap_allocations == 0);
+  REQUIRE(footprint.nodes == heap.nodes);
+  REQUIRE(footprint.bytes == heap.bytes);
+  REQUIRE(footprint.bytes <= arena.allocated_bytes());
+}
+
+TEST_CASE("Allocation counter", "[memory]") {
+  const AllocationCounter counter;
+  const auto f = build("exp(-0.5*dot(x,x))");
+  const AllocationCount count = counter.count();
+  REQUIRE(count.allocations >= memory_footprint(*f).heap_allocations);
+  REQUIRE(count.bytes >= memory_footprint(*f).bytes);
+
+  SECTION("counts are per thread") {
+    const AllocationCounter idle;
+    std::thread([] { (void)build("exp(-0.5*dot(x,x))"); }).join();
+    REQUIRE(idle.count().allocations <= 1);  // the thread state, allocated by the calling thread
+  }
+}
@@ -0,0 +1,119 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "../src/NativeFunction.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+namespace {
+NativeOptions test_options() {
+  NativeOptions options;
+  options.cache_directory = (std::filesystem::temp_directory_path() / "libkriging-parser-test-native").string();
+  return options;
+}
+}  // namespace
+
+TEST_CASE("Native functions give the interpreter results", "[native]") {
+  const std::string expression = GENERATE(as<std::string>{}, "exp(-0.5*dot(x,x))", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "x_0*x_1/(1+x_0)-x_2", "-exp(-norm2(x-2*x/dot(x,x)))/(1+x_0*x_1)");
+  const Vector x{0.5, -1, 2};
+  auto f = build(expression);
+  const NativeFunction native(*f, test_options());
+  INFO(native.diagnostic());
+  CHECK(native.is_native());  // a compiler is expected on test machines
+
+  const Tape& tape = native.tape();
+  REQUIRE(native.apply(x) == tape.apply(x));
+  REQUIRE(native.gradient(x) == tape.gradient(x));
+
+  SECTION("derivatives") {
+    auto d = f->diff(1);
+    const NativeFunction native_d(*d, test_options());
+    REQUIRE(native_d.apply(x) == d->apply(x));
+  }
+
+  SECTION("workspace reuse") {
+    Tape::Workspace workspace;
+    for (const Vector& y : {x, Vector{1, 2, 3, 4}, x}) {
+      REQUIRE(native.apply(y, workspace) == tape.apply(y));
+      REQUIRE(native.gradient(y, workspace) == tape.gradient(y));
+    }
+  }
+}
+
+TEST_CASE("Native libraries are cached on disk", "[native]") {
+  auto f = build("exp(-norm2(x)/x_0)");
+  const NativeFunction first(*f, test_options());
+  if (!first.is_native())
+    return;
+  const NativeFunction second(*build("exp(-norm2(x)/x_0)"), test_options());
+  REQUIRE(second.diagnostic() == first.diagnostic());
+  REQUIRE(std::filesystem::exists(first.diagnostic()));
+}
+
+TEST_CASE("Cached libraries are checked before loading", "[native]") {
+  namespace fs = std::filesystem;
+  auto f = build("exp(-norm2(x)/x_1)+x_0");
+  const NativeFunction first(*f, test_options());
+  if (!first.is_native())
+    return;
+  const Vector x{0.5, -1, 2};
+  const fs::path library = first.diagnostic();
+  const fs::path source = fs::path(library).replace_extension(".cpp");
+  REQUIRE(fs::exists(source));
+
+  SECTION("another source (a hash collision) is rebuilt") {
+    std::ofstream(source) << "// another function\n";
+    const NativeFunction second(*f, test_options());
+    REQUIRE(second.is_native());
+    REQUIRE(second.apply(x) == first.tape().apply(x));
+    std::ostringstream stored;
+    stored << std::ifstream(source).rdbuf();
+    REQUIRE(stored.str() == NativeFunction::source(first.tape()));
+  }
+
+  SECTION("a library writable by others is rebuilt") {
+    fs::permissions(library, fs::perms::group_write | fs::perms::others_write, fs::perm_options::add);
+    const NativeFunction second(*f, test_options());
+    REQUIRE(second.is_native());
+    REQUIRE((fs::status(library).permissions() & (fs::perms::group_write | fs::perms::others_write))
+            == fs::perms::none);
+  }
+}
+
+TEST_CASE("Unsafe cache directories are not used", "[native]") {
+  namespace fs = std::filesystem;
+  const fs::path directory = fs::temp_directory_path() / "libkriging-parser-test-native-shared";
+  fs::create_directories(directory);
+  fs::permissions(directory, fs::perms::all);  // writable by everyone, as the temporary directory
+  NativeOptions options;
+  options.cache_directory = directory.string();
+  auto f = build("x_0*exp(x_1)");
+  const NativeFunction native(*f, options);
+  REQUIRE_FALSE(native.is_native());
+  REQUIRE(native.diagnostic().find("unsafe cache directory") != std::string::npos);
+  REQUIRE(native.apply({1, 2}) == f->apply({1, 2}));
+  fs::remove_all(directory);
+}
+
+TEST_CASE("Fall back to the interpreter without compiler", "[native]") {
+  NativeOptions options = test_options();
+  options.compiler = "/nonexistent/c++";
+  auto f = build("x_0*exp(x_1) + 1e-3");
+  const NativeFunction native(*f, options);
+  REQUIRE_FALSE(native.is_native());
+  REQUIRE(native.apply({1, 2}) == f->apply({1, 2}));
+  REQUIRE(native.gradient({1, 2}) == f->gradient({1, 2}));
+}
+
+TEST_CASE("Generated source", "[native]") {
+  const std::string source = NativeFunction::source(compile(*build("x_0*2")));
+  REQUIRE(source.find("extern \"C\" double lkp_value(") != std::string::npos);
+  REQUIRE(source.find("0x1p+1") != std::string::npos);  // exact constants
+}
@@ -0,0 +1,95 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include "../src/BatchEvaluator.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+namespace {
+VectorBlock points(const Index dimension, const Index count) {
+  VectorBlock block(dimension, count);
+  for (std::size_t k = 0; k < block.data.size(); ++k) {
+    block.data[k] = std::sin(0.37 * k) * 2;
+  }
+  return block;
+}
+}  // namespace
+
+TEST_CASE("parallel_for covers its range once", "[parallel]") {
+  const std::size_t concurrency = GENERATE(1, 2, 4);
+  const Index grain = GENERATE(1, 7, 1000);
+  ThreadPool pool(concurrency);
+  REQUIRE(pool.concurrency() == concurrency);
+
+  std::vector<std::atomic<int>> visits(5000);
+  std::atomic<bool> oversized{false};  // Catch assertions are not thread safe
+  pool.parallel_for(3, visits.size(), grain, [&](const Index begin, const Index end) {
+    if (end - begin > grain)
+      oversized = true;
+    for (Index i = begin; i < end; ++i) {
+      ++visits[i];
+    }
+  });
+  REQUIRE(!oversized);
+  for (Index i = 0; i < visits.size(); ++i) {
+    REQUIRE(visits[i] == ((i < 3) ? 0 : 1));
+  }
+}
+
+TEST_CASE("parallel_for nests and propagates exceptions", "[parallel]") {
+  ThreadPool pool(3);
+  std::atomic<Index> total{0};
+  pool.parallel_for(0, 10, 1, [&](Index, Index) {
+    pool.parallel_for(0, 100, 10, [&](const Index begin, const Index end) { total += end - begin; });
+  });
+  REQUIRE(total == 1000);
+
+  REQUIRE_THROWS_AS(pool.parallel_for(0, 100, 1,
+                                      [](const Index begin, Index) {
+                                        if (begin == 42)
+                                          throw std::runtime_error("failure");
+                                      }),
+                    std::runtime_error);
+  pool.parallel_for(0, 10, 1, [](Index, Index) {});  // still usable
+}
+
+TEST_CASE("Batch evaluator matches sequential evaluation", "[parallel]") {
+  const std::string expression = GENERATE(as<std::string>{}, "exp(-0.5*dot(x,x))", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "exp(-dot(x-2*x,-x)/x_2/e)");
+  auto f = build(expression);
+  const VectorBlock block = points(3, 2500);
+  ThreadPool pool(4);
+  const BatchEvaluator evaluator(*f, pool, 64);
+
+  const Vector values = evaluator.apply(block);
+  const VectorBlock gradients = evaluator.gradient(block);
+  const Tape tape = compile(*f);
+  for (Index p = 0; p < block.count; ++p) {
+    const Vector x = block.point(p);
+    REQUIRE(values[p] == f->apply(x));
+    REQUIRE(gradients.point(p) == tape.gradient(x));
+  }
+}
+
+TEST_CASE("Shared nodes are evaluated concurrently", "[parallel]") {
+  auto f = build("dot(pi*x,x/e)*exp(-norm2(x)/x_1)");
+  const ScalarFunctionPtr d = intern(f->diff(1, DiffOptions{true}));
+  const VectorBlock block = points(3, 2000);
+  Vector values(block.count), derivatives(block.count);
+  ThreadPool pool(4);
+  pool.parallel_for(0, block.count, 16, [&](const Index begin, const Index end) {
+    for (Index p = begin; p < end; ++p) {
+      const Vector x = block.point(p);
+      values[p] = f->apply(x);
+      derivatives[p] = intern(f->diff(1))->apply(x);  // interning from several threads
+    }
+  });
+  for (Index p = 0; p < block.count; ++p) {
+    const Vector x = block.point(p);
+    REQUIRE(values[p] == f->apply(x));
+    REQUIRE(derivatives[p] == Approx(d->apply(x)));
+  }
+}
@@ -54,3 +54,35 @@ TEST_CASE("Invalid input expression", "[!shouldfail]") {
     }
   }
 }
+
+TEST_CASE("Direct parsing builds the same functions", "[echo]") {
+  auto e = GENERATE("exp(2)",  //
+                    "2-(2/6+2)*4",
+                    "(-x_0)*1+(-1)*(+x_0)",
+                    "exp(-pi*a-e*norm2(x)+dot(x-y,x)*x_2)",
+                    "exp ( -pi * a - e * norm2 ( x ) + dot ( x - y , x ) * x_2 ) ",
+                    "dot(2*x*3/4,-x+y)-norm2((a*b)*x/c)",
+                    "dot((2*x_0)*x,(x))+norm2(-(x-y))/x_12");
+
+  SECTION(e) {
+    string_input in(e, "valid input expression");
+    string_input direct_in(e, "valid input expression");
+    const std::unique_ptr<IScalarFunction> f = build_function(*parse(in));
+    const std::unique_ptr<IScalarFunction> direct = parse_function(direct_in);
+    REQUIRE(direct->string() == f->string());
+    // nodes are interned: both front ends give the same node
+    REQUIRE(intern(direct->clone()) == intern(f->clone()));
+  }
+}
+
+TEST_CASE("Direct parsing of invalid input expression", "[echo]") {
+  auto e = GENERATE("exp(--2)", "x", "-x_0*1+-1*+x_0", "exp(x)", "dot(x,y");
+  SECTION(e) {
+    string_input in(e, "invalid input expression");
+    REQUIRE_THROWS_AS(parse_function(in), parse_error);
+  }
+  SECTION("not implemented function") {
+    string_input in("2*sqrt(a)", "not implemented function");
+    REQUIRE_THROWS_AS(parse_function(in), NotImplementedException);
+  }
+}
@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <limits>
+#include "../src/Kernels.hpp"
+#include "../src/MixedPrecision.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+namespace {
+template <typename T>
+std::vector<T> converted(const Vector& x) {
+  return std::vector<T>(x.begin(), x.end());
+}
+}  // namespace
+
+TEST_CASE("One tape evaluated in float, double and long double", "[precision]") {
+  const Vector x{1, 2, 3};
+
+  auto expression = GENERATE("2-(2./6+2)*4",
+                             "exp(2)",
+                             "dot(x-x,x+x*2)",
+                             "exp(-dot(x-2*x,-x)/x_2/e)",
+                             "pi*x_0/x_1-exp(-0.5*dot(x,x))",
+                             "dot(pi*x,x/e)-norm2(x-2*x/3)");
+
+  SECTION(expression) {
+    const Tape tape = compile(*build(expression));
+    const Number value = tape.apply(x);
+    REQUIRE(tape.apply_as(x) == value);
+
+    const long double reference = tape.apply_as(converted<long double>(x));
+    REQUIRE(static_cast<Number>(reference) == Approx(value).epsilon(1e-14));
+    const float screening = tape.apply_as(converted<float>(x));
+    REQUIRE(screening == Approx(value).epsilon(1e-5));
+
+    Tape::BasicWorkspace<float> workspace;
+    REQUIRE(tape.apply_as(converted<float>(x), workspace) == screening);
+    REQUIRE(tape.apply_as(converted<float>(x), workspace) == screening);  // reused workspace
+  }
+}
+
+TEST_CASE("Portable kernels of float", "[precision]") {
+  std::vector<float> a(37), b(37), r(37);
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a[i] = 0.5f * i - 3;
+    b[i] = 1.25f - 0.125f * i;
+  }
+  kernels::sub(r.data(), a.data(), b.data(), a.size());
+  float exact = 0;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    REQUIRE(r[i] == a[i] - b[i]);
+    exact += a[i] * b[i];
+  }
+  REQUIRE(kernels::dot(a.data(), b.data(), a.size()) == exact);
+  kernels::set_reduction_mode(kernels::ReductionMode::Reassociated);
+  const float reassociated = kernels::dot(a.data(), b.data(), a.size());
+  const float distance = kernels::squared_distance(a.data(), b.data(), a.size());
+  kernels::set_reduction_mode(kernels::ReductionMode::Exact);
+  REQUIRE(reassociated == Approx(exact).epsilon(1e-5));
+  REQUIRE(distance == Approx(kernels::dot(r.data(), r.data(), r.size())).epsilon(1e-5));
+}
+
+TEST_CASE("Mixed precision refines the selected values in double", "[precision]") {
+  const auto f = build("exp(-dot(x,x)/32)*x_0+1e-30");
+  const Tape tape = compile(*f);
+  VectorBlock points(3, 64);
+  for (std::size_t k = 0; k < points.data.size(); ++k) {
+    points.data[k] = std::sin(0.37 * k) * 4;
+  }
+  const MixedPrecisionEvaluator evaluator(*f);
+
+  SECTION("none") {
+    const auto result = evaluator.apply(points, [](Number) { return false; });
+    REQUIRE(result.refined.empty());
+    for (Index p = 0; p < points.count; ++p) {
+      REQUIRE(result.values[p] == tape.apply_as(converted<float>(points.point(p))));
+    }
+  }
+
+  SECTION("values above 1") {
+    const auto result = evaluator.apply(points, [](const Number v) { return std::abs(v) > 1; });
+    REQUIRE(!result.refined.empty());
+    REQUIRE(result.refined.size() < points.count);
+    std::size_t next = 0;
+    for (Index p = 0; p < points.count; ++p) {
+      const bool refined = next < result.refined.size() && result.refined[next] == p;
+      next += refined;
+      REQUIRE(refined == (std::abs(tape.apply_as(converted<float>(points.point(p)))) > 1));
+      if (refined) {
+        REQUIRE(result.values[p] == tape.apply(points.point(p)));
+      } else {
+        REQUIRE(result.values[p] == Approx(tape.apply(points.point(p))).epsilon(1e-5));
+      }
+    }
+  }
+
+  SECTION("values out of the float range") {
+    const auto huge = build("exp(100+x_0)");
+    const auto result = MixedPrecisionEvaluator(*huge).apply(points, [](Number) { return false; });
+    REQUIRE(result.refined.size() == points.count);
+    REQUIRE(result.values[0] == compile(*huge).apply(points.point(0)));
+  }
+}
@@ -0,0 +1,74 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "../src/PointStream.hpp"
+
+TEST_CASE("CSV points are read block by block", "[stream]") {
+  std::istringstream in("1,2,3\n\n4, 5 ,6\r\n-7,8e1,9\n");
+  CsvPointReader reader(in, 3);
+  const VectorBlock first = reader.read(2);
+  REQUIRE(first.count == 2);
+  REQUIRE(first.point(0) == Vector{1, 2, 3});
+  REQUIRE(first.point(1) == Vector{4, 5, 6});
+  const VectorBlock second = reader.read(2);
+  REQUIRE(second.count == 1);
+  REQUIRE(second.point(0) == Vector{-7, 80, 9});
+  REQUIRE(reader.read(2).count == 0);
+
+  std::istringstream missing("1,2\n");
+  REQUIRE_THROWS_AS(CsvPointReader(missing, 3).read(2), std::runtime_error);
+  std::istringstream extra("1,2,3,4\n");
+  REQUIRE_THROWS_AS(CsvPointReader(extra, 3).read(2), std::runtime_error);
+}
+
+TEST_CASE("Binary point files are read block by block", "[stream]") {
+  const std::string filename = "test_stream_points.bin";
+  const Index dimension = 3, count = 1000;
+  {
+    std::ofstream out(filename, std::ios::binary);
+    for (Index k = 0; k < dimension * count; ++k) {
+      const auto value = static_cast<Number>(k);
+      out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+  }
+  {
+    BinaryPointFile file(filename, dimension);
+    REQUIRE(file.count() == count);
+    Index read = 0;
+    for (VectorBlock block = file.read(128); block.count > 0; block = file.read(128)) {
+      REQUIRE(block.count <= 128);
+      for (Index p = 0; p < block.count; ++p) {
+        const auto first = static_cast<Number>((read + p) * dimension);
+        REQUIRE(block.point(p) == Vector{first, first + 1, first + 2});
+      }
+      read += block.count;
+    }
+    REQUIRE(read == count);
+    REQUIRE_THROWS_AS(BinaryPointFile(filename, 7), std::runtime_error);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("Results are written as CSV or binary", "[stream]") {
+  const Vector values{1.5, -2};
+  const VectorBlock gradients = VectorBlock::from_points({{1, 2}, {3, 4}});
+
+  std::ostringstream csv;
+  ResultWriter(csv, StreamFormat::Csv).write(values, gradients);
+  ResultWriter(csv, StreamFormat::Csv).write(values, {});
+  REQUIRE(csv.str() == "1.5,1,2\n-2,3,4\n1.5\n-2\n");
+
+  std::ostringstream binary;
+  ResultWriter(binary, StreamFormat::Binary).write(values, gradients);
+  Vector written(6);
+  std::memcpy(written.data(), binary.str().data(), binary.str().size());
+  REQUIRE(binary.str().size() == written.size() * sizeof(Number));
+  REQUIRE(written == Vector{1.5, 1, 2, -2, 3, 4});
+}
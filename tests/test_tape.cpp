@@ -0,0 +1,68 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include <tao/pegtl/string_input.hpp>
+#include "../src/Tape.hpp"
+#include "../src/grammar.hpp"
+using namespace tao::TAO_PEGTL_NAMESPACE;  // NOLINT
+
+TEST_CASE("Compiled expression matches tree evaluation", "[tape]") {
+  const Vector x{1, 2, 3};
+
+  auto expression = GENERATE("2",
+                             "2+2",
+                             "2-2*2",
+                             "2-(2./6+2)*4",
+                             "-(+2)",
+                             "exp(2)",
+                             "dot(x,x)",
+                             "norm2(x)",
+                             "dot(x-x,x+x*2)",
+                             "dot(-x,+x)",
+                             "exp(-dot(x-2*x,-x)/x_2/e)",
+                             "norm2(x+x)",
+                             "pi*x_0/x_1-exp(-0.5*dot(x,x))",
+                             "dot(pi*x,x/e)");
+
+  SECTION(expression) {
+    string_input in(expression, "valid input expression");
+    const auto root = parse(in);
+    std::unique_ptr<IScalarFunction> f = build_function(*root);
+    const Tape tape = compile(*f);
+    INFO("tape of " << expression << " is\n" << tape.string());
+    REQUIRE(tape.apply(x) == f->apply(x));
+
+    Tape::Workspace workspace;
+    REQUIRE(tape.apply(x, workspace) == f->apply(x));
+    REQUIRE(tape.apply(x, workspace) == f->apply(x));  // reused workspace
+
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      ScalarFunctionPtr df = f->diff(i);
+      INFO("diff_" << i << " of " << expression << " is " << df->string());
+      REQUIRE(compile(*df).apply(x) == df->apply(x));
+    }
+  }
+}
+
+TEST_CASE("Compiled expression rejects unknown symbols", "[tape]") {
+  string_input in("2*a", "valid input expression");
+  const auto root = parse(in);
+  std::unique_ptr<IScalarFunction> f = build_function(*root);
+  REQUIRE_THROWS_AS(compile(*f), NotImplementedException);
+}
+
+TEST_CASE("Compiled derivatives keep shared subexpressions", "[tape]") {
+  string_input in("2/exp(x_0)", "valid input expression");
+  ScalarFunctionPtr d = build_function(*parse(in));
+  const Vector x{0.3};
+  for (int order = 1; order <= 6; ++order) {
+    d = d->diff(0);
+    const Tape tape = compile(*d);
+    INFO("order " << order << ": " << dag_size(*d) << " nodes, " << tree_size(*d) << " as a tree");
+    REQUIRE(tape.instructions().size() <= dag_size(*d));  // at most one instruction per distinct node
+    REQUIRE(tape.apply(x) == d->apply(x));
+  }
+}
@@ -0,0 +1,52 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+// doc : https://github.com/catchorg/Catch2/blob/master/docs/Readme.mda
+// More example in https://github.com/catchorg/Catch2/tree/master/examples
+
+#include "../src/AllocationCounter.hpp"
+#include "../src/Tape.hpp"
+#include "../src/grammar.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE("Evaluation with a workspace", "[workspace]") {
+  const std::string expression = GENERATE(as<std::string>{}, "exp(-0.5*dot(x,x))", "dot(pi*x,x/e)*exp(-norm2(x)/x_1)",
+                                          "x_0*x_1/(1+x_0)-x_2", "-exp(-norm2(x-2*x/dot(x,+x)))/(1+x_0*x_1)");
+  const Vector x{0.5, -1, 2};
+  auto f = build(expression);
+  auto d = f->diff(1);
+  Workspace workspace;
+
+  REQUIRE(f->apply(x, workspace) == f->apply(x));
+  REQUIRE(d->apply(x, workspace) == d->apply(x));
+  REQUIRE(d->diff(0)->apply(x, workspace) == d->diff(0)->apply(x));
+  REQUIRE(workspace.buffer_count() > 0);
+
+  SECTION("steady state does not allocate") {
+    const Vector y{1, 2, 3, 4};
+    const Number expected = d->apply(y);
+    (void)d->apply(y, workspace);  // warm-up
+    const AllocationCounter counter;
+    Number value = 0;
+    for (int i = 0; i < 100; ++i) {
+      value = d->apply(y, workspace);
+    }
+    REQUIRE(counter.count().allocations == 0);
+    REQUIRE(value == expected);
+  }
+}
+
+TEST_CASE("Tape evaluation does not allocate either", "[workspace]") {
+  auto f = build("dot(pi*x,x/e)*exp(-norm2(x)/x_1)");
+  const Tape tape = compile(*f);
+  const Vector x{0.5, -1, 2};
+  Tape::Workspace workspace;
+  (void)tape.apply(x, workspace);
+  const AllocationCounter counter;
+  Number value = 0;
+  for (int i = 0; i < 100; ++i) {
+    value = tape.apply(x, workspace);
+  }
+  REQUIRE(counter.count().allocations == 0);
+  REQUIRE(value == f->apply(x));
+}